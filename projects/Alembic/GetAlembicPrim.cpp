@@ -40,7 +40,8 @@ std::shared_ptr<PrimitiveObject> get_alembic_prim(std::shared_ptr<zeno::ABCTree>
     std::shared_ptr<PrimitiveObject> prim;
     abctree->visitPrims([&] (auto const &p) {
         if (index == 0) {
-            prim = p;
+            // the prims of the tree are kept by ReadAlembic for later frames
+            prim = std::static_pointer_cast<PrimitiveObject>(p->clone());
             return false;
         }
         index--;
@@ -7,12 +7,16 @@
 #include <zeno/types/PrimitiveTools.h>
 #include <zeno/types/NumericObject.h>
 #include <zeno/extra/GlobalState.h>
+#include <zeno/para/parallel_for.h>
 #include <Alembic/AbcGeom/All.h>
 #include <Alembic/AbcCoreAbstract/All.h>
 #include <Alembic/AbcCoreOgawa/All.h>
 #include <Alembic/AbcCoreHDF5/All.h>
 #include <Alembic/Abc/ErrorHandler.h>
 #include "ABCTree.h"
+#include <algorithm>
+#include <exception>
+#include <thread>
 #include <cstring>
 #include <cstdio>
 
@@ -31,15 +35,76 @@ static int clamp(int i, int _min, int _max) {
     }
 }
 
-static std::shared_ptr<PrimitiveObject> foundABCMesh(Alembic::AbcGeom::IPolyMeshSchema &mesh, int frameid, bool read_done) {
-    auto prim = std::make_shared<PrimitiveObject>();
-
-    std::shared_ptr<Alembic::AbcCoreAbstract::v12::TimeSampling> time = mesh.getTimeSampling();
+template <class Schema>
+static int sampleIndex(Schema &schema, int frameid) {
+    std::shared_ptr<Alembic::AbcCoreAbstract::v12::TimeSampling> time = schema.getTimeSampling();
     float time_per_cycle =  time->getTimeSamplingType().getTimePerCycle();
     double start = time->getStoredTimes().front();
     int start_frame = (int)std::round(start / time_per_cycle );
+    return clamp(frameid - start_frame, 0, (int)schema.getNumSamples() - 1);
+}
+
+static void readABCVelocities(Alembic::AbcGeom::V3fArraySamplePtr const &marr, PrimitiveObject *prim, bool read_done) {
+    if (!read_done) {
+        log_info("[alembic] totally {} velocities", marr->size());
+    }
+    if (marr->size() != prim->verts.size())
+        return;
+    auto &parr = prim->add_attr<vec3f>("vel");
+    for (size_t i = 0; i < marr->size(); i++) {
+        auto const &val = (*marr)[i];
+        parr[i] = vec3f(val[0], val[1], val[2]);
+    }
+}
+
+// with `animated_only`, params that are constant are skipped, as they were
+// read along with the first sample
+static void readABCAttrs(Alembic::AbcGeom::IPolyMeshSchema &mesh, PrimitiveObject *prim, int sample_index,
+                         bool animated_only, bool read_done) {
+    ICompoundProperty arbattrs = mesh.getArbGeomParams();
+    if (!arbattrs)
+        return;
+    Alembic::Abc::v12::ISampleSelector sel((Alembic::AbcCoreAbstract::index_t)sample_index);
+    size_t numProps = arbattrs.getNumProperties();
+    for (auto i = 0; i < numProps; i++) {
+        PropertyHeader p = arbattrs.getPropertyHeader(i);
+        if (IFloatGeomParam::matches(p)) {
+            IFloatGeomParam param(arbattrs, p.getName());
+            if (animated_only && param.isConstant())
+                continue;
+            if (!read_done) {
+                log_info("[alembic] float attr {}.", p.getName());
+            }
+            IFloatGeomParam::Sample samp = param.getIndexedValue(sel);
+            if (prim->verts.size() == samp.getVals()->size()) {
+                auto &attr = prim->add_attr<float>(p.getName());
+                for (auto i = 0; i < prim->verts.size(); i++) {
+                    attr[i] = samp.getVals()->get()[i];
+                }
+            }
+        }
+        else if (IV3fGeomParam::matches(p)) {
+            IV3fGeomParam param(arbattrs, p.getName());
+            if (animated_only && param.isConstant())
+                continue;
+            if (!read_done) {
+                log_info("[alembic] vec3f attr {}.", p.getName());
+            }
+            IV3fGeomParam::Sample samp = param.getIndexedValue(sel);
+            if (prim->verts.size() == samp.getVals()->size()) {
+                auto &attr = prim->add_attr<zeno::vec3f>(p.getName());
+                for (auto i = 0; i < prim->verts.size(); i++) {
+                    auto v = samp.getVals()->get()[i];
+                    attr[i] = {v[0], v[1], v[2]};
+                }
+            }
+        }
+    }
+}
+
+static std::shared_ptr<PrimitiveObject> foundABCMesh(Alembic::AbcGeom::IPolyMeshSchema &mesh, int sample_index, bool read_done) {
+    auto prim = std::make_shared<PrimitiveObject>();
 
-    int sample_index = clamp(frameid - start_frame, 0, (int)mesh.getNumSamples() - 1);
     Alembic::AbcGeom::IPolyMeshSchema::Sample mesamp = mesh.getValue(Alembic::Abc::v12::ISampleSelector((Alembic::AbcCoreAbstract::index_t)sample_index));
 
     if (auto marr = mesamp.getPositions()) {
@@ -54,14 +119,7 @@ static std::shared_ptr<PrimitiveObject> foundABCMesh(Alembic::AbcGeom::IPolyMesh
     }
 
     if (auto marr = mesamp.getVelocities()) {
-        if (!read_done) {
-            log_info("[alembic] totally {} velocities", marr->size());
-        }
-        auto &parr = prim->attr<vec3f>("vel");
-        for (size_t i = 0; i < marr->size(); i++) {
-            auto const &val = (*marr)[i];
-            parr.emplace_back(val[0], val[1], val[2]);
-        }
+        readABCVelocities(marr, prim.get(), read_done);
     }
 
     if (auto marr = mesamp.getFaceCounts()) {
@@ -158,135 +216,151 @@ static std::shared_ptr<PrimitiveObject> foundABCMesh(Alembic::AbcGeom::IPolyMesh
         }
     }
 
-    ICompoundProperty arbattrs = mesh.getArbGeomParams();
-
-    if (arbattrs) {
-        size_t numProps = arbattrs.getNumProperties();
-        for (auto i = 0; i < numProps; i++) {
-            PropertyHeader p = arbattrs.getPropertyHeader(i);
-            if (IFloatGeomParam::matches(p)) {
-                IFloatGeomParam param(arbattrs, p.getName());
-                if (!read_done) {
-                    log_info("[alembic] float attr {}.", p.getName());
-                }
-                IFloatGeomParam::Sample samp = param.getIndexedValue();
-                if (prim->verts.size() == samp.getVals()->size()) {
-                    auto &attr = prim->add_attr<float>(p.getName());
-                    for (auto i = 0; i < prim->verts.size(); i++) {
-                        attr[i] = samp.getVals()->get()[i];
-                    }
-                }
-            }
-            else if (IV3fGeomParam::matches(p)) {
-                IV3fGeomParam param(arbattrs, p.getName());
-                if (!read_done) {
-                    log_info("[alembic] vec3f attr {}.", p.getName());
-                }
-                IV3fGeomParam::Sample samp = param.getIndexedValue();
-                if (prim->verts.size() == samp.getVals()->size()) {
-                    auto &attr = prim->add_attr<zeno::vec3f>(p.getName());
-                    for (auto i = 0; i < prim->verts.size(); i++) {
-                        auto v = samp.getVals()->get()[i];
-                        attr[i] = {v[0], v[1], v[2]};
-                    }
-                }
-            }
-        }
-    }
+    readABCAttrs(mesh, prim.get(), sample_index, false, read_done);
 
     return prim;
 }
 
-static std::shared_ptr<CameraInfo> foundABCCamera(Alembic::AbcGeom::ICameraSchema &cam, int frameid) {
+// a mesh whose faces stay the same from sample to sample only has its
+// positions, velocities and animated attributes read again, in place into the
+// prim of the previous sample, so faces and uvs are neither read, triangulated
+// nor copied again; false if the vertex count changed
+static bool updateABCMesh(Alembic::AbcGeom::IPolyMeshSchema &mesh,
+                          PrimitiveObject *prim, int sample_index) {
+    Alembic::Abc::v12::ISampleSelector sel((Alembic::AbcCoreAbstract::index_t)sample_index);
+    auto marr = mesh.getPositionsProperty().getValue(sel);
+    if (!marr || marr->size() != prim->verts.size())
+        return false;
+    for (size_t i = 0; i < marr->size(); i++) {
+        auto const &val = (*marr)[i];
+        prim->verts[i] = vec3f(val[0], val[1], val[2]);
+    }
+    if (auto vels = mesh.getVelocitiesProperty(); vels && !vels.isConstant()) {
+        readABCVelocities(vels.getValue(sel), prim, true);
+    }
+    readABCAttrs(mesh, prim, sample_index, true, true);
+    return true;
+}
+
+static std::shared_ptr<CameraInfo> foundABCCamera(Alembic::AbcGeom::ICameraSchema &cam, int sample_index, bool read_done) {
     CameraInfo cam_info;
-    std::shared_ptr<Alembic::AbcCoreAbstract::v12::TimeSampling> time = cam.getTimeSampling();
-    float time_per_cycle =  time->getTimeSamplingType().getTimePerCycle();
-    double start = time->getStoredTimes().front();
-    int start_frame = (int)std::round(start / time_per_cycle );
-    int sample_index = clamp(frameid - start_frame, 0, (int)cam.getNumSamples() - 1);
 
     auto samp = cam.getValue(Alembic::Abc::v12::ISampleSelector((Alembic::AbcCoreAbstract::index_t)sample_index));
     cam_info.focal_length = samp.getFocalLength();
     cam_info._near = samp.getNearClippingPlane();
     cam_info._far = samp.getFarClippingPlane();
-    log_info(
-        "[alembic] Camera focal_length: {}, near: {}, far: {}",
-        cam_info.focal_length,
-        cam_info._near,
-        cam_info._far
-    );
+    if (!read_done) {
+        log_info(
+            "[alembic] Camera focal_length: {}, near: {}, far: {}",
+            cam_info.focal_length,
+            cam_info._near,
+            cam_info._far
+        );
+    }
     return std::make_shared<CameraInfo>(cam_info);
 }
 
-static Alembic::Abc::v12::M44d foundABCXform(Alembic::AbcGeom::IXformSchema &xfm, int frameid) {
-    std::shared_ptr<Alembic::AbcCoreAbstract::v12::TimeSampling> time = xfm.getTimeSampling();
-    float time_per_cycle =  time->getTimeSamplingType().getTimePerCycle();
-    double start = time->getStoredTimes().front();
-    int start_frame = (int)std::round(start / time_per_cycle );
-    int sample_index = clamp(frameid - start_frame, 0, (int)xfm.getNumSamples() - 1);
-
+static Alembic::Abc::v12::M44d foundABCXform(Alembic::AbcGeom::IXformSchema &xfm, int sample_index) {
     auto samp = xfm.getValue(Alembic::Abc::v12::ISampleSelector((Alembic::AbcCoreAbstract::index_t)sample_index));
     return samp.getMatrix();
 }
 
-static void traverseABC(
+// an object of the archive, the schema it holds, and what was read from the
+// sample it was at last
+struct ABCNode {
+    enum Kind { Other, Mesh, Xform, Camera };
+
+    std::string name;
+    int parent = -1;
+    Kind kind = Other;
+    Alembic::AbcGeom::IPolyMeshSchema mesh;
+    Alembic::AbcGeom::IXformSchema xfm;
+    Alembic::AbcGeom::ICameraSchema cam;
+    bool constant = false;
+    bool same_faces = false;
+
+    int sample = -1;
+    std::shared_ptr<PrimitiveObject> prim;
+    Alembic::Abc::M44d xform = Alembic::Abc::M44d();
+    std::shared_ptr<CameraInfo> camera_info;
+};
+
+// walks the hierarchy once, parents come before their children
+static void indexABC(
     Alembic::AbcGeom::IObject &obj,
-    ABCTree &tree,
-    int frameid,
-    bool read_done
+    int parent,
+    std::vector<ABCNode> &nodes
 ) {
+    int self = (int)nodes.size();
     {
+        auto &node = nodes.emplace_back();
         auto const &md = obj.getMetaData();
-        if (!read_done) {
-            log_info("[alembic] meta data: [{}]", md.serialize());
-        }
-        tree.name = obj.getName();
+        log_info("[alembic] meta data: [{}]", md.serialize());
+        node.name = obj.getName();
+        node.parent = parent;
 
         if (Alembic::AbcGeom::IPolyMesh::matches(md)) {
-            if (!read_done) {
-                log_info("[alembic] found a mesh [{}]", obj.getName());
-            }
-
+            log_info("[alembic] found a mesh [{}]", obj.getName());
             Alembic::AbcGeom::IPolyMesh meshy(obj);
-            auto &mesh = meshy.getSchema();
-            tree.prim = foundABCMesh(mesh, frameid, read_done);
+            node.kind = ABCNode::Mesh;
+            node.mesh = meshy.getSchema();
+            node.constant = node.mesh.isConstant();
+            node.same_faces = node.mesh.getTopologyVariance() != Alembic::AbcGeom::kHeterogenousTopology
+                && (!node.mesh.getUVsParam() || node.mesh.getUVsParam().isConstant());
         } else if (Alembic::AbcGeom::IXformSchema::matches(md)) {
-            if (!read_done) {
-                log_info("[alembic] found a Xform [{}]", obj.getName());
-            }
+            log_info("[alembic] found a Xform [{}]", obj.getName());
             Alembic::AbcGeom::IXform xfm(obj);
-            auto &cam_sch = xfm.getSchema();
-            tree.xform = foundABCXform(cam_sch, frameid);
+            node.kind = ABCNode::Xform;
+            node.xfm = xfm.getSchema();
+            node.constant = node.xfm.isConstant();
         } else if (Alembic::AbcGeom::ICameraSchema::matches(md)) {
-            if (!read_done) {
-                log_info("[alembic] found a Camera [{}]", obj.getName());
-            }
+            log_info("[alembic] found a Camera [{}]", obj.getName());
             Alembic::AbcGeom::ICamera cam(obj);
-            auto &cam_sch = cam.getSchema();
-            tree.camera_info = foundABCCamera(cam_sch, frameid);
+            node.kind = ABCNode::Camera;
+            node.cam = cam.getSchema();
+            node.constant = node.cam.isConstant();
         }
     }
 
     size_t nch = obj.getNumChildren();
-    if (!read_done) {
-        log_info("[alembic] found {} children", nch);
-    }
+    log_info("[alembic] found {} children", nch);
 
     for (size_t i = 0; i < nch; i++) {
         auto const &name = obj.getChildHeader(i).getName();
-        if (!read_done) {
-            log_info("[alembic] at {} name: [{}]", i, name);
-        }
+        log_info("[alembic] at {} name: [{}]", i, name);
 
         Alembic::AbcGeom::IObject child(obj, name);
+        indexABC(child, self, nodes);
+    }
+}
 
-        auto childTree = std::make_shared<ABCTree>();
-        traverseABC(child, *childTree, frameid, read_done);
-        tree.children.push_back(std::move(childTree));
+static int nodeSampleIndex(ABCNode &node, int frameid) {
+    if (node.constant)
+        return 0;
+    switch (node.kind) {
+    case ABCNode::Mesh: return sampleIndex(node.mesh, frameid);
+    case ABCNode::Xform: return sampleIndex(node.xfm, frameid);
+    case ABCNode::Camera: return sampleIndex(node.cam, frameid);
+    default: return 0;
     }
 }
 
-static Alembic::AbcGeom::IArchive readABC(std::string const &path) {
+static void readABCNode(ABCNode &node, int sample_index, bool read_done) {
+    if (node.kind == ABCNode::Mesh) {
+        if (!node.same_faces || !node.prim
+            || !updateABCMesh(node.mesh, node.prim.get(), sample_index))
+            node.prim = foundABCMesh(node.mesh, sample_index, read_done);
+    } else if (node.kind == ABCNode::Xform) {
+        node.xform = foundABCXform(node.xfm, sample_index);
+    } else if (node.kind == ABCNode::Camera) {
+        node.camera_info = foundABCCamera(node.cam, sample_index, read_done);
+    }
+    node.sample = sample_index;
+}
+
+// ogawa archives are opened with a stream per thread, so that objects can be
+// read concurrently, hdf5 ones can only be read by one thread at a time
+static Alembic::AbcGeom::IArchive readABC(std::string const &path, bool &concurrent) {
     std::string hdr;
     {
         char buf[5];
@@ -300,17 +374,28 @@ static Alembic::AbcGeom::IArchive readABC(std::string const &path) {
     }
     if (hdr == "\x89HDF") {
         log_info("[alembic] opening as HDF5 format");
+        concurrent = false;
         return {Alembic::AbcCoreHDF5::ReadArchive(), path};
     } else if (hdr == "Ogaw") {
         log_info("[alembic] opening as Ogawa format");
-        return {Alembic::AbcCoreOgawa::ReadArchive(), path};
+        concurrent = true;
+        size_t nstreams = std::max(1u, std::thread::hardware_concurrency());
+        return {Alembic::AbcCoreOgawa::ReadArchive(nstreams), path};
     } else {
         throw Exception("[alembic] unrecognized ABC header: [" + hdr + "]");
     }
 }
 
+// the archive is indexed once, then each frame only reads the objects whose
+// sample differs from the one they were read at last, the tree of the frame
+// refers to the prims kept by the reader, which are updated in place by the
+// next frame; so accessors give out copies of them, and a tree is only valid
+// until the next frame is read
 struct ReadAlembic : INode {
     Alembic::Abc::v12::IArchive archive;
+    std::string opened_path;
+    bool concurrent = false;
+    std::vector<ABCNode> nodes;
     bool read_done = false;
     virtual void apply() override {
         int frameid;
@@ -319,21 +404,53 @@ struct ReadAlembic : INode {
         } else {
             frameid = getGlobalState()->frameid;
         }
-        auto abctree = std::make_shared<ABCTree>();
-        {
-            auto path = get_input<StringObject>("path")->get();
-            if (read_done == false) {
-                archive = readABC(path);
-            }
-            double start, _end;
-            GetArchiveStartAndEndTime(archive, start, _end);
-            // fmt::print("GetArchiveStartAndEndTime: {}\n", start);
-            // fmt::print("archive.getNumTimeSamplings: {}\n", archive.getNumTimeSamplings());
+        auto path = get_input<StringObject>("path")->get();
+        if (read_done == false || path != opened_path) {
+            nodes.clear();
+            archive = readABC(path, concurrent);
+            opened_path = path;
+            read_done = false;
             auto obj = archive.getTop();
-            traverseABC(obj, *abctree, frameid, read_done);
-            read_done = true;
+            indexABC(obj, -1, nodes);
+        }
+
+        std::vector<std::pair<int, int>> todo;
+        for (int i = 0; i < nodes.size(); i++) {
+            int sample_index = nodeSampleIndex(nodes[i], frameid);
+            if (sample_index != nodes[i].sample)
+                todo.emplace_back(i, sample_index);
+        }
+        if (concurrent && read_done) {
+            std::vector<std::exception_ptr> errors(todo.size());
+            parallel_for(todo.size(), [&] (size_t t) {
+                try {
+                    readABCNode(nodes[todo[t].first], todo[t].second, true);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+            for (auto const &e: errors)
+                if (e)
+                    std::rethrow_exception(e);
+        } else {
+            for (auto [i, sample_index]: todo)
+                readABCNode(nodes[i], sample_index, read_done);
+        }
+        read_done = true;
+
+        std::vector<std::shared_ptr<ABCTree>> trees(nodes.size());
+        for (int i = 0; i < nodes.size(); i++) {
+            auto const &node = nodes[i];
+            auto tree = std::make_shared<ABCTree>();
+            tree->name = node.name;
+            tree->prim = node.prim;
+            tree->xform = node.xform;
+            tree->camera_info = node.camera_info;
+            if (node.parent >= 0)
+                trees[node.parent]->children.push_back(tree);
+            trees[i] = std::move(tree);
         }
-        set_output("abctree", std::move(abctree));
+        set_output("abctree", std::move(trees[0]));
     }
 };
 
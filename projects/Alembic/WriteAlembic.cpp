@@ -6,12 +6,20 @@
 #include <zeno/types/PrimitiveObject.h>
 #include <zeno/types/NumericObject.h>
 #include <zeno/extra/GlobalState.h>
+#include <zeno/para/parallel_for.h>
 #include <Alembic/AbcGeom/All.h>
 #include <Alembic/AbcCoreAbstract/All.h>
 #include <Alembic/AbcCoreOgawa/All.h>
 #include <Alembic/AbcCoreHDF5/All.h>
 #include <Alembic/Abc/ErrorHandler.h>
 #include "ABCTree.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <cstring>
 #include <cstdio>
 #include <zeno/utils/log.h>
@@ -21,13 +29,184 @@ using namespace Alembic::AbcGeom;
 namespace zeno {
 namespace {
 
+// the arrays of one frame, copied out of the prim, so that the prim can be
+// changed by the graph while the frame is being written
+struct MeshFrame {
+    std::vector<V3f> verts;
+    // the faces and uvs are left out when they are the same as the previous
+    // frame, the sample then refers to the previous one in the archive
+    bool same_faces = false;
+    std::vector<int32_t> face_indices;
+    std::vector<int32_t> face_counts;
+    bool has_uvs = false;
+    std::vector<V2f> uvs;
+    std::vector<uint32_t> uv_indices;
+};
+
+// runs jobs in order on a thread of its own, at most `limit` jobs are queued
+// and pushing waits until there is room; an exception thrown by a job is
+// rethrown from the next push or wait
+struct WriterThread {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    std::exception_ptr error;
+    bool stop = false;
+    std::thread thread;
+
+    WriterThread() : thread([this] { run(); }) {}
+
+    ~WriterThread() {
+        {
+            std::lock_guard lck(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    void push(std::function<void()> job, std::size_t limit = 2) {
+        std::unique_lock lck(mtx);
+        cv.wait(lck, [&] { return jobs.size() < limit; });
+        if (error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+        jobs.push_back(std::move(job));
+        cv.notify_all();
+    }
+
+    // until every job queued is done
+    void wait() {
+        std::unique_lock lck(mtx);
+        cv.wait(lck, [&] { return jobs.empty(); });
+        if (error)
+            std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock lck(mtx);
+                cv.wait(lck, [&] { return stop || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = jobs.front();
+            }
+            std::exception_ptr err;
+            try {
+                job();
+            } catch (std::exception const &e) {
+                log_error("[alembic] failed to write: {}", e.what());
+                err = std::current_exception();
+            } catch (...) {
+                err = std::current_exception();
+            }
+            {
+                std::lock_guard lck(mtx);
+                jobs.pop_front();
+                if (err && !error)
+                    error = err;
+            }
+            cv.notify_all();
+        }
+    }
+};
+
+template <class T>
+static bool same_array(std::vector<T> const &prev, std::vector<T> const &curr) {
+    return prev.size() == curr.size() && !std::memcmp(prev.data(), curr.data(), curr.size() * sizeof(T));
+}
+
+// the frames are copied out of the prim on the graph's thread, then written
+// by a thread of the node, while the graph goes on with the next frame; the
+// archive and the mesh are only touched by that thread
 struct WriteAlembic : INode {
     OArchive archive;
     OPolyMesh meshyObj;
+    bool writing = false;
+    bool has_prev = false;
+    std::vector<zeno::vec3i> prev_tris;
+    std::vector<zeno::vec3f> prev_uvs[3];
+    bool prev_has_uvs = false;
+    WriterThread writer;  // last, so it is joined before the archive is closed
+
+    std::shared_ptr<MeshFrame> snapshot(PrimitiveObject *prim) {
+        auto frame = std::make_shared<MeshFrame>();
+        frame->verts.resize(prim->verts.size());
+        std::memcpy(frame->verts.data(), prim->verts.data(), prim->verts.size() * sizeof(V3f));
+
+        bool has_uvs = prim->tris.has_attr("uv0") && prim->tris.has_attr("uv1") && prim->tris.has_attr("uv2");
+        frame->same_faces = has_prev && same_array(prev_tris, prim->tris.values) && has_uvs == prev_has_uvs;
+        if (frame->same_faces && has_uvs) {
+            for (int k = 0; k < 3; k++) {
+                auto &uv = prim->tris.attr<zeno::vec3f>("uv" + std::to_string(k));
+                if (!same_array(prev_uvs[k], uv)) {
+                    frame->same_faces = false;
+                    break;
+                }
+            }
+        }
+        if (frame->same_faces)
+            return frame;
+
+        std::size_t ntris = prim->tris.size();
+        frame->face_indices.resize(ntris * 3);
+        frame->face_counts.assign(ntris, 3);
+        parallel_for(ntris, [&] (std::size_t i) {
+            for (int k = 0; k < 3; k++)
+                frame->face_indices[i * 3 + k] = prim->tris[i][k];
+        });
+        has_prev = true;
+        prev_tris = prim->tris.values;
+        prev_has_uvs = has_uvs;
+        frame->has_uvs = has_uvs;
+        if (has_uvs) {
+            auto& uv0 = prim->tris.attr<zeno::vec3f>("uv0");
+            auto& uv1 = prim->tris.attr<zeno::vec3f>("uv1");
+            auto& uv2 = prim->tris.attr<zeno::vec3f>("uv2");
+            frame->uvs.resize(ntris * 3);
+            frame->uv_indices.resize(ntris * 3);
+            parallel_for(ntris, [&] (std::size_t i) {
+                frame->uvs[i * 3 + 0] = V2f(uv0[i][0], uv0[i][1]);
+                frame->uvs[i * 3 + 1] = V2f(uv1[i][0], uv1[i][1]);
+                frame->uvs[i * 3 + 2] = V2f(uv2[i][0], uv2[i][1]);
+                for (int k = 0; k < 3; k++)
+                    frame->uv_indices[i * 3 + k] = (uint32_t)(i * 3 + k);
+            });
+            prev_uvs[0] = uv0;
+            prev_uvs[1] = uv1;
+            prev_uvs[2] = uv2;
+        } else {
+            for (auto &uv: prev_uvs)
+                uv.clear();
+        }
+        return frame;
+    }
+
+    void writeFrame(MeshFrame const &frame) {
+        OPolyMeshSchema &mesh = meshyObj.getSchema();
+        OPolyMeshSchema::Sample mesh_samp;
+        mesh_samp.setPositions(P3fArraySample(frame.verts.data(), frame.verts.size()));
+        if (!frame.same_faces) {
+            mesh_samp.setFaceIndices(Int32ArraySample(frame.face_indices.data(), frame.face_indices.size()));
+            mesh_samp.setFaceCounts(Int32ArraySample(frame.face_counts.data(), frame.face_counts.size()));
+        }
+        // UVs and Normals use GeomParams, which can be written or read
+        // as indexed or not, as you'd like.
+        OV2fGeomParam::Sample uvsamp;
+        if (frame.has_uvs) {
+            uvsamp.setVals(V2fArraySample(frame.uvs.data(), frame.uvs.size()));
+            uvsamp.setIndices(UInt32ArraySample(frame.uv_indices.data(), frame.uv_indices.size()));
+            uvsamp.setScope(kFacevaryingScope);
+            mesh_samp.setUVs(uvsamp);
+        }
+        mesh.set(mesh_samp);
+    }
+
     virtual void apply() override {
         int frameid;
         if (has_input("frameid")) {
-            frameid = get_param<int>("frameid");
+            frameid = get_input<NumericObject>("frameid")->get<int>();
         } else {
             frameid = getGlobalState()->frameid;
         }
@@ -35,67 +214,41 @@ struct WriteAlembic : INode {
         int frame_end = get_param<int>("frame_end");
         if (frameid == frame_start) {
             std::string path = get_param<std::string>("path");
-            archive = {Alembic::AbcCoreOgawa::WriteArchive(), path};
-            archive.addTimeSampling(TimeSampling(1.0/24, frame_start / 24.0));
-            meshyObj = OPolyMesh( OObject( archive, 1 ), "mesh" );
+            has_prev = false;
+            prev_tris.clear();
+            prev_has_uvs = false;
+            for (auto &uv: prev_uvs)
+                uv.clear();
+            writing = true;
+            writer.push([this, path, frame_start] {
+                meshyObj = OPolyMesh();
+                archive = {Alembic::AbcCoreOgawa::WriteArchive(), path};
+                archive.addTimeSampling(TimeSampling(1.0/24, frame_start / 24.0));
+                meshyObj = OPolyMesh( OObject( archive, 1 ), "mesh" );
+                // Create a PolyMesh class.
+                OPolyMeshSchema &mesh = meshyObj.getSchema();
+                mesh.setTimeSampling(1);
+                // some apps can arbitrarily name their primary UVs, this function allows
+                // you to do that, and must be done before the first time you set UVs
+                // on the schema
+                mesh.setUVSourceName("main_uv");
+            });
         }
         auto prim = get_input<PrimitiveObject>("prim");
-        if (frame_start <= frameid && frameid <= frame_end) {
-            // Create a PolyMesh class.
-            OPolyMeshSchema &mesh = meshyObj.getSchema();
-            mesh.setTimeSampling(1);
-
-            // some apps can arbitrarily name their primary UVs, this function allows
-            // you to do that, and must be done before the first time you set UVs
-            // on the schema
-            mesh.setUVSourceName("main_uv");
-
-            // Set a mesh sample.
-            // We're creating the sample inline here,
-            // but we could create a static sample and leave it around,
-            // only modifying the parts that have changed.
-            std::vector<int32_t> vertex_index_per_face;
-            std::vector<int32_t> vertex_count_per_face;
-            for (auto i = 0; i < prim->tris.size(); i++) {
-                vertex_index_per_face.push_back(prim->tris[i][0]);
-                vertex_index_per_face.push_back(prim->tris[i][1]);
-                vertex_index_per_face.push_back(prim->tris[i][2]);
-            }
-            vertex_count_per_face.resize(prim->tris.size(), 3);
-            if (prim->tris.has_attr("uv0")) {
-                std::vector<zeno::vec2f> uv_data;
-                std::vector<uint32_t> uv_indices;
-                auto& uv0 = prim->tris.attr<zeno::vec3f>("uv0");
-                auto& uv1 = prim->tris.attr<zeno::vec3f>("uv1");
-                auto& uv2 = prim->tris.attr<zeno::vec3f>("uv2");
-                for (auto i = 0; i < prim->tris.size(); i++) {
-                    uv_data.emplace_back(uv0[i][0], uv0[i][1]);
-                    uv_data.emplace_back(uv1[i][0], uv1[i][1]);
-                    uv_data.emplace_back(uv2[i][0], uv2[i][1]);
-                    uv_indices.push_back(uv_indices.size());
-                    uv_indices.push_back(uv_indices.size());
-                    uv_indices.push_back(uv_indices.size());
-                }
-
-                // UVs and Normals use GeomParams, which can be written or read
-                // as indexed or not, as you'd like.
-                OV2fGeomParam::Sample uvsamp;
-                uvsamp.setVals(V2fArraySample( (const V2f *)uv_data.data(), uv_data.size()));
-                uvsamp.setIndices(UInt32ArraySample( uv_indices.data(), uv_indices.size() ));
-                uvsamp.setScope(kFacevaryingScope);
-                OPolyMeshSchema::Sample mesh_samp(
-                    V3fArraySample( ( const V3f * )prim->verts.data(), prim->verts.size() ),
-                    Int32ArraySample( vertex_index_per_face.data(), vertex_index_per_face.size() ),
-                    Int32ArraySample( vertex_count_per_face.data(), vertex_count_per_face.size() ),
-                    uvsamp);
-
-                mesh.set( mesh_samp );
-            } else {
-                OPolyMeshSchema::Sample mesh_samp(
-                    V3fArraySample( ( const V3f * )prim->verts.data(), prim->verts.size() ),
-                    Int32ArraySample( vertex_index_per_face.data(), vertex_index_per_face.size() ),
-                    Int32ArraySample( vertex_count_per_face.data(), vertex_count_per_face.size() ));
-                mesh.set( mesh_samp );
+        if (writing && frame_start <= frameid && frameid <= frame_end) {
+            auto frame = snapshot(prim.get());
+            writer.push([this, frame = std::move(frame)] {
+                writeFrame(*frame);
+            });
+            if (frameid == frame_end) {
+                // the archive is complete once it is closed, which is waited
+                // for, so that the file can be read as soon as this returns
+                writing = false;
+                writer.push([this] {
+                    meshyObj = OPolyMesh();
+                    archive = OArchive();
+                });
+                writer.wait();
             }
         }
     }
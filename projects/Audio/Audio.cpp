@@ -10,6 +10,12 @@
 #include "aquila/aquila/aquila.h"
 #include <deque>
 #include <zeno/types/ListObject.h>
+#include <zeno/utils/mapped_file.h>
+#include <zeno/para/parallel_for.h>
+#include <zeno/utils/Error.h>
+#include <filesystem>
+#include <cstring>
+#include <mutex>
 #include "AudioFile.h"
 
 #define MINIMP3_IMPLEMENTATION
@@ -17,11 +23,207 @@
 #include "minimp3.h"
 
 namespace zaudio {
-int calcFrameCountByAudio(std::string path, int fps) {
+// the first channel of an audio file, decoded to floats
+struct AudioPCM {
+    std::vector<float> samples;
+    int sampleRate = 0;
+    int bitDepth = 0;
+};
+
+template <class Convert>
+static void convertWav(AudioPCM &pcm, unsigned char const *data, std::size_t blockAlign, Convert convert) {
+    zeno::parallel_for(pcm.samples.size(), [&] (std::size_t i) {
+        pcm.samples[i] = convert(data + i * blockAlign);
+    });
+}
+
+// reads a .wav file of pcm or float samples straight from the mapped file,
+// gives false for anything else, which is then left to AudioFile
+static bool readWavMapped(std::string const &path, AudioPCM &pcm) {
+    zeno::mapped_file file(path);
+    auto base = (unsigned char const *)file.data();
+    std::size_t size = file.size();
+    if (size < 12 || std::memcmp(base, "RIFF", 4) || std::memcmp(base + 8, "WAVE", 4))
+        return false;
+    auto u16 = [] (unsigned char const *p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8); };
+    auto u32 = [] (unsigned char const *p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    };
+
+    uint32_t audioFormat = 0, numChannels = 0, sampleRate = 0, blockAlign = 0, bitDepth = 0;
+    unsigned char const *data = nullptr;
+    std::size_t dataSize = 0;
+    for (std::size_t pos = 12; pos + 8 <= size;) {
+        auto chunk = base + pos;
+        std::size_t chunkSize = u32(chunk + 4);
+        std::size_t avail = std::min(chunkSize, size - pos - 8);
+        if (!std::memcmp(chunk, "fmt ", 4) && avail >= 16) {
+            audioFormat = u16(chunk + 8);
+            numChannels = u16(chunk + 10);
+            sampleRate = u32(chunk + 12);
+            blockAlign = u16(chunk + 20);
+            bitDepth = u16(chunk + 22);
+            // extensible formats keep the actual one in the sub format guid
+            if (audioFormat == 0xFFFE && avail >= 26)
+                audioFormat = u16(chunk + 32);
+        } else if (!std::memcmp(chunk, "data", 4)) {
+            data = chunk + 8;
+            dataSize = avail;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (!data || !numChannels || blockAlign != numChannels * (bitDepth / 8))
+        return false;
+    if (!(audioFormat == 1 && (bitDepth == 8 || bitDepth == 16 || bitDepth == 24 || bitDepth == 32))
+        && !(audioFormat == 3 && bitDepth == 32))
+        return false;
+
+    pcm.sampleRate = (int)sampleRate;
+    pcm.bitDepth = (int)bitDepth;
+    pcm.samples.resize(dataSize / blockAlign);
+    // the same scales as AudioFile
+    if (audioFormat == 3) {
+        convertWav(pcm, data, blockAlign, [] (unsigned char const *p) {
+            float val;
+            std::memcpy(&val, p, sizeof(val));
+            return val;
+        });
+    } else if (bitDepth == 8) {
+        convertWav(pcm, data, blockAlign, [] (unsigned char const *p) {
+            return (float)(p[0] - 128) / 128.f;
+        });
+    } else if (bitDepth == 16) {
+        convertWav(pcm, data, blockAlign, [&] (unsigned char const *p) {
+            return (float)(int16_t)u16(p) / 32768.f;
+        });
+    } else if (bitDepth == 24) {
+        convertWav(pcm, data, blockAlign, [] (unsigned char const *p) {
+            int32_t val = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+            return (float)val / 8388608.f;
+        });
+    } else {
+        convertWav(pcm, data, blockAlign, [&] (unsigned char const *p) {
+            return (float)(int32_t)u32(p) / (float)std::numeric_limits<int32_t>::max();
+        });
+    }
+    return true;
+}
+
+static void readWav(std::string const &path, AudioPCM &pcm) {
+    if (readWavMapped(path, pcm))
+        return;
     AudioFile<float> wav;
     wav.load (path);
-    uint64_t ret = wav.getNumSamplesPerChannel();
-    ret = ret * fps / wav.getSampleRate();
+    pcm.sampleRate = (int)wav.getSampleRate();
+    pcm.bitDepth = (int)wav.getBitDepth();
+    if (wav.getNumChannels() > 0)
+        pcm.samples = std::move(wav.samples[0]);
+}
+
+static void readMp3(std::string const &path, AudioPCM &pcm) {
+    zeno::mapped_file file(path);
+    auto data = (uint8_t const *)file.data();
+    std::size_t size = file.size();
+
+    mp3dec_t mp3d;
+    mp3dec_init(&mp3d);
+
+    mp3dec_frame_info_t info{};
+    float frame[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    std::size_t mp3len = 0;
+
+    auto &decoded_data = pcm.samples;
+    decoded_data.reserve(44100 * 30);
+    while (mp3len < size) {
+        int samples = mp3dec_decode_frame(&mp3d, data + mp3len, (int)(size - mp3len), frame, &info);
+        if (samples == 0) {
+            break;
+        }
+        mp3len += info.frame_bytes;
+        pcm.sampleRate = info.hz;
+        std::size_t base = decoded_data.size();
+        decoded_data.resize(base + samples);
+        for (auto i = 0; i < samples; i++) {
+            decoded_data[base + i] = frame[i * info.channels];
+        }
+    }
+}
+
+// decoded files are kept until they change on disk, so that a node reading
+// the same song on every frame decodes it only once; the few files used last
+// are kept
+static std::shared_ptr<AudioPCM const> loadPCM(std::string const &path, bool mp3) {
+    struct Entry {
+        std::string path;
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<AudioPCM const> pcm;
+    };
+    static std::mutex mtx;
+    static std::deque<Entry> cache;
+    constexpr std::size_t kMaxFiles = 8;
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    std::lock_guard lck(mtx);
+    for (auto it = cache.begin(); it != cache.end(); ++it) {
+        if (it->path == path) {
+            auto entry = std::move(*it);
+            cache.erase(it);
+            if (ec || entry.mtime != mtime)
+                break;
+            cache.push_front(entry);
+            return entry.pcm;
+        }
+    }
+
+    auto pcm = std::make_shared<AudioPCM>();
+    if (mp3)
+        readMp3(path, *pcm);
+    else
+        readWav(path, *pcm);
+    zeno::log_info("audio: decoded {} samples at {} Hz from {}", pcm->samples.size(), pcm->sampleRate, path);
+    if (!ec) {
+        cache.push_front({path, mtime, pcm});
+        if (cache.size() > kMaxFiles)
+            cache.pop_back();
+    }
+    return pcm;
+}
+
+static std::shared_ptr<zeno::PrimitiveObject> makeWavePrim(AudioPCM const &pcm) {
+    auto result = std::make_shared<zeno::PrimitiveObject>(); // std::shared_ptr<PrimitiveObject>
+    result->resize(pcm.samples.size());
+    auto &value = result->add_attr<float>("value"); //std::vector<float>
+    auto &t = result->add_attr<float>("t");
+    zeno::parallel_for(result->verts.size(), [&] (std::size_t i) {
+        value[i] = pcm.samples[i];
+        t[i] = float(i);
+    });
+    return result;
+}
+
+// fft plans of each length, created once per thread: an ooura plan is not
+// reentrant, as every transform rewrites its bit reversal table in place
+static std::shared_ptr<Aquila::Fft> getFftPlan(std::size_t length) {
+    thread_local std::map<std::size_t, std::shared_ptr<Aquila::Fft>> plans;
+    auto &plan = plans[length];
+    if (!plan)
+        plan = Aquila::FftFactory::getFft(length);
+    return plan;
+}
+
+static double spectrumEnergy(Aquila::SpectrumType const &spectrums, int duration_count) {
+    double E = 0;
+    for (const auto& spectrum: spectrums) {
+        E += spectrum.real() * spectrum.real() + spectrum.imag() * spectrum.imag();
+    }
+    return E / duration_count;
+}
+
+int calcFrameCountByAudio(std::string path, int fps) {
+    auto pcm = loadPCM(path, false);
+    uint64_t ret = pcm->samples.size();
+    ret = ret * fps / pcm->sampleRate;
     return ret + 1;
 }
 
@@ -33,24 +235,14 @@ namespace zeno {
     struct ReadWavFile : zeno::INode {
         virtual void apply() override {
             auto path = get_input<StringObject>("path")->get(); // std::string
-            AudioFile<float> wav;
-            wav.load (path);
-            wav.printSummary();
-
-            auto result = std::make_shared<PrimitiveObject>(); // std::shared_ptr<PrimitiveObject>
-            result->resize(wav.getNumSamplesPerChannel());
-            auto &value = result->add_attr<float>("value"); //std::vector<float>
-            auto &t = result->add_attr<float>("t");
-
-            for (std::size_t i = 0; i < result->verts.size(); ++i) {
-                value[i] = wav.samples[0][i];
-                t[i] = float(i);
-            }
+            auto pcm = zaudio::loadPCM(path, false);
+            auto result = zaudio::makeWavePrim(*pcm);
+            float lengthInSeconds = pcm->sampleRate ? (float)pcm->samples.size() / pcm->sampleRate : 0.f;
 
-            result->userData().set("SampleRate", std::make_shared<zeno::NumericObject>((int)wav.getSampleRate()));
-            result->userData().set("BitDepth", std::make_shared<zeno::NumericObject>((int)wav.getBitDepth()));
-            result->userData().set("NumSamplesPerChannel", std::make_shared<zeno::NumericObject>((int)wav.getNumSamplesPerChannel()));
-            result->userData().set("LengthInSeconds", std::make_shared<zeno::NumericObject>((float)wav.getLengthInSeconds()));
+            result->userData().set("SampleRate", std::make_shared<zeno::NumericObject>((int)pcm->sampleRate));
+            result->userData().set("BitDepth", std::make_shared<zeno::NumericObject>((int)pcm->bitDepth));
+            result->userData().set("NumSamplesPerChannel", std::make_shared<zeno::NumericObject>((int)pcm->samples.size()));
+            result->userData().set("LengthInSeconds", std::make_shared<zeno::NumericObject>(lengthInSeconds));
 
             set_output("wave",result);
         }
@@ -72,42 +264,10 @@ namespace zeno {
         virtual void apply() override {
             auto path = get_input<StringObject>("path")->get(); // std::string
 
-            // open the file:
-            std::ifstream file(path, std::ios::binary);
-            // read the data:
-            auto data = std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-
-            static mp3dec_t mp3d;
-            mp3dec_init(&mp3d);
-
-            mp3dec_frame_info_t info;
-            float pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
-            int mp3len = 0;
-            int sample_len = 0;
-
-            std::vector<float> decoded_data;
-            decoded_data.reserve(44100 * 30);
-            while (true) {
-                int samples = mp3dec_decode_frame(&mp3d, data.data() + mp3len, data.size() - mp3len, pcm, &info);
-                if (samples == 0) {
-                    break;
-                }
-                sample_len += samples;
-                mp3len += info.frame_bytes;
-                for (auto i = 0; i < samples * info.channels; i += info.channels) {
-                    decoded_data.push_back(pcm[i]);
-                }
-            }
-            auto result = std::make_shared<PrimitiveObject>(); // std::shared_ptr<PrimitiveObject>
-            result->resize(sample_len);
-            auto &value = result->add_attr<float>("value"); //std::vector<float>
-            auto &t = result->add_attr<float>("t");
-            for (std::size_t i = 0; i < result->verts.size(); ++i) {
-                value[i] = decoded_data[i];
-                t[i] = float(i);
-            }
-            result->userData().set("SampleRate",std::make_shared<zeno::NumericObject>((int)info.hz));
-            result->userData().set("NumSamplesPerChannel", std::make_shared<zeno::NumericObject>((int)sample_len));
+            auto pcm = zaudio::loadPCM(path, true);
+            auto result = zaudio::makeWavePrim(*pcm);
+            result->userData().set("SampleRate",std::make_shared<zeno::NumericObject>((int)pcm->sampleRate));
+            result->userData().set("NumSamplesPerChannel", std::make_shared<zeno::NumericObject>((int)pcm->samples.size()));
 
             set_output("wave", result);
         }
@@ -135,7 +295,7 @@ namespace zeno {
             float sampleFrequency = wave->userData().get<zeno::NumericObject>("SampleRate")->get<float>();
             int start_index = int(sampleFrequency * start_time);
             int duration_count = 1024;
-            auto fft = Aquila::FftFactory::getFft(duration_count);
+            auto fft = zaudio::getFftPlan(duration_count);
             std::vector<double> samples;
             samples.resize(duration_count);
             for (auto i = 0; i < duration_count; i++) {
@@ -151,14 +311,7 @@ namespace zeno {
             }
             Aquila::SpectrumType spectrums = fft->fft(samples.data());
 
-            {
-                double E = 0;
-                for (const auto& spectrum: spectrums) {
-                    E += spectrum.real() * spectrum.real() + spectrum.imag() * spectrum.imag();
-                }
-                E /= duration_count;
-                H.push_back(E);
-            }
+            H.push_back(zaudio::spectrumEnergy(spectrums, duration_count));
 
             while (H.size() > 43) {
                 H.pop_front();
@@ -223,26 +376,21 @@ struct AudioEnergy : zeno::INode {
         auto wave = get_input<PrimitiveObject>("wave");
         int duration_count = 1024;
         if (init.empty()) {
-            auto fft = Aquila::FftFactory::getFft(duration_count);
+            auto &value = wave->attr<float>("value");
             int clip_count = wave->size() / duration_count;
-            init.reserve(clip_count);
-            for (auto i = 0; i < clip_count; i++) {
+            init.resize(clip_count);
+            zeno::parallel_for((std::size_t)clip_count, [&] (std::size_t i) {
                 std::vector<double> samples;
                 samples.resize(duration_count);
                 for (auto j = 0; j < duration_count; j++) {
-                    samples[j] = wave->attr<float>("value")[min(duration_count * i + j, wave->size()-1)];
-                }
-                Aquila::SpectrumType spectrums = fft->fft(samples.data());
-                {
-                    double E = 0;
-                    for (const auto& spectrum: spectrums) {
-                        E += spectrum.real() * spectrum.real() + spectrum.imag() * spectrum.imag();
-                    }
-                    E /= duration_count;
-                    minE = min(minE, E);
-                    maxE = max(maxE, E);
-                    init.push_back(E);
+                    samples[j] = value[min(duration_count * i + j, wave->size()-1)];
                 }
+                auto fft = zaudio::getFftPlan(duration_count);
+                init[i] = zaudio::spectrumEnergy(fft->fft(samples.data()), duration_count);
+            });
+            for (auto E: init) {
+                minE = min(minE, E);
+                maxE = max(maxE, E);
             }
 //            for (auto i = 0; i < clip_count; i++) {
 //                init[i] = init[i] / maxE;
@@ -265,18 +413,14 @@ struct AudioEnergy : zeno::INode {
         auto start_time = get_input2<float>("time");
         float sampleFrequency = wave->userData().get<zeno::NumericObject>("SampleRate")->get<float>();
         int start_index = int(sampleFrequency * start_time);
-        auto fft = Aquila::FftFactory::getFft(duration_count);
+        auto fft = zaudio::getFftPlan(duration_count);
         std::vector<double> samples;
         samples.resize(duration_count);
         for (auto i = 0; i < duration_count; i++) {
             samples[i] = wave->attr<float>("value")[min((start_index + i), wave->size()-1)];
         }
         Aquila::SpectrumType spectrums = fft->fft(samples.data());
-        double E = 0;
-        for (const auto& spectrum: spectrums) {
-            E += spectrum.real() * spectrum.real() + spectrum.imag() * spectrum.imag();
-        }
-        E /= duration_count;
+        double E = zaudio::spectrumEnergy(spectrums, duration_count);
         set_output("E", std::make_shared<NumericObject>((float)E));
         double uniE = (E - minE) / (maxE - minE);
         set_output("uniE", std::make_shared<NumericObject>((float)uniE));
@@ -356,7 +500,7 @@ struct AudioEnergy : zeno::INode {
                 }
             }
 
-            auto fft = Aquila::FftFactory::getFft(duration_count);
+            auto fft = zaudio::getFftPlan(duration_count);
             Aquila::SpectrumType spectrums = fft->fft(samples.data());
 
             auto fft_prim = std::make_shared<PrimitiveObject>();
@@ -395,6 +539,103 @@ struct AudioEnergy : zeno::INode {
             "audio"
         },
     });
+    // the spectra of all the windows of a wave, computed together in parallel
+    // with an fft plan per thread; the result is kept, and given again while
+    // the wave and the params stay the same
+    struct AudioSTFT : zeno::INode {
+        std::vector<float> m_samples;
+        std::vector<float> m_params;
+        std::shared_ptr<PrimitiveObject> m_spectrogram;
+
+        virtual void apply() override {
+            auto wave = get_input<PrimitiveObject>("wave");
+            auto &value = wave->attr<float>("value");
+            float sampleFrequency = wave->userData().get<zeno::NumericObject>("SampleRate")->get<float>();
+            int duration_count = get_input2<int>("windowSize");
+            int hop = get_input2<int>("hopSize");
+            auto pre_emphasis = get_input2<int>("preEmphasis");
+            auto alpha = get_input2<float>("preEmphasisAlpha");
+            auto hamming_window = get_input2<int>("hammingWindow");
+            if (duration_count < 2 || (duration_count & (duration_count - 1)))
+                throw makeError("windowSize must be a power of two");
+            if (hop < 1)
+                throw makeError("hopSize must be positive");
+
+            std::vector<float> params{(float)duration_count, (float)hop, (float)pre_emphasis, alpha,
+                                      (float)hamming_window, sampleFrequency};
+            if (!m_spectrogram || params != m_params || value != m_samples) {
+                std::size_t size = value.size();
+                std::size_t windows = size ? (size + hop - 1) / hop : 0;
+                std::size_t bins = duration_count / 2 + 1;
+                std::vector<double> hamming(duration_count, 1.0);
+                if (hamming_window) {
+                    for (auto i = 0; i < duration_count; i++) {
+                        hamming[i] = 0.54 - 0.46 * std::cos(2.0 * M_PI * i / (duration_count - 1));
+                    }
+                }
+
+                auto spectrogram = std::make_shared<PrimitiveObject>();
+                spectrogram->resize(windows * bins);
+                auto &pos = spectrogram->verts.values;
+                auto &t = spectrogram->add_attr<float>("t");
+                auto &freq = spectrogram->add_attr<float>("freq");
+                auto &power = spectrogram->add_attr<float>("power");
+                zeno::parallel_for(windows, [&] (std::size_t w) {
+                    std::size_t start_index = w * hop;
+                    std::vector<double> samples(duration_count + 1);
+                    for (auto i = 0; i < duration_count + 1; i++) {
+                        samples[i] = value[min(start_index + i, size - 1)];
+                    }
+                    if (pre_emphasis) {
+                        for (auto i = 0; i < duration_count; i++) {
+                            samples[i] = samples[i+1] - alpha * samples[i];
+                        }
+                    }
+                    for (auto i = 0; i < duration_count; i++) {
+                        samples[i] *= hamming[i];
+                    }
+                    auto fft = zaudio::getFftPlan(duration_count);
+                    Aquila::SpectrumType spectrums = fft->fft(samples.data());
+                    for (std::size_t b = 0; b < bins; b++) {
+                        std::size_t k = w * bins + b;
+                        float r = spectrums[b].real();
+                        float im = spectrums[b].imag();
+                        pos[k] = zeno::vec3f(w, b, 0);
+                        t[k] = start_index / sampleFrequency;
+                        freq[k] = float(b);
+                        power[k] = (r * r + im * im) / duration_count;
+                    }
+                });
+                spectrogram->userData().set("WindowCount", std::make_shared<zeno::NumericObject>((int)windows));
+                spectrogram->userData().set("BinCount", std::make_shared<zeno::NumericObject>((int)bins));
+                spectrogram->userData().set("WindowSize", std::make_shared<zeno::NumericObject>(duration_count));
+                spectrogram->userData().set("HopSize", std::make_shared<zeno::NumericObject>(hop));
+                spectrogram->userData().set("SampleRate", std::make_shared<zeno::NumericObject>(sampleFrequency));
+
+                m_samples = value;
+                m_params = std::move(params);
+                m_spectrogram = std::move(spectrogram);
+            }
+            set_output("spectrogram", m_spectrogram->clone());
+        }
+    };
+    ZENDEFNODE(AudioSTFT, {
+        {
+            "wave",
+            {"int", "windowSize", "1024"},
+            {"int", "hopSize", "512"},
+            {"bool", "preEmphasis", "0"},
+            {"float", "preEmphasisAlpha", "0.97"},
+            {"bool", "hammingWindow", "1"},
+        },
+        {
+            "spectrogram",
+        },
+        {},
+        {
+            "audio"
+        },
+    });
     struct MelFilter : zeno::INode {
         virtual void apply() override {
             auto fftPrim = get_input<PrimitiveObject>("FFTPrim");
@@ -3,6 +3,13 @@
 #include <zeno/types/StringObject.h>
 #include <zeno/utils/string.h>
 #include <zeno/utils/vec.h>
+#include <zeno/utils/mapped_file.h>
+#include <zeno/para/parallel_for.h>
+#include <zeno/para/parallel_reduce.h>
+#include <zeno/para/parallel_scan.h>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
@@ -15,6 +22,517 @@
 #define TINYPLY_IMPLEMENTATION
 #include "primplyio_tinyply.h"
 
+namespace {
+
+// binary ply files are read straight from the mapped file: the vertex
+// records have a fixed size, so their properties are converted in parallel
+// into the attributes, and faces go to tris, or to polys when not all of
+// them are triangles
+
+enum class PlyType {
+    Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid,
+};
+
+PlyType ply_type(std::string_view s) {
+    if (s == "char" || s == "int8") return PlyType::Int8;
+    if (s == "uchar" || s == "uint8") return PlyType::UInt8;
+    if (s == "short" || s == "int16") return PlyType::Int16;
+    if (s == "ushort" || s == "uint16") return PlyType::UInt16;
+    if (s == "int" || s == "int32") return PlyType::Int32;
+    if (s == "uint" || s == "uint32") return PlyType::UInt32;
+    if (s == "float" || s == "float32") return PlyType::Float32;
+    if (s == "double" || s == "float64") return PlyType::Float64;
+    return PlyType::Invalid;
+}
+
+std::size_t ply_size(PlyType t) {
+    constexpr std::size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return sizes[(int)t];
+}
+
+bool ply_is_float(PlyType t) {
+    return t == PlyType::Float32 || t == PlyType::Float64;
+}
+
+// calls f with a value of the c++ type of t
+template <class F>
+decltype(auto) ply_visit(PlyType t, F &&f) {
+    switch (t) {
+    case PlyType::Int8: return f(std::int8_t{});
+    case PlyType::UInt8: return f(std::uint8_t{});
+    case PlyType::Int16: return f(std::int16_t{});
+    case PlyType::UInt16: return f(std::uint16_t{});
+    case PlyType::Int32: return f(std::int32_t{});
+    case PlyType::UInt32: return f(std::uint32_t{});
+    case PlyType::Float32: return f(float{});
+    default: return f(double{});
+    }
+}
+
+bool host_is_big_endian() {
+    std::uint16_t one = 1;
+    unsigned char b;
+    std::memcpy(&b, &one, 1);
+    return b == 0;
+}
+
+template <class T>
+T ply_load(char const *p, bool swap) {
+    T val;
+    if (swap) {
+        char b[sizeof(T)];
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            b[i] = p[sizeof(T) - 1 - i];
+        std::memcpy(&val, b, sizeof(T));
+    } else {
+        std::memcpy(&val, p, sizeof(T));
+    }
+    return val;
+}
+
+std::int64_t ply_load_int(PlyType t, char const *p, bool swap) {
+    return ply_visit(t, [&] (auto tag) {
+        return (std::int64_t)ply_load<decltype(tag)>(p, swap);
+    });
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Invalid;
+    PlyType countType = PlyType::Invalid;   // valid for list properties
+    std::size_t offset{};                   // in the record, if it has no lists
+};
+
+struct PlyElement {
+    std::string name;
+    std::size_t count{};
+    std::vector<PlyProperty> props;
+    std::size_t stride{};                   // zero if the records have lists
+};
+
+struct PlyHeader {
+    enum { Ascii, BinaryLE, BinaryBE } format = Ascii;
+    std::vector<PlyElement> elements;
+    std::size_t dataOffset{};
+};
+
+bool parse_ply_header(char const *data, std::size_t size, PlyHeader &header) {
+    std::size_t pos = 0;
+    bool first = true, hasFormat = false;
+    while (pos < size) {
+        std::size_t eol = std::find(data + pos, data + size, '\n') - data;
+        std::string_view line(data + pos, eol - pos);
+        pos = eol + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        std::vector<std::string_view> tok;
+        for (std::size_t i = 0; i < line.size();) {
+            std::size_t j = line.find_first_of(" \t", i);
+            if (j == std::string_view::npos) j = line.size();
+            if (j > i) tok.push_back(line.substr(i, j - i));
+            i = j + 1;
+        }
+        if (first) {
+            if (tok.size() != 1 || tok[0] != "ply")
+                return false;
+            first = false;
+        } else if (tok.empty() || tok[0] == "comment" || tok[0] == "obj_info") {
+        } else if (tok[0] == "format" && tok.size() >= 2) {
+            if (tok[1] == "ascii") header.format = PlyHeader::Ascii;
+            else if (tok[1] == "binary_little_endian") header.format = PlyHeader::BinaryLE;
+            else if (tok[1] == "binary_big_endian") header.format = PlyHeader::BinaryBE;
+            else return false;
+            hasFormat = true;
+        } else if (tok[0] == "element" && tok.size() == 3) {
+            auto &elm = header.elements.emplace_back();
+            elm.name = std::string(tok[1]);
+            elm.count = std::strtoull(std::string(tok[2]).c_str(), nullptr, 10);
+        } else if (tok[0] == "property" && !header.elements.empty()) {
+            PlyProperty prop;
+            if (tok.size() == 5 && tok[1] == "list") {
+                prop.countType = ply_type(tok[2]);
+                prop.type = ply_type(tok[3]);
+                prop.name = std::string(tok[4]);
+                if (prop.countType == PlyType::Invalid || ply_is_float(prop.countType))
+                    return false;
+            } else if (tok.size() == 3) {
+                prop.type = ply_type(tok[1]);
+                prop.name = std::string(tok[2]);
+            } else {
+                return false;
+            }
+            if (prop.type == PlyType::Invalid)
+                return false;
+            header.elements.back().props.push_back(std::move(prop));
+        } else if (tok[0] == "end_header") {
+            header.dataOffset = pos;
+            for (auto &elm: header.elements) {
+                std::size_t offset = 0;
+                bool fixed = true;
+                for (auto &prop: elm.props) {
+                    prop.offset = offset;
+                    if (prop.countType != PlyType::Invalid)
+                        fixed = false;
+                    offset += ply_size(prop.type);
+                }
+                elm.stride = fixed ? offset : 0;
+            }
+            return hasFormat && pos <= size;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// end of the record at p, or nullptr if it runs past end
+char const *ply_skip_record(PlyElement const &elm, char const *p, char const *end, bool swap) {
+    for (auto const &prop: elm.props) {
+        if (prop.countType != PlyType::Invalid) {
+            std::size_t cs = ply_size(prop.countType);
+            if ((std::size_t)(end - p) < cs)
+                return nullptr;
+            std::int64_t n = ply_load_int(prop.countType, p, swap);
+            p += cs;
+            if (n < 0 || (std::size_t)n > (std::size_t)(end - p) / ply_size(prop.type))
+                return nullptr;
+            p += n * ply_size(prop.type);
+        } else {
+            if ((std::size_t)(end - p) < ply_size(prop.type))
+                return nullptr;
+            p += ply_size(prop.type);
+        }
+    }
+    return p;
+}
+
+char const *ply_skip_element(PlyElement const &elm, char const *p, char const *end, bool swap) {
+    if (elm.stride) {
+        if (elm.count > (std::size_t)(end - p) / elm.stride)
+            return nullptr;
+        return p + elm.count * elm.stride;
+    }
+    for (std::size_t i = 0; i < elm.count && p; i++)
+        p = ply_skip_record(elm, p, end, swap);
+    return p;
+}
+
+void read_ply_vertices(zeno::PrimitiveObject *prim, PlyElement const &elm, char const *base, bool swap) {
+    std::size_t n = elm.count;
+    prim->verts.resize(n);
+
+    // where each property goes: a component of pos, nrm or clr, or an
+    // attribute of its own name, float or int as the property is
+    struct Target {
+        PlyProperty const *prop;
+        std::string attr;
+        int comp;
+        bool isInt;
+        float norm;
+        void *dst;
+    };
+    std::vector<Target> targets;
+    static const char *const vecNames[][4] = {
+        {"pos", "x", "y", "z"},
+        {"nrm", "nx", "ny", "nz"},
+        {"clr", "red", "green", "blue"},
+    };
+    for (auto const &prop: elm.props) {
+        Target t{&prop, prop.name, -1, false, 1.f, nullptr};
+        for (auto const &names: vecNames) {
+            for (int k = 0; k < 3; k++) {
+                if (prop.name == names[k + 1]) {
+                    t.attr = names[0];
+                    t.comp = k;
+                }
+            }
+        }
+        if ((t.comp != -1 && t.attr == "clr") || prop.name == "alpha") {
+            if (prop.type == PlyType::UInt8) t.norm = 255.f;
+            else if (prop.type == PlyType::UInt16) t.norm = 65535.f;
+        } else if (t.comp == -1) {
+            t.isInt = !ply_is_float(prop.type);
+        }
+        targets.push_back(std::move(t));
+    }
+    for (auto &t: targets) {
+        if (t.comp != -1) {
+            t.dst = (float *)prim->verts.add_attr<zeno::vec3f>(t.attr).data() + t.comp;
+        } else if (t.isInt) {
+            t.dst = prim->verts.add_attr<int>(t.attr).data();
+        } else {
+            t.dst = prim->verts.add_attr<float>(t.attr).data();
+        }
+    }
+
+    // a chunk of records stays in cache while each property is taken out
+    constexpr std::size_t kChunk = 16384;
+    std::size_t stride = elm.stride;
+    zeno::parallel_for((n + kChunk - 1) / kChunk, [&] (std::size_t c) {
+        std::size_t lo = c * kChunk, hi = std::min(n, lo + kChunk);
+        for (auto const &t: targets) {
+            ply_visit(t.prop->type, [&] (auto tag) {
+                using S = decltype(tag);
+                char const *p = base + lo * stride + t.prop->offset;
+                if (t.comp != -1) {
+                    float *dst = (float *)t.dst;
+                    for (std::size_t i = lo; i < hi; i++, p += stride)
+                        dst[i * 3] = (float)ply_load<S>(p, swap) / t.norm;
+                } else if (t.isInt) {
+                    int *dst = (int *)t.dst;
+                    for (std::size_t i = lo; i < hi; i++, p += stride)
+                        dst[i] = (int)ply_load<S>(p, swap);
+                } else {
+                    float *dst = (float *)t.dst;
+                    for (std::size_t i = lo; i < hi; i++, p += stride)
+                        dst[i] = (float)ply_load<S>(p, swap) / t.norm;
+                }
+            });
+        }
+    });
+}
+
+// returns the end of the face records, or nullptr if they are broken
+char const *read_ply_faces(zeno::PrimitiveObject *prim, PlyElement const &elm, char const *base,
+                           char const *end, bool swap) {
+    std::size_t n = elm.count;
+    auto it = std::find_if(elm.props.begin(), elm.props.end(), [] (PlyProperty const &prop) {
+        return prop.countType != PlyType::Invalid
+            && (prop.name == "vertex_indices" || prop.name == "vertex_index");
+    });
+    if (it == elm.props.end() || ply_is_float(it->type))
+        return ply_skip_element(elm, base, end, swap);
+    auto const &list = *it;
+    std::size_t cs = ply_size(list.countType), is = ply_size(list.type);
+    bool single = elm.props.size() == 1;
+
+    // counts[i] is the size of face i and listOffs[i] where its indices are
+    std::vector<int> counts(n);
+    std::vector<std::size_t> listOffs;
+    char const *p = base;
+    bool uniform = false;
+    if (single && n && cs <= (std::size_t)(end - base)) {
+        // all faces of the same size, as in most meshes, is checked with no
+        // need to walk the records one after another
+        std::int64_t c0 = ply_load_int(list.countType, base, swap);
+        std::size_t rec = cs + (std::size_t)std::max<std::int64_t>(c0, 0) * is;
+        if (c0 > 0 && n <= (std::size_t)(end - base) / rec) {
+            uniform = zeno::parallel_reduce(std::size_t(0), n, true, [] (bool a, bool b) {
+                return a && b;
+            }, [&] (std::size_t i) {
+                return ply_load_int(list.countType, base + i * rec, swap) == c0;
+            });
+        }
+        if (uniform) {
+            std::fill(counts.begin(), counts.end(), (int)c0);
+            p = base + n * rec;
+        }
+    }
+    if (!uniform) {
+        if (!single)
+            listOffs.resize(n);
+        for (std::size_t i = 0; i < n; i++) {
+            for (auto const &prop: elm.props) {
+                std::size_t ps = ply_size(prop.type);
+                if (prop.countType == PlyType::Invalid) {
+                    if ((std::size_t)(end - p) < ps)
+                        return nullptr;
+                    p += ps;
+                    continue;
+                }
+                std::size_t pcs = ply_size(prop.countType);
+                if ((std::size_t)(end - p) < pcs)
+                    return nullptr;
+                std::int64_t c = ply_load_int(prop.countType, p, swap);
+                p += pcs;
+                if (c < 0 || (std::size_t)c > (std::size_t)(end - p) / ps)
+                    return nullptr;
+                if (&prop == &list) {
+                    counts[i] = (int)c;
+                    if (!single)
+                        listOffs[i] = p - base;
+                }
+                p += c * ps;
+            }
+        }
+    }
+
+    bool allTris = std::all_of(counts.begin(), counts.end(), [] (int c) { return c == 3; });
+    std::vector<int> starts(n);
+    std::size_t nloops = zeno::parallel_exclusive_scan_sum(counts.begin(), counts.end(), starts.begin());
+    auto list_data = [&] (std::size_t i) {
+        if (!single)
+            return base + listOffs[i];
+        return base + i * cs + (std::size_t)starts[i] * is + cs;
+    };
+    ply_visit(list.type, [&] (auto tag) {
+        using S = decltype(tag);
+        if (allTris) {
+            prim->tris.resize(n);
+            zeno::parallel_for(n, [&] (std::size_t i) {
+                char const *q = list_data(i);
+                for (int k = 0; k < 3; k++)
+                    prim->tris[i][k] = (int)ply_load<S>(q + k * is, swap);
+            });
+        } else {
+            prim->polys.resize(n);
+            prim->loops.resize(nloops);
+            zeno::parallel_for(n, [&] (std::size_t i) {
+                char const *q = list_data(i);
+                prim->polys[i] = zeno::vec2i(starts[i], counts[i]);
+                for (int k = 0; k < counts[i]; k++)
+                    prim->loops[starts[i] + k] = (int)ply_load<S>(q + k * is, swap);
+            });
+        }
+    });
+    return p;
+}
+
+// false if the file is not a binary ply
+bool readply_binary(zeno::PrimitiveObject *prim, std::string const &path) {
+    zeno::mapped_file file(path);
+    PlyHeader header;
+    if (!parse_ply_header(file.data(), file.size(), header))
+        throw zeno::makeError("broken ply header: " + path);
+    if (header.format == PlyHeader::Ascii)
+        return false;
+    bool swap = (header.format == PlyHeader::BinaryBE) != host_is_big_endian();
+    char const *p = file.data() + header.dataOffset, *end = file.end();
+    for (auto const &elm: header.elements) {
+        char const *next = nullptr;
+        if (elm.name == "vertex" && elm.stride) {
+            if (elm.count <= (std::size_t)(end - p) / elm.stride) {
+                read_ply_vertices(prim, elm, p, swap);
+                next = p + elm.count * elm.stride;
+            }
+        } else if (elm.name == "face") {
+            next = read_ply_faces(prim, elm, p, end, swap);
+        } else {
+            next = ply_skip_element(elm, p, end, swap);
+        }
+        if (!next)
+            throw zeno::makeError("ply element `" + elm.name + "` is truncated: " + path);
+        p = next;
+    }
+    return true;
+}
+
+// writes a binary little endian ply, converting the records in batches so
+// that the memory used stays bounded
+void writeply_binary(zeno::PrimitiveObject const *prim, std::string const &path) {
+    FILE *fp = std::fopen(path.c_str(), "wb");
+    if (!fp)
+        throw zeno::makeError("failed to open " + path);
+
+    // 4-byte fields, except for colors which are stored as bytes
+    struct Field {
+        char const *src;
+        std::size_t srcStride;
+        bool isColor;
+    };
+    std::vector<Field> fields;
+    std::string props;
+    auto add_vec3f = [&] (zeno::vec3f const *arr, const char *const *names, bool isColor) {
+        for (int k = 0; k < 3; k++) {
+            fields.push_back({(char const *)arr + k * sizeof(float), sizeof(zeno::vec3f), isColor});
+            props += std::string("property ") + (isColor ? "uchar " : "float ") + names[k] + "\n";
+        }
+    };
+    static const char *const posNames[] = {"x", "y", "z"};
+    static const char *const nrmNames[] = {"nx", "ny", "nz"};
+    static const char *const clrNames[] = {"red", "green", "blue"};
+    add_vec3f(prim->verts.data(), posNames, false);
+    if (prim->verts.has_attr("nrm") && prim->verts.attr_is<zeno::vec3f>("nrm"))
+        add_vec3f(prim->verts.attr<zeno::vec3f>("nrm").data(), nrmNames, false);
+    if (prim->verts.has_attr("clr") && prim->verts.attr_is<zeno::vec3f>("clr"))
+        add_vec3f(prim->verts.attr<zeno::vec3f>("clr").data(), clrNames, true);
+    prim->verts.foreach_attr<std::variant<float, int>>([&] (auto const &key, auto const &arr) {
+        using T = std::decay_t<decltype(arr[0])>;
+        fields.push_back({(char const *)arr.data(), sizeof(T), false});
+        props += std::string("property ") + (std::is_same_v<T, int> ? "int " : "float ") + key + "\n";
+    });
+    std::size_t stride = 0;
+    for (auto const &f: fields)
+        stride += f.isColor ? 1 : 4;
+
+    std::size_t nfaces = prim->tris.size() + prim->quads.size() + prim->polys.size();
+    bool wideCounts = std::any_of(prim->polys.begin(), prim->polys.end(), [] (zeno::vec2i const &poly) {
+        return poly[1] > 255;
+    });
+    std::string head = "ply\nformat binary_little_endian 1.0\ncomment written by zeno\n";
+    head += "element vertex " + std::to_string(prim->verts.size()) + "\n" + props;
+    head += "element face " + std::to_string(nfaces) + "\n";
+    head += wideCounts ? "property list uint int vertex_indices\n" : "property list uchar int vertex_indices\n";
+    head += "end_header\n";
+    bool ok = std::fwrite(head.data(), 1, head.size(), fp) == head.size();
+
+    bool swap = host_is_big_endian();
+    auto store = [&] (char *dst, auto val) {
+        std::memcpy(dst, &val, sizeof(val));
+        if (swap)
+            std::reverse(dst, dst + sizeof(val));
+    };
+
+    constexpr std::size_t kBatch = 1 << 18;
+    std::vector<char> buf;
+    for (std::size_t lo = 0; ok && lo < prim->verts.size(); lo += kBatch) {
+        std::size_t hi = std::min(prim->verts.size(), lo + kBatch);
+        buf.resize((hi - lo) * stride);
+        zeno::parallel_for(lo, hi, [&] (std::size_t i) {
+            char *out = buf.data() + (i - lo) * stride;
+            for (auto const &f: fields) {
+                float val;
+                std::memcpy(&val, f.src + i * f.srcStride, 4);
+                if (f.isColor) {
+                    *out++ = (char)(std::uint8_t)std::clamp(val * 255.f + 0.5f, 0.f, 255.f);
+                } else {
+                    std::int32_t bits;
+                    std::memcpy(&bits, &val, 4);
+                    store(out, bits);
+                    out += 4;
+                }
+            }
+        });
+        ok = std::fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    }
+
+    // faces of a batch are placed by the running sum of their sizes
+    std::size_t countSize = wideCounts ? 4 : 1;
+    auto write_faces = [&] (std::size_t n, auto &&count, auto &&index) {
+        std::vector<std::size_t> offs;
+        for (std::size_t lo = 0; ok && lo < n; lo += kBatch) {
+            std::size_t hi = std::min(n, lo + kBatch);
+            offs.resize(hi - lo + 1);
+            offs[0] = 0;
+            for (std::size_t i = lo; i < hi; i++)
+                offs[i - lo + 1] = offs[i - lo] + countSize + 4 * count(i);
+            buf.resize(offs.back());
+            zeno::parallel_for(lo, hi, [&] (std::size_t i) {
+                char *out = buf.data() + offs[i - lo];
+                int c = count(i);
+                if (wideCounts) store(out, (std::uint32_t)c);
+                else *out = (char)(std::uint8_t)c;
+                out += countSize;
+                for (int k = 0; k < c; k++, out += 4)
+                    store(out, (std::int32_t)index(i, k));
+            });
+            ok = std::fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+        }
+    };
+    write_faces(prim->tris.size(), [] (std::size_t) { return 3; },
+                [&] (std::size_t i, int k) { return prim->tris[i][k]; });
+    write_faces(prim->quads.size(), [] (std::size_t) { return 4; },
+                [&] (std::size_t i, int k) { return prim->quads[i][k]; });
+    write_faces(prim->polys.size(), [&] (std::size_t i) { return prim->polys[i][1]; },
+                [&] (std::size_t i, int k) { return prim->loops[prim->polys[i][0] + k]; });
+
+    ok = !std::fclose(fp) && ok;
+    if (!ok)
+        throw zeno::makeError("failed to write " + path);
+}
+
+}
+
 
 static void readply(
     std::vector<zeno::vec3f> &verts,
@@ -88,10 +606,12 @@ struct ReadPlyPrimitive : zeno::INode {
     virtual void apply() override {
         auto path = get_input<zeno::StringObject>("path")->get();
         auto prim = std::make_shared<zeno::PrimitiveObject>();
-        auto &pos = prim->verts;
-        auto &tris = prim->tris;
-        readply(pos, tris, path);
-        prim->resize(pos.size());
+        if (!readply_binary(prim.get(), path)) {
+            auto &pos = prim->verts;
+            auto &tris = prim->tris;
+            readply(pos, tris, path);
+            prim->resize(pos.size());
+        }
         set_output("prim", std::move(prim));
     }
 };
@@ -147,11 +667,14 @@ static void writeply(
 
 struct WritePlyPrimitive : zeno::INode {
     virtual void apply() override {
-        std::cerr << "write\n";
         auto path = get_input<zeno::StringObject>("path")->get();
         auto prim = get_input<zeno::PrimitiveObject>("prim");
-        auto &pos = prim->attr<zeno::vec3f>("pos");
-        writeply(pos, prim->tris, path.c_str());
+        if (get_param<bool>("binary")) {
+            writeply_binary(prim.get(), path + ".ply");
+        } else {
+            auto &pos = prim->attr<zeno::vec3f>("pos");
+            writeply(pos, prim->tris, path.c_str());
+        }
     }
 };
 
@@ -171,6 +694,7 @@ ZENDEFNODE(
         },
         // params
         {
+            {"bool", "binary", "1"},
         },
         // category
         {
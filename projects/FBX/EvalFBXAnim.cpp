@@ -6,6 +6,7 @@
 #include <zeno/types/ListObject.h>
 #include <zeno/types/DictObject.h>
 #include <zeno/types/CameraObject.h>
+#include <zeno/para/parallel_for.h>
 
 #include "assimp/scene.h"
 
@@ -13,9 +14,76 @@
 
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 namespace {
 
+// the bone influences of every vertex, flattened: those of vertex i are at
+// [start[i], start[i + 1]) of bones and weights
+struct SkinWeights {
+    std::vector<int> start;
+    std::vector<int> bones;
+    std::vector<float> weights;
+};
+
+void skinLinear(SkinWeights const &skin, std::vector<glm::mat4> const &mats,
+                zeno::vec3f const *rest, zeno::vec3f *out, size_t n, float s) {
+    zeno::parallel_for(n, [&] (size_t i) {
+        auto const &pos = rest[i];
+        int b = skin.start[i], e = skin.start[i + 1];
+        glm::vec4 tpos(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int k = b; k < e; k++)
+            tpos += (mats[skin.bones[k]] * glm::vec4(pos[0], pos[1], pos[2], 1.0f)) * skin.weights[k];
+        if (b == e)
+            tpos = glm::vec4(pos[0], pos[1], pos[2], 1.0f);
+        out[i] = zeno::vec3f(tpos.x / tpos.w * s, tpos.y / tpos.w * s, tpos.z / tpos.w * s);
+    });
+}
+
+// each bone as a rotation and a translation, with its scale dropped
+struct DualQuat {
+    glm::quat real;
+    glm::quat dual;
+};
+
+DualQuat toDualQuat(glm::mat4 const &m) {
+    glm::vec3 t(m[3]);
+    glm::mat3 r(glm::normalize(glm::vec3(m[0])), glm::normalize(glm::vec3(m[1])), glm::normalize(glm::vec3(m[2])));
+    glm::quat q = glm::normalize(glm::quat_cast(r));
+    return {q, glm::quat(0.0f, t.x, t.y, t.z) * q * 0.5f};
+}
+
+void skinDualQuat(SkinWeights const &skin, std::vector<glm::mat4> const &mats,
+                  zeno::vec3f const *rest, zeno::vec3f *out, size_t n, float s) {
+    std::vector<DualQuat> dqs(mats.size());
+    for (size_t b = 0; b < mats.size(); b++)
+        dqs[b] = toDualQuat(mats[b]);
+    zeno::parallel_for(n, [&] (size_t i) {
+        auto const &pos = rest[i];
+        int b = skin.start[i], e = skin.start[i + 1];
+        if (b == e) {
+            out[i] = pos * s;
+            return;
+        }
+        glm::quat real(0.0f, 0.0f, 0.0f, 0.0f), dual(0.0f, 0.0f, 0.0f, 0.0f);
+        auto const &pivot = dqs[skin.bones[b]].real;
+        for (int k = b; k < e; k++) {
+            auto const &dq = dqs[skin.bones[k]];
+            // blend along the shortest arc
+            float w = glm::dot(pivot, dq.real) < 0.0f ? -skin.weights[k] : skin.weights[k];
+            real = real + dq.real * w;
+            dual = dual + dq.dual * w;
+        }
+        float len = glm::length(real);
+        real = real * (1.0f / len);
+        dual = dual * (1.0f / len);
+        glm::vec3 p(pos[0], pos[1], pos[2]);
+        glm::vec3 rv(real.x, real.y, real.z), dv(dual.x, dual.y, dual.z);
+        glm::vec3 fpos = real * p + 2.0f * (real.w * dv - dual.w * rv + glm::cross(rv, dv));
+        out[i] = zeno::vec3f(fpos.x * s, fpos.y * s, fpos.z * s);
+    });
+}
+
 struct EvalAnim{
     double m_Duration;
     double m_TicksPerSecond;
@@ -29,8 +97,13 @@ struct EvalAnim{
     std::unordered_map<std::string, SBoneOffset> m_BoneOffset;
     std::unordered_map<std::string, SAnimBone> m_AnimBones;
     //std::unordered_map<std::string, std::string> m_MeshCorsName;
-    std::vector<SVertex> m_Vertices;
-    std::vector<unsigned int> m_Indices;
+
+    // built once from the vertices: the bones they are bound to, their
+    // weights, the rest positions, and a prim of what skinning leaves as is
+    std::vector<std::string> m_BoneNames;
+    SkinWeights m_Skin;
+    std::vector<zeno::vec3f> m_RestPos;
+    std::shared_ptr<zeno::PrimitiveObject> m_RestPrim;
 
     void initAnim(std::shared_ptr<NodeTree>& nodeTree,
                   std::shared_ptr<BoneTree>& boneTree,
@@ -39,8 +112,7 @@ struct EvalAnim{
         m_Duration = animInfo->duration;
         m_TicksPerSecond = animInfo->tick;
 
-        m_Vertices = fbxData->iVertices.value;
-        m_Indices = fbxData->iIndices.value;
+        initSkin(fbxData->iVertices.value, fbxData->iIndices.value);
         //m_MeshCorsName = fbxData->iMeshInfo.value_corsName;
 
         m_RootNode = *nodeTree;
@@ -50,17 +122,68 @@ struct EvalAnim{
         m_CurrentFrame = 0.0f;
     }
 
-    void updateAnimation(int fi, std::shared_ptr<zeno::PrimitiveObject>& prim, float s, float fps) {
+    void initSkin(std::vector<SVertex> const &vertices, std::vector<unsigned int> const &indices) {
+        std::unordered_map<std::string, int> boneIds;
+        size_t n = vertices.size();
+        m_BoneNames.clear();
+        m_Skin.start.resize(n + 1);
+        m_Skin.bones.clear();
+        m_Skin.weights.clear();
+        m_RestPos.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            m_Skin.start[i] = (int)m_Skin.bones.size();
+            for (auto const &[name, weight]: vertices[i].boneWeights) {
+                auto [it, added] = boneIds.try_emplace(name, (int)m_BoneNames.size());
+                if (added)
+                    m_BoneNames.push_back(name);
+                m_Skin.bones.push_back(it->second);
+                m_Skin.weights.push_back(weight);
+            }
+            auto const &pos = vertices[i].position;
+            m_RestPos[i] = zeno::vec3f(pos.x, pos.y, pos.z);
+        }
+        m_Skin.start[n] = (int)m_Skin.bones.size();
+
+        m_RestPrim = std::make_shared<zeno::PrimitiveObject>();
+        auto &ver = m_RestPrim->verts;
+        ver.resize(n);
+        auto &uv = m_RestPrim->verts.add_attr<zeno::vec3f>("uv");
+        auto &norm = m_RestPrim->verts.add_attr<zeno::vec3f>("nrm");
+        m_RestPrim->verts.add_attr<zeno::vec3f>("posb");
+        zeno::parallel_for(n, [&] (size_t i) {
+            auto& uvw = vertices[i].texCoord;
+            auto& nor = vertices[i].normal;
+            uv[i] = zeno::vec3f(uvw.x, uvw.y, uvw.z);
+            norm[i] = zeno::vec3f(nor.x, nor.y, nor.z);
+        });
+
+        auto &ind = m_RestPrim->tris;
+        ind.resize(indices.size() / 3);
+        auto &uv0 = m_RestPrim->tris.add_attr<zeno::vec3f>("uv0");
+        auto &uv1 = m_RestPrim->tris.add_attr<zeno::vec3f>("uv1");
+        auto &uv2 = m_RestPrim->tris.add_attr<zeno::vec3f>("uv2");
+        zeno::parallel_for(ind.size(), [&] (size_t i) {
+            unsigned int _i1 = indices[i * 3];
+            unsigned int _i2 = indices[i * 3 + 1];
+            unsigned int _i3 = indices[i * 3 + 2];
+            ind[i] = zeno::vec3i(_i1, _i2, _i3);
+            uv0[i] = zeno::vec3f(vertices[_i1].texCoord[0], vertices[_i1].texCoord[1], 0);
+            uv1[i] = zeno::vec3f(vertices[_i2].texCoord[0], vertices[_i2].texCoord[1], 0);
+            uv2[i] = zeno::vec3f(vertices[_i3].texCoord[0], vertices[_i3].texCoord[1], 0);
+        });
+    }
+
+    void updateAnimation(int fi, std::shared_ptr<zeno::PrimitiveObject>& prim, float s, float fps, bool dualQuat) {
         // TODO Use the actual frame number
         float dt = fi / fps;
         m_DeltaTime = dt;
-        m_CurrentFrame += m_TicksPerSecond * dt;
+        m_CurrentFrame = m_TicksPerSecond * dt;
         m_CurrentFrame = fmod(m_CurrentFrame, m_Duration);
 
         //zeno::log_info("Update: F {} D {} C {}", fi, dt, m_CurrentFrame);
 
         calculateBoneTransform(&m_RootNode, aiMatrix4x4());
-        calculateFinal(prim, s);
+        calculateFinal(prim, s, dualQuat);
     }
 
     void decomposeAnimation(std::shared_ptr<zeno::DictObject> &t,
@@ -153,66 +276,33 @@ struct EvalAnim{
         }
     }
 
-    void calculateFinal(std::shared_ptr<zeno::PrimitiveObject>& prim, float s){
-        auto &ver = prim->verts;
-        auto &ind = prim->tris;
-        auto &uv = prim->verts.add_attr<zeno::vec3f>("uv");
-        auto &norm = prim->verts.add_attr<zeno::vec3f>("nrm");
-        auto &posb = prim->verts.add_attr<zeno::vec3f>("posb");
-
-        for(unsigned int i=0; i<m_Vertices.size(); i++){
-            auto& bwe = m_Vertices[i].boneWeights;
-            auto& pos = m_Vertices[i].position;
-            auto& uvw = m_Vertices[i].texCoord;
-            auto& nor = m_Vertices[i].normal;
-
-            glm::vec4 tpos(0.0f, 0.0f, 0.0f, 0.0f);
-
-            bool infd = false;
-
-            for(auto& b: bwe){
-
-                infd = true;
-                auto& tr = m_Transforms[b.first];
-                glm::mat4 trans = glm::mat4(tr.a1,tr.b1,tr.c1,tr.d1,
-                                            tr.a2,tr.b2,tr.c2,tr.d2,
-                                            tr.a3,tr.b3,tr.c3,tr.d3,
-                                            tr.a4,tr.b4,tr.c4,tr.d4);
-                glm::vec4 lpos = trans * glm::vec4(pos.x, pos.y, pos.z, 1.0f);
-                tpos += lpos * b.second;
-            }
-            if(! infd)
-                tpos = glm::vec4(pos.x, pos.y, pos.z, 1.0f);
-
-            glm::vec3 fpos = glm::vec3(tpos.x/tpos.w, tpos.y/tpos.w, tpos.z/tpos.w);
+    void calculateFinal(std::shared_ptr<zeno::PrimitiveObject>& prim, float s, bool dualQuat){
+        prim = std::static_pointer_cast<zeno::PrimitiveObject>(m_RestPrim->clone());
 
-            ver.emplace_back(fpos.x*s, fpos.y*s, fpos.z*s);
-            posb.emplace_back(0.0f, 0.0f, 0.0f);
-            uv.emplace_back(uvw.x, uvw.y, uvw.z);
-            norm.emplace_back(nor.x, nor.y, nor.z);
+        std::vector<glm::mat4> mats(m_BoneNames.size());
+        for (size_t b = 0; b < m_BoneNames.size(); b++) {
+            auto& tr = m_Transforms[m_BoneNames[b]];
+            mats[b] = glm::mat4(tr.a1,tr.b1,tr.c1,tr.d1,
+                                tr.a2,tr.b2,tr.c2,tr.d2,
+                                tr.a3,tr.b3,tr.c3,tr.d3,
+                                tr.a4,tr.b4,tr.c4,tr.d4);
         }
 
-        for(unsigned int i=0; i<m_Indices.size(); i+=3){
-            zeno::vec3i incs(m_Indices[i],m_Indices[i+1],m_Indices[i+2]);
-            ind.push_back(incs);
-        }
-
-        auto &uv0 = prim->tris.add_attr<zeno::vec3f>("uv0");
-        auto &uv1 = prim->tris.add_attr<zeno::vec3f>("uv1");
-        auto &uv2 = prim->tris.add_attr<zeno::vec3f>("uv2");
-        for(unsigned int i=0; i<ind.size(); i++){
-            unsigned int _i1 = ind[i][0];
-            unsigned int _i2 = ind[i][1];
-            unsigned int _i3 = ind[i][2];
-            uv0[i] = zeno::vec3f(m_Vertices[_i1].texCoord[0], m_Vertices[_i1].texCoord[1], 0);
-            uv1[i] = zeno::vec3f(m_Vertices[_i2].texCoord[0], m_Vertices[_i2].texCoord[1], 0);
-            uv2[i] = zeno::vec3f(m_Vertices[_i3].texCoord[0], m_Vertices[_i3].texCoord[1], 0);
-
-        }
+        if (dualQuat)
+            skinDualQuat(m_Skin, mats, m_RestPos.data(), prim->verts.data(), m_RestPos.size(), s);
+        else
+            skinLinear(m_Skin, mats, m_RestPos.data(), prim->verts.data(), m_RestPos.size(), s);
     }
 };
 
+// the skinning data is built once for the inputs of the first frame, and
+// again only when they change
 struct EvalFBXAnim : zeno::INode {
+    EvalAnim anim;
+    std::shared_ptr<FBXData> m_Data;
+    std::shared_ptr<NodeTree> m_NodeTree;
+    std::shared_ptr<BoneTree> m_BoneTree;
+    std::shared_ptr<AnimInfo> m_AnimInfo;
 
     virtual void apply() override {
         int frameid;
@@ -228,7 +318,7 @@ struct EvalFBXAnim : zeno::INode {
             s = 0.01f;
         }
 
-        auto prim = std::make_shared<zeno::PrimitiveObject>();
+        std::shared_ptr<zeno::PrimitiveObject> prim;
         auto fbxData = get_input<FBXData>("data");
         auto nodeTree = get_input<NodeTree>("nodetree");
         auto boneTree = get_input<BoneTree>("bonetree");
@@ -241,9 +331,17 @@ struct EvalFBXAnim : zeno::INode {
         auto iCamera = std::make_shared<ICamera>();
         auto iLight = std::make_shared<ILight>();
 
-        EvalAnim anim;
-        anim.initAnim(nodeTree, boneTree, fbxData, animInfo);
-        anim.updateAnimation(frameid, prim, s, fps);
+        auto dualQuat = get_param<std::string>("skinning") == "DUAL_QUATERNION";
+
+        if (fbxData != m_Data || nodeTree != m_NodeTree || boneTree != m_BoneTree || animInfo != m_AnimInfo) {
+            anim = EvalAnim();
+            anim.initAnim(nodeTree, boneTree, fbxData, animInfo);
+            m_Data = fbxData;
+            m_NodeTree = nodeTree;
+            m_BoneTree = boneTree;
+            m_AnimInfo = animInfo;
+        }
+        anim.updateAnimation(frameid, prim, s, fps, dualQuat);
         anim.updateCameraAndLight(fbxData, iCamera, iLight, s);
         anim.decomposeAnimation(transDict, quatDict, scaleDict);
 
@@ -321,6 +419,7 @@ ZENDEFNODE(EvalFBXAnim,
                },  /* params: */
                {
                    {"enum FROM_MAYA DEFAULT", "unit", "FROM_MAYA"},
+                   {"enum LINEAR DUAL_QUATERNION", "skinning", "LINEAR"},
                },  /* category: */
                {
                    "FBX",
@@ -955,19 +955,25 @@ void readFBXFile(
     zeno::log_info("FBX: Total Indices count {}", mesh.fbxData.iIndices.value.size());
 }
 
+// the scene is imported again only when the path, the params or the
+// modification time of the file change; the data outputs are shared with the
+// earlier frames, as they are only read by the nodes that take them, while
+// the prims are handed out as copies
 struct ReadFBXPrim : zeno::INode {
+    std::string m_Path;
+    std::filesystem::file_time_type m_MTime;
+    bool m_Udim = false;
+    bool m_MakePrim = false;
+    std::shared_ptr<zeno::DictObject> m_Datas;
+    std::shared_ptr<NodeTree> m_NodeTree;
+    std::shared_ptr<AnimInfo> m_AnimInfo;
+    std::shared_ptr<FBXData> m_Data;
+    std::shared_ptr<BoneTree> m_BoneTree;
+    std::shared_ptr<zeno::PrimitiveObject> m_Prim;
+    std::shared_ptr<zeno::DictObject> m_Prims;
 
     virtual void apply() override {
         auto path = get_input<zeno::StringObject>("path")->get();
-        std::shared_ptr<zeno::DictObject> datas = std::make_shared<zeno::DictObject>();
-        auto nodeTree = std::make_shared<NodeTree>();
-        auto animInfo = std::make_shared<AnimInfo>();
-        auto data = std::make_shared<FBXData>();
-        auto boneTree = std::make_shared<BoneTree>();
-        auto prim = std::make_shared<zeno::PrimitiveObject>();
-        std::shared_ptr<zeno::DictObject> prims = std::make_shared<zeno::DictObject>();
-
-        zeno::log_info("FBX: File path {}", path);
 
         bool enable_udim = false;
         bool make_prim = false;
@@ -978,18 +984,49 @@ struct ReadFBXPrim : zeno::INode {
         if(primitive)
             make_prim = true;
 
-        zeno::log_info("FBX: UDIM {} PRIM {}", enable_udim, make_prim);
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec || !m_Data || path != m_Path || mtime != m_MTime
+            || enable_udim != m_Udim || make_prim != m_MakePrim) {
+            std::shared_ptr<zeno::DictObject> datas = std::make_shared<zeno::DictObject>();
+            auto nodeTree = std::make_shared<NodeTree>();
+            auto animInfo = std::make_shared<AnimInfo>();
+            auto data = std::make_shared<FBXData>();
+            auto boneTree = std::make_shared<BoneTree>();
+            auto prim = std::make_shared<zeno::PrimitiveObject>();
+            std::shared_ptr<zeno::DictObject> prims = std::make_shared<zeno::DictObject>();
+
+            zeno::log_info("FBX: File path {}", path);
+            zeno::log_info("FBX: UDIM {} PRIM {}", enable_udim, make_prim);
+
+            readFBXFile(datas,
+                        nodeTree, data, boneTree, animInfo,
+                        path.c_str(), enable_udim, prim, make_prim, prims);
+
+            m_Path = path;
+            m_MTime = mtime;
+            m_Udim = enable_udim;
+            m_MakePrim = make_prim;
+            m_Datas = std::move(datas);
+            m_NodeTree = std::move(nodeTree);
+            m_AnimInfo = std::move(animInfo);
+            m_Data = std::move(data);
+            m_BoneTree = std::move(boneTree);
+            m_Prim = std::move(prim);
+            m_Prims = std::move(prims);
+        }
 
-        readFBXFile(datas,
-                    nodeTree, data, boneTree, animInfo,
-                    path.c_str(), enable_udim, prim, make_prim, prims);
+        auto datas = std::make_shared<zeno::DictObject>(*m_Datas);
+        auto prims = std::make_shared<zeno::DictObject>();
+        for (auto const &[key, val]: m_Prims->lut)
+            prims->lut[key] = val->clone();
 
-        set_output("data", std::move(data));
+        set_output("data", m_Data);
         set_output("datas", std::move(datas));
-        set_output("animinfo", std::move(animInfo));
-        set_output("nodetree", std::move(nodeTree));
-        set_output("bonetree", std::move(boneTree));
-        set_output("prim", std::move(prim));
+        set_output("animinfo", m_AnimInfo);
+        set_output("nodetree", m_NodeTree);
+        set_output("bonetree", m_BoneTree);
+        set_output("prim", m_Prim->clone());
         set_output("prims", std::move(prims));
     }
 };
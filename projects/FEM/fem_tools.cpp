@@ -4,7 +4,9 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
-#include "../ZenoFX/LinearBvh.h"
+#include <zeno/types/LinearBvh.h>
+#include <zeno/funcs/PrimitiveUtils.h>
+#include <limits>
 
 namespace zeno {
 
@@ -263,32 +265,6 @@ ZENDEFNODE(AssignUniformAffineToPrim,{
 
 
 struct EmbedPrimitiveToVolumeMesh : zeno::INode {
-    FEM_Scaler ComputeDistToTriangle(const Vec3d& vp,const Vec3d& v0,const Vec3d& v1,const Vec3d& v2){
-        auto v012 = (v0 + v1 + v2) / 3;
-        auto v01 = (v0 + v1) / 2;
-        auto v02 = (v0 + v2) / 2;
-        auto v12 = (v1 + v2) / 2;
-
-        FEM_Scaler dist = 1e6;
-        FEM_Scaler tdist = (v012 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-        tdist = (v01 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-        tdist = (v02 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-        tdist = (v12 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-
-        tdist = (v0 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-        tdist = (v1 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-        tdist = (v2 - vp).norm();
-        dist = tdist < dist ? tdist : dist;
-
-        return dist;
-    }
-
     virtual void apply() override {
         auto prim = get_input<zeno::PrimitiveObject>("prim");
         auto vmesh = get_input<zeno::PrimitiveObject>("vmesh");
@@ -309,129 +285,90 @@ struct EmbedPrimitiveToVolumeMesh : zeno::INode {
 
         // std::cout << "CHECK:" << embed_id[10641] << std::endl;
 
-        #pragma omp parallel for
-        for(size_t i = 0;i < prim->size();++i){
-            auto vp = Vec3d(prim->verts[i][0],prim->verts[i][1],prim->verts[i][2]);
-            embed_id[i] = -1;
-
-            FEM_Scaler closest_dist = 1e6;
-            int closest_tet_id;
-            Vec4d closest_tet_w;
-
-            for(size_t j = 0;j < vmesh->quads.size();++j){
-                const auto& tet = vmesh->quads[j];
-                Vec3d v0 = Vec3d(vmesh->verts[tet[0]][0],vmesh->verts[tet[0]][1],vmesh->verts[tet[0]][2]);
-                Vec3d v1 = Vec3d(vmesh->verts[tet[1]][0],vmesh->verts[tet[1]][1],vmesh->verts[tet[1]][2]);
-                Vec3d v2 = Vec3d(vmesh->verts[tet[2]][0],vmesh->verts[tet[2]][1],vmesh->verts[tet[2]][2]);
-                Vec3d v3 = Vec3d(vmesh->verts[tet[3]][0],vmesh->verts[tet[3]][1],vmesh->verts[tet[3]][2]);
-
-                Mat4x4d M;
-                M.col(0) << v0,1.0;
-                M.col(1) << v1,1.0;
-                M.col(2) << v2,1.0;
-                M.col(3) << v3,1.0;
-
-
-                auto VMT = M.determinant();
-
-                M.col(0) << vp,1.0;
-                M.col(1) << v1,1.0;
-                M.col(2) << v2,1.0;
-                M.col(3) << v3,1.0;
+        auto tet_weights = [&](size_t j,const Vec3d& vp) {
+            const auto& tet = vmesh->quads[j];
+            Vec3d v0 = Vec3d(vmesh->verts[tet[0]][0],vmesh->verts[tet[0]][1],vmesh->verts[tet[0]][2]);
+            Vec3d v1 = Vec3d(vmesh->verts[tet[1]][0],vmesh->verts[tet[1]][1],vmesh->verts[tet[1]][2]);
+            Vec3d v2 = Vec3d(vmesh->verts[tet[2]][0],vmesh->verts[tet[2]][1],vmesh->verts[tet[2]][2]);
+            Vec3d v3 = Vec3d(vmesh->verts[tet[3]][0],vmesh->verts[tet[3]][1],vmesh->verts[tet[3]][2]);
 
-                auto VM0 = M.determinant();
-
-                M.col(0) << v0,1.0;
-                M.col(1) << vp,1.0; 
-                M.col(2) << v2,1.0;
-                M.col(3) << v3,1.0;
-
-                auto VM1 = M.determinant();
-
-                M.col(0) << v0,1.0;
-                M.col(1) << v1,1.0;
-                M.col(2) << vp,1.0;
-                M.col(3) << v3,1.0;
+            Mat4x4d M;
+            M.col(0) << v0,1.0;
+            M.col(1) << v1,1.0;
+            M.col(2) << v2,1.0;
+            M.col(3) << v3,1.0;
 
-                auto VM2 = M.determinant();
+            auto VMT = M.determinant();
 
-                M.col(0) << v0,1.0;
-                M.col(1) << v1,1.0;
-                M.col(2) << v2,1.0;
-                M.col(3) << vp,1.0;
+            M.col(0) << vp,1.0;
+            auto VM0 = M.determinant();
+            M.col(0) << v0,1.0;
 
-                auto VM3 = M.determinant();
+            M.col(1) << vp,1.0;
+            auto VM1 = M.determinant();
+            M.col(1) << v1,1.0;
 
-                Vec4d w = Vec4d(VM0 / VMT,VM1 / VMT,VM2 / VMT,VM3 / VMT);
+            M.col(2) << vp,1.0;
+            auto VM2 = M.determinant();
+            M.col(2) << v2,1.0;
 
-                if(w[0] > 0 && w[1] > 0 && w[2] > 0 && w[3] > 0){
-                    embed_id[i] = (float)j;
-                    elm_w[i][0] = w[0];
-                    elm_w[i][1] = w[1];
-                    elm_w[i][2] = w[2];
-                    if(fabs(1 - w[0] - w[1] - w[2] - w[3]) > 1e-6){
-                        std::cout << "INVALID : " << i << "\t" << j << "\t" << w.transpose() << std::endl;
-                        // throw std::runtime_error("INVALID W");
-                    }
+            M.col(3) << vp,1.0;
+            auto VM3 = M.determinant();
 
-                    Vec3d interpPos = w[0] * v0 + w[1] * v1 + w[2] * v2 + w[3] * v3;
-                    FEM_Scaler interpError = (interpPos - vp).norm();
-                    if(interpError > 1e-6){
-                        std::cout << "INTERP ERROR : " << interpError << "\t" << interpPos.transpose() << "\t" << vp.transpose() << std::endl;
-                    }
-                    prim->verts[i] = zeno::vec3f(interpPos[0],interpPos[1],interpPos[2]);
-                    // v0s[i] = zeno::vec3f(v0[0],v0[1],v0[2]);
-                    // v1s[i] = zeno::vec3f(v1[0],v1[1],v1[2]);
-                    // v2s[i] = zeno::vec3f(v2[0],v2[1],v2[2]);
-                    // v3s[i] = zeno::vec3f(v3[0],v3[1],v3[2]);
-                    
-                    // if(i == 10641){
-                    //     std::cout << "FIND : " << i << "\t" << j << std::endl;
-                    // }
-                    // std::cout << "FIND : " << i << "\t" << j << "\t" << w0 << "\t" << w1 << "\t" << w2 << "\t" << w3 << std::endl;
-                    break;
-                }
+            return Vec4d(VM0 / VMT,VM1 / VMT,VM2 / VMT,VM3 / VMT);
+        };
 
-                if(w[0] < 0){
-                    FEM_Scaler dist = ComputeDistToTriangle(vp,v1,v2,v3);
-                    if(dist < closest_dist){
-                        closest_dist = dist;
-                        closest_tet_id = j;
-                        closest_tet_w = w;
-                    }
-                }
+        // only the tets whose bounding box holds the point are tested, and the
+        // nearest tet for the fitting fallback comes from the same hierarchy
+        auto lbvh = zeno::primCachedBvh(vmesh,"quad");
 
-                if(w[1] < 0){
-                    FEM_Scaler dist = ComputeDistToTriangle(vp,v0,v2,v3);
-                    if(dist < closest_dist){
-                        closest_dist = dist;
-                        closest_tet_id = j;
-                        closest_tet_w = w;
-                    }
-                }
+        #pragma omp parallel for
+        for(size_t i = 0;i < prim->size();++i){
+            auto vp = Vec3d(prim->verts[i][0],prim->verts[i][1],prim->verts[i][2]);
+            embed_id[i] = -1;
 
-                if(w[2] < 0){
-                    FEM_Scaler dist = ComputeDistToTriangle(vp,v0,v1,v3);
-                    if(dist < closest_dist){
-                        closest_dist = dist;
-                        closest_tet_id = j;
-                        closest_tet_w = w;
-                    }
+            int found_id = -1;
+            lbvh->iter_neighbors(prim->verts[i],[&](int j) {
+                if(found_id >= 0 && j > found_id)
+                    return;
+                Vec4d w = tet_weights(j,vp);
+                if(w[0] > 0 && w[1] > 0 && w[2] > 0 && w[3] > 0)
+                    found_id = j;
+            });
+
+            if(found_id >= 0){
+                size_t j = found_id;
+                const auto& tet = vmesh->quads[j];
+                Vec3d v0 = Vec3d(vmesh->verts[tet[0]][0],vmesh->verts[tet[0]][1],vmesh->verts[tet[0]][2]);
+                Vec3d v1 = Vec3d(vmesh->verts[tet[1]][0],vmesh->verts[tet[1]][1],vmesh->verts[tet[1]][2]);
+                Vec3d v2 = Vec3d(vmesh->verts[tet[2]][0],vmesh->verts[tet[2]][1],vmesh->verts[tet[2]][2]);
+                Vec3d v3 = Vec3d(vmesh->verts[tet[3]][0],vmesh->verts[tet[3]][1],vmesh->verts[tet[3]][2]);
+                Vec4d w = tet_weights(j,vp);
+
+                embed_id[i] = (float)j;
+                elm_w[i][0] = w[0];
+                elm_w[i][1] = w[1];
+                elm_w[i][2] = w[2];
+                if(fabs(1 - w[0] - w[1] - w[2] - w[3]) > 1e-6){
+                    std::cout << "INVALID : " << i << "\t" << j << "\t" << w.transpose() << std::endl;
+                    // throw std::runtime_error("INVALID W");
                 }
 
-                if(w[3] < 0){
-                    FEM_Scaler dist = ComputeDistToTriangle(vp,v0,v1,v2);
-                    if(dist < closest_dist){
-                        closest_dist = dist;
-                        closest_tet_id = j;
-                        closest_tet_w = w;
-                    }
+                Vec3d interpPos = w[0] * v0 + w[1] * v1 + w[2] * v2 + w[3] * v3;
+                FEM_Scaler interpError = (interpPos - vp).norm();
+                if(interpError > 1e-6){
+                    std::cout << "INTERP ERROR : " << interpError << "\t" << interpPos.transpose() << "\t" << vp.transpose() << std::endl;
                 }
+                prim->verts[i] = zeno::vec3f(interpPos[0],interpPos[1],interpPos[2]);
             }
 
-
-            if(embed_id[i] < -1e-3 && fitting_in) {
-
+            if(embed_id[i] < -1e-3 && fitting_in && vmesh->quads.size()) {
+                int closest_tet_id = -1;
+                float closest_dist = std::numeric_limits<float>::max();
+                lbvh->find_nearest(prim->verts[i],closest_tet_id,closest_dist);
+                if(closest_tet_id < 0)
+                    continue;
+                Vec4d closest_tet_w = tet_weights(closest_tet_id,vp);
 
                 embed_id[i] = closest_tet_id;
                 for(size_t i = 0;i < 4;++i)
@@ -440,9 +377,6 @@ struct EmbedPrimitiveToVolumeMesh : zeno::INode {
                 closest_tet_w /= wsum;
 
                 elm_w[i] = zeno::vec3f(closest_tet_w[0],closest_tet_w[1],closest_tet_w[2]);
-
-
-                // std::cout << "CORRECT ID : " << i << "\t" << closest_tet_id << "\t" << closest_tet_w.transpose() << std::endl;
             }
         }
 
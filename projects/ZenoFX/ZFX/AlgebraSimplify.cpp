@@ -0,0 +1,239 @@
+#include "IRVisitor.h"
+#include "Stmts.h"
+#include <sstream>
+#include "StmHelper.h"
+#include <optional>
+#include <cmath>
+
+namespace zfx {
+
+// strength reduction on scalar IR, with literal operands folded first so that
+// patterns like pow(x, $n) still match once ParameterFold made $n a literal;
+// rewrites that may change results beyond rounding are only done in fast-math
+struct AlgebraSimplify : Visitor<AlgebraSimplify> {
+    using visit_stmt_types = std::tuple
+        < UnaryOpStmt
+        , BinaryOpStmt
+        , FunctionCallStmt
+        , Statement
+        >;
+
+    std::unique_ptr<IR> ir = std::make_unique<IR>();
+
+    bool fast_math = false;
+
+    Stm make_stm(Statement *stmt) {
+        return {ir.get(), ir->push_clone_back(stmt)};
+    }
+
+    Stm stm_const(float x) {
+        return {ir.get(), ir->emplace_back<LiterialStmt>(x)};
+    }
+
+    std::optional<float> literal(Statement *stmt) {
+        auto p = dynamic_cast<LiterialStmt *>(ir->push_clone_back(stmt));
+        if (!p) return std::nullopt;
+        return p->value;
+    }
+
+    template <class T>
+    T *defined_as(Statement *stmt) {
+        return dynamic_cast<T *>(ir->push_clone_back(stmt));
+    }
+
+    std::optional<float> fold_op(std::string const &name, std::vector<float> const &v) {
+        if (0) {
+#define _PER_OP(x) } else if (v.size() == 1 && name == #x) { return std::x(v[0]);
+        _PER_OP(sqrt)
+        _PER_OP(sin)
+        _PER_OP(cos)
+        _PER_OP(tan)
+        _PER_OP(asin)
+        _PER_OP(acos)
+        _PER_OP(atan)
+        _PER_OP(exp)
+        _PER_OP(log)
+        _PER_OP(floor)
+        _PER_OP(ceil)
+        _PER_OP(abs)
+#undef _PER_OP
+#define _PER_OP(x) } else if (v.size() == 2 && name == #x) { return std::x(v[0], v[1]);
+        _PER_OP(min)
+        _PER_OP(max)
+        _PER_OP(atan2)
+        _PER_OP(pow)
+#undef _PER_OP
+#define _PER_OP(x) } else if (v.size() == 2 && name == #x) { return v[0] x v[1];
+        _PER_OP(+)
+        _PER_OP(-)
+        _PER_OP(*)
+        _PER_OP(/)
+#undef _PER_OP
+        } else if (v.size() == 1 && name == "+") { return v[0];
+        } else if (v.size() == 1 && name == "-") { return -v[0];
+        } else if (v.size() == 1 && name == "rsqrt") { return 1 / std::sqrt(v[0]);
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    // x^n by squaring, for small integral n
+    Stm stm_ipow(Stm x, int n) {
+        Stm ret;
+        Stm base = x;
+        for (; n; n >>= 1) {
+            if (n & 1)
+                ret = ret.stmt ? ret * base : base;
+            if (n >> 1)
+                base = base * base;
+        }
+        return ret;
+    }
+
+    Statement *emit_pow(Statement *lhs, Statement *rhs) {
+        auto x = make_stm(lhs);
+        if (auto e = literal(rhs); e) {
+            float n = *e;
+            // only these three are exact; the others differ for -0, -inf
+            // or by a few ulps, and overflow early
+            if (n == 0) {
+                return stm_const(1.f);
+            } else if (n == 1) {
+                return x;
+            } else if (n == 2) {
+                return x * x;
+            } else if (fast_math && n == 0.5f) {
+                return stm_func("sqrt", {x});
+            } else if (fast_math && n == -0.5f) {
+                return stm_const(1.f) / stm_func("sqrt", {x});
+            } else if (fast_math && n == 1.5f) {
+                return x * stm_func("sqrt", {x});
+            } else if (fast_math && n == std::floor(n) && std::abs(n) <= 16) {
+                auto r = stm_ipow(x, (int)std::abs(n));
+                return n < 0 ? stm_const(1.f) / r : r;
+            }
+        }
+        if (auto b = literal(lhs); fast_math && b && *b > 0) {
+            // c^y = e^(y*ln(c)), one cheap call instead of pow's log+exp
+            auto y = make_stm(rhs);
+            return stm_func("exp", {y * stm_const(std::log(*b))});
+        }
+        return nullptr;
+    }
+
+    Statement *emit_op(std::string const &name, std::vector<Statement *> const &args) {
+        std::vector<float> values;
+        for (auto const &arg: args) {
+            auto v = literal(arg);
+            if (!v) break;
+            values.push_back(*v);
+        }
+        if (values.size() == args.size()) {
+            if (auto v = fold_op(name, values); v) {
+                return stm_const(*v);
+            }
+        }
+
+        if (0) {
+
+        } else if (name == "pow" && args.size() == 2) {
+            return emit_pow(args[0], args[1]);
+
+        } else if ((name == "+" || name == "-") && args.size() == 2) {
+            // -0 + 0 is +0, so only x - 0 is exact
+            if (auto r = literal(args[1]); r && *r == 0 && (fast_math || name == "-"))
+                return make_stm(args[0]);
+            if (auto l = literal(args[0]); fast_math && name == "+" && l && *l == 0)
+                return make_stm(args[1]);
+
+        } else if (name == "*" && args.size() == 2) {
+            for (int i = 0; i < 2; i++) {
+                auto c = literal(args[i]);
+                if (!c) continue;
+                auto x = make_stm(args[1 - i]);
+                if (*c == 1)
+                    return x;
+                if (*c == -1)
+                    return -x;
+                if (*c == 0 && fast_math)
+                    return stm_const(0.f);
+            }
+
+        } else if (name == "/" && args.size() == 2) {
+            if (auto c = literal(args[1]); c) {
+                auto x = make_stm(args[0]);
+                if (*c == 1)
+                    return x;
+                // reciprocal is exact for powers of two
+                int e;
+                if (fast_math || std::abs(std::frexp(*c, &e)) == 0.5f)
+                    return x * stm_const(1 / *c);
+            }
+            if (auto s = defined_as<FunctionCallStmt>(args[1]); fast_math
+                && s && s->name == "sqrt") {
+                auto x = make_stm(args[0]);
+                auto r = Stm(ir.get(), ir->emplace_back<FunctionCallStmt>(
+                        "rsqrt", s->args));
+                if (auto c = literal(args[0]); c && *c == 1)
+                    return r;
+                return x * r;
+            }
+
+        } else if (name == "sqrt" && args.size() == 1) {
+            if (auto s = defined_as<BinaryOpStmt>(args[0]); fast_math
+                && s && s->op == "*" && s->lhs == s->rhs) {
+                return stm_func("abs", {Stm(ir.get(), s->lhs)});
+            }
+
+        } else if (name == "log" && args.size() == 1) {
+            if (auto s = defined_as<FunctionCallStmt>(args[0]); fast_math
+                && s && s->name == "exp") {
+                return s->args[0];
+            }
+
+        } else if (name == "exp" && args.size() == 1) {
+            if (auto s = defined_as<FunctionCallStmt>(args[0]); fast_math
+                && s && s->name == "log") {
+                return s->args[0];
+            }
+        }
+        return nullptr;
+    }
+
+    void visit(UnaryOpStmt *stmt) {
+        auto new_stmt = emit_op(stmt->op, {stmt->src});
+        if (!new_stmt) {
+            return visit((Statement *)stmt);
+        }
+        ir->mark_replacement(stmt, new_stmt);
+    }
+
+    void visit(BinaryOpStmt *stmt) {
+        auto new_stmt = emit_op(stmt->op, {stmt->lhs, stmt->rhs});
+        if (!new_stmt) {
+            return visit((Statement *)stmt);
+        }
+        ir->mark_replacement(stmt, new_stmt);
+    }
+
+    void visit(FunctionCallStmt *stmt) {
+        auto new_stmt = emit_op(stmt->name, stmt->args);
+        if (!new_stmt) {
+            return visit((Statement *)stmt);
+        }
+        ir->mark_replacement(stmt, new_stmt);
+    }
+
+    void visit(Statement *stmt) {
+        ir->push_clone_back(stmt);
+    }
+};
+
+std::unique_ptr<IR> apply_algebra_simplify(IR *ir, bool fast_math) {
+    AlgebraSimplify visitor;
+    visitor.fast_math = fast_math;
+    visitor.apply(ir);
+    return std::move(visitor.ir);
+}
+
+}
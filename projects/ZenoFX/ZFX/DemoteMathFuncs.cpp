@@ -3,6 +3,7 @@
 #include <sstream>
 #include "StmHelper.h"
 #include <cmath>
+#include <limits>
 
 namespace zfx {
 
@@ -22,6 +23,8 @@ struct DemoteMathFuncs : Visitor<DemoteMathFuncs> {
 
     std::unique_ptr<IR> ir = std::make_unique<IR>();
 
+    bool fast_math = false;
+
     /*Stm emit_stm(std::string const &name, std::vector<Stm> const &args) {
         ERROR_IF(args.size() == 0);
         std::vector<Statement *> argptrs;
@@ -48,6 +51,38 @@ struct DemoteMathFuncs : Visitor<DemoteMathFuncs> {
         return stm_const(u.f);
     }
 
+    // round to nearest, valid for |x| < 2^22
+    Stm stm_round(Stm x) {
+        auto magic = stm_const(12582912.f);
+        return (x + magic) - magic;
+    }
+
+    // (-1)^k for integral k
+    Stm stm_parity_sign(Stm k) {
+        auto h = k * stm_const(0.5f);
+        auto f = h - stm_round(h);
+        auto mask = stm_const(0x80000000);
+        return stm_const(1.f) - stm_const(4.f) * stm("&!", f, mask);
+    }
+
+    // sin(x) with x - t pi in [-pi/2, pi/2] and (-1)^k as the sign
+    Stm stm_sin_reduced(Stm x, Stm t, Stm k) {
+        auto y = x - t * stm_const(3.140625f);
+        y = y - t * stm_const(9.67653589793e-4f);
+        auto y2 = y * y;
+        auto p = stm_const(-2.50521084e-8f);
+        p = p * y2 + stm_const(2.75573192e-6f);
+        p = p * y2 + stm_const(-1.98412698e-4f);
+        p = p * y2 + stm_const(8.33333333e-3f);
+        p = p * y2 + stm_const(-1.66666667e-1f);
+        p = p * y2 * y + y;
+        return stm_parity_sign(k) * p;
+    }
+
+    Stm stm_sin_reduced(Stm x, Stm k) {
+        return stm_sin_reduced(x, k, k);
+    }
+
     Statement *emit_op(std::string const &name, std::vector<Statement *> const &args) {
         if (0) {
 
@@ -69,22 +104,33 @@ struct DemoteMathFuncs : Visitor<DemoteMathFuncs> {
             auto mask = stm_const(0x80000000);
             return stm("&!", x, mask);
 
-        /*} else if (name == "fsin") {
+        } else if (name == "rsqrt") {
+            ERROR_IF(args.size() != 1);
+            // hardware estimate refined by one newton step; where the estimate
+            // is 0 or inf (x is inf, 0 or denormal) the step would give nan, so
+            // the raw estimate is kept there. FLT_MAX stands in for inf, which
+            // can't round-trip through the assembly text
+            auto x = make_stm(args[0]);
+            auto r = stm_func("rsqrt", {x});
+            auto h = stm_const(0.5f) * x * r * r;
+            auto refined = r * (stm_const(1.5f) - h);
+            auto finite = stm("<", stm_const(0.f), r)
+                & stm("<=", r, stm_const(std::numeric_limits<float>::max()));
+            return (refined & finite) | stm("&!", r, finite);
+
+        } else if (name == "sin" && fast_math) {
             ERROR_IF(args.size() != 1);
             auto x = make_stm(args[0]);
-            auto z = x;
-            auto z2 = z * z;
-            auto r = stm_const(1.f);
-            auto t = z2 * stm_const(1.f / 6);
-            r = r - t;
-            t = z2 * stm_const(1.f / 20) * t;
-            r = r + t;
-            t = z2 * stm_const(1.f / 48) * t;
-            r = r - t;
-            t = z2 * stm_const(1.f / 72) * t;
-            r = r + t;
-            r = r * z;
-            return r;*/
+            auto k = stm_round(x * stm_const(0.318309886f));
+            return stm_sin_reduced(x, k);
+
+        } else if (name == "cos" && fast_math) {
+            ERROR_IF(args.size() != 1);
+            // cos(x) = -(-1)^k sin(x - (k + 1/2) pi)
+            auto x = make_stm(args[0]);
+            auto k = stm_round(x * stm_const(0.318309886f) - stm_const(0.5f));
+            auto mask = stm_const(0x80000000);
+            return stm("^", stm_sin_reduced(x, k + stm_const(0.5f), k), mask);
 
         /* todo: also add fast exp
 //    http://martin.ankerl.com/2007/10/04/optimized-pow-approximation-for-java-and-c-c/
@@ -131,8 +177,9 @@ inline __m128 _mm_fexp_ps(__m128 x)
     }
 };
 
-std::unique_ptr<IR> apply_demote_math_funcs(IR *ir) {
+std::unique_ptr<IR> apply_demote_math_funcs(IR *ir, bool fast_math) {
     DemoteMathFuncs visitor;
+    visitor.fast_math = fast_math;
     visitor.apply(ir);
     return std::move(visitor.ir);
 }
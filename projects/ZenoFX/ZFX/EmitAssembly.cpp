@@ -125,7 +125,7 @@ struct EmitAssembly : Visitor<EmitAssembly> {
     }
 
     void visit(AsmLoadConstStmt *stmt) {
-        emit("ldi %d %f", stmt->dst, stmt->value);
+        emit("ldi %d %.9g", stmt->dst, stmt->value);
     }
 
     void visit(AsmAssignStmt *stmt) {
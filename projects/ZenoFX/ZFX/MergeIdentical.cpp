@@ -1,79 +1,104 @@
 #include "IRVisitor.h"
 #include "Stmts.h"
-#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <cstring>
 #include <map>
 
 namespace zfx {
 
+// common subexpression elimination on scalar IR, before LowerAccess while
+// every value is still its own statement; symbols are versioned by the
+// assignments to them, so a read after a store never reuses a stale value,
+// and merges never cross control statements
 struct MergeIdentical : Visitor<MergeIdentical> {
     using visit_stmt_types = std::tuple
-        < AsmLocalStoreStmt
-        , AsmLocalLoadStmt
-        , AsmGlobalStoreStmt
-        , AsmGlobalLoadStmt
+        < UnaryOpStmt
+        , BinaryOpStmt
+        , TernaryOpStmt
+        , FunctionCallStmt
+        , LiterialStmt
+        , AssignStmt
         , Statement
         >;
 
     std::unique_ptr<IR> ir = std::make_unique<IR>();
 
-    std::map<std::string, int> revstmts;
-    std::map<int, int> regs;
+    std::map<std::string, Statement *> revstmts;
+    std::map<Statement *, int> versions;
 
-    void visit(Statement *stmt) {
-        if (stmt->is_control_stmt()) {
-            revstmts.clear();
-            regs.clear();
-            ir->push_clone_back(stmt);
-            return;
+    std::string operand_key(Statement *stmt) {
+        auto new_stmt = ir->push_clone_back(stmt);
+        std::string key = '$' + std::to_string(new_stmt->id);
+        if (dynamic_cast<SymbolStmt *>(new_stmt)
+            || dynamic_cast<TempSymbolStmt *>(new_stmt)) {
+            key += '@' + std::to_string(versions[new_stmt]);
         }
+        return key;
+    }
 
+    void merge(Statement *stmt, std::string const &opkey,
+               std::vector<Statement *> const &args, bool commutative = false) {
+        std::vector<std::string> argkeys;
+        for (auto const &arg: args) {
+            argkeys.push_back(operand_key(arg));
+        }
+        if (commutative) {
+            std::sort(argkeys.begin(), argkeys.end());
+        }
         std::stringstream ss;
-        ss << stmt->serialize_identity();
-        for (auto r: stmt->source_registers()) {
-            auto s = regs.at(r);
-            ss << '|' << s;
+        ss << opkey;
+        for (auto const &k: argkeys) {
+            ss << '|' << k;
         }
         auto key = ss.str();
 
-        bool found = false;
         if (auto it = revstmts.find(key); it != revstmts.end()) {
-            for (auto [r_d, r_s]: regs) {
-                if (r_s == it->second) {
-                    for (auto d: stmt->dest_registers()) {
-                        if (d != r_d)
-                            ir->emplace_back<AsmAssignStmt>(d, r_d);
-                    }
-                    found = true;
-                    break;
-                }
-            }
+            ir->mark_replacement(stmt, it->second);
+            return;
         }
+        revstmts[key] = ir->push_clone_back(stmt);
+    }
 
-        if (!found) {
-            ir->push_clone_back(stmt);
-        }
+    static bool is_commutative(std::string const &op) {
+        return op == "+" || op == "*" || op == "&" || op == "|" || op == "^"
+            || op == "==" || op == "!=" || op == "min" || op == "max";
+    }
 
-        revstmts[key] = stmt->id;
-        for (auto d: stmt->dest_registers()) {
-            regs[d] = stmt->id;
-        }
+    void visit(UnaryOpStmt *stmt) {
+        merge(stmt, "UnaryOp " + stmt->op, {stmt->src});
     }
 
-    void visit(AsmLocalLoadStmt *stmt) {
-        ir->push_clone_back(stmt);
-        regs[stmt->val] = stmt->id;
+    void visit(BinaryOpStmt *stmt) {
+        merge(stmt, "BinaryOp " + stmt->op, {stmt->lhs, stmt->rhs},
+            is_commutative(stmt->op));
     }
 
-    void visit(AsmLocalStoreStmt *stmt) {
-        ir->push_clone_back(stmt);
+    void visit(TernaryOpStmt *stmt) {
+        merge(stmt, "TernaryOp", {stmt->cond, stmt->lhs, stmt->rhs});
     }
 
-    void visit(AsmGlobalLoadStmt *stmt) {
-        ir->push_clone_back(stmt);
-        regs[stmt->val] = stmt->id;
+    void visit(FunctionCallStmt *stmt) {
+        merge(stmt, "FunctionCall " + stmt->name, stmt->args,
+            is_commutative(stmt->name));
     }
 
-    void visit(AsmGlobalStoreStmt *stmt) {
+    void visit(LiterialStmt *stmt) {
+        // key on the bits, as to_string would round small values together
+        uint32_t bits;
+        std::memcpy(&bits, &stmt->value, sizeof(bits));
+        merge(stmt, "Literial " + std::to_string(bits), {});
+    }
+
+    void visit(AssignStmt *stmt) {
+        auto new_stmt = static_cast<AssignStmt *>(ir->push_clone_back(stmt));
+        versions[new_stmt->dst]++;
+    }
+
+    void visit(Statement *stmt) {
+        if (stmt->is_control_stmt()) {
+            revstmts.clear();
+        }
         ir->push_clone_back(stmt);
     }
 };
@@ -82,7 +107,6 @@ std::unique_ptr<IR> apply_merge_identical(IR *ir) {
     MergeIdentical visitor;
     visitor.apply(ir);
     return std::move(visitor.ir);
-    //return std::make_unique<IR>(*ir);
 }
 
 }
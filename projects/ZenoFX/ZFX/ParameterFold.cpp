@@ -0,0 +1,52 @@
+#include "IRVisitor.h"
+#include "Stmts.h"
+#include <map>
+
+namespace zfx {
+
+#define ERROR_IF(x) do { \
+    if (x) { \
+        error("`%s`", #x); \
+    } \
+} while (0)
+
+// specialize the program for parameters whose values are known at compile
+// time, so that the later passes can simplify and fold them as literals
+struct ParameterFold : Visitor<ParameterFold> {
+    using visit_stmt_types = std::tuple
+        < ParamSymbolStmt
+        , Statement
+        >;
+
+    std::unique_ptr<IR> ir = std::make_unique<IR>();
+
+    std::vector<std::pair<std::string, int>> const *params;
+    std::map<std::string, std::vector<float>> const *parvals;
+
+    void visit(ParamSymbolStmt *stmt) {
+        ERROR_IF(stmt->symids.size() != 1);
+        auto const &[name, dimid] = params->at(stmt->symids[0]);
+        auto it = parvals->find(name);
+        if (it == parvals->end() || dimid >= it->second.size()) {
+            return visit((Statement *)stmt);
+        }
+        auto new_stmt = ir->emplace_back<LiterialStmt>(it->second[dimid]);
+        ir->mark_replacement(stmt, new_stmt);
+    }
+
+    void visit(Statement *stmt) {
+        ir->push_clone_back(stmt);
+    }
+};
+
+std::unique_ptr<IR> apply_parameter_fold(IR *ir,
+        std::vector<std::pair<std::string, int>> const &params,
+        std::map<std::string, std::vector<float>> const &parvals) {
+    ParameterFold visitor;
+    visitor.params = &params;
+    visitor.parvals = &parvals;
+    visitor.apply(ir);
+    return std::move(visitor.ir);
+}
+
+}
@@ -2,6 +2,7 @@
 #include "Stmts.h"
 #include <functional>
 #include <stack>
+#include <set>
 #include <map>
 
 namespace zfx {
@@ -17,7 +18,18 @@ struct SaveMathRegisters : Visitor<SaveMathRegisters> {
     size_t minaddr = 0;
     int nregs = 0;
 
+    // these are single instructions, not calls through the function table
+    static inline std::set<std::string> inlined =
+        { "sqrt"
+        , "rsqrt"
+        , "min"
+        , "max"
+        };
+
     void visit(AsmFuncCallStmt *stmt) {
+        if (inlined.count(stmt->name)) {
+            return visit((Statement *)stmt);
+        }
         std::stack<std::function<void()>> callbacks;
         for (int regid = 0; regid < nregs; regid++) {
             if (regid == stmt->dst)
@@ -13,7 +13,11 @@ std::map<std::string, int> apply_detect_new_symbols(IR *ir,
         std::vector<std::pair<std::string, int>> &symbols);
 std::unique_ptr<IR> apply_expand_functions(IR *ir);
 std::unique_ptr<IR> apply_lower_math(IR *ir);
-std::unique_ptr<IR> apply_demote_math_funcs(IR *ir);
+std::unique_ptr<IR> apply_parameter_fold(IR *ir,
+        std::vector<std::pair<std::string, int>> const &params,
+        std::map<std::string, std::vector<float>> const &parvals);
+std::unique_ptr<IR> apply_algebra_simplify(IR *ir, bool fast_math);
+std::unique_ptr<IR> apply_demote_math_funcs(IR *ir, bool fast_math);
 std::unique_ptr<IR> apply_lower_access(IR *ir);
 std::unique_ptr<IR> apply_constant_fold(IR *ir);
 std::map<int, int> apply_reassign_parameters(IR *ir);
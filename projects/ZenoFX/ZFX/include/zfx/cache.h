@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <array>
+#include <list>
+
+namespace zfx {
+
+// thread-safe string-keyed cache, split into independently locked shards,
+// each of them evicting its least recently used entries past the capacity;
+// values are handed out as shared_ptr, so evicted entries stay alive until
+// their last user is done with them
+template <class V, size_t NShards = 16>
+struct ShardedLruCache {
+    using Ptr = std::shared_ptr<V const>;
+
+private:
+    struct Shard {
+        using List = std::list<std::pair<std::string, Ptr>>;
+        std::mutex mtx;
+        List lru;
+        std::unordered_map<std::string, typename List::iterator> lut;
+    };
+
+    std::array<Shard, NShards> shards;
+    size_t shard_capacity;
+
+    Shard &shard_of(std::string const &key) {
+        return shards[std::hash<std::string>{}(key) % NShards];
+    }
+
+    void trim(Shard &shard) {
+        while (shard.lru.size() > shard_capacity) {
+            shard.lut.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+        }
+    }
+
+public:
+    explicit ShardedLruCache(size_t capacity = 256)
+        : shard_capacity((capacity + NShards - 1) / NShards) {
+    }
+
+    void set_capacity(size_t capacity) {
+        shard_capacity = (capacity + NShards - 1) / NShards;
+        for (auto &shard: shards) {
+            std::lock_guard lck(shard.mtx);
+            trim(shard);
+        }
+    }
+
+    // the creator runs without holding the lock, so that a slow compile won't
+    // block other keys; if two threads race on one key, the first insert wins
+    template <class F>
+    Ptr get_or_create(std::string const &key, F const &create) {
+        auto &shard = shard_of(key);
+        {
+            std::lock_guard lck(shard.mtx);
+            if (auto it = shard.lut.find(key); it != shard.lut.end()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                return it->second->second;
+            }
+        }
+        Ptr val = create();
+        std::lock_guard lck(shard.mtx);
+        if (auto it = shard.lut.find(key); it != shard.lut.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+        shard.lru.emplace_front(key, val);
+        shard.lut.emplace(key, shard.lru.begin());
+        trim(shard);
+        return val;
+    }
+
+    void clear() {
+        for (auto &shard: shards) {
+            std::lock_guard lck(shard.mtx);
+            shard.lut.clear();
+            shard.lru.clear();
+        }
+    }
+
+    size_t size() {
+        size_t ret = 0;
+        for (auto &shard: shards) {
+            std::lock_guard lck(shard.mtx);
+            ret += shard.lru.size();
+        }
+        return ret;
+    }
+};
+
+}
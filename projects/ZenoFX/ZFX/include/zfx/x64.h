@@ -4,14 +4,26 @@
 #include <cstring>
 #include <string>
 #include <map>
+#include "cache.h"
 
 namespace zfx::x64 {
 
 struct Executable {
-    uint8_t *mem = nullptr;
-    size_t memsize = 0;
+    // the jitted machine code, shared by every Executable assembled from the
+    // same lines, and freed once the cache and all of its users let go of it
+    struct Code {
+        uint8_t *mem = nullptr;
+        size_t memsize = 0;
+        float consts[1024]{};
+        void **functable = nullptr;
+
+        Code() = default;
+        Code(Code const &) = delete;
+        ~Code();
+    };
+
+    std::shared_ptr<Code const> code;
     float consts[1024];
-    void **functable = nullptr;
 
     static constexpr size_t SimdWidth = 4;
 
@@ -20,8 +32,8 @@ struct Executable {
         float locals[SimdWidth * 256];
 
         void execute() {
-            auto entry = (void(*)(void *, void *, void *))exec->mem;
-            entry((void *)locals, (void *)exec->consts, (void *)exec->functable);
+            auto entry = (void(*)(void *, void *, void *))exec->code->mem;
+            entry((void *)locals, (void *)exec->consts, (void *)exec->code->functable);
         }
 
         float *channel(int chid) {
@@ -37,26 +49,32 @@ struct Executable {
         return {this};
     }
 
-    Executable() = default;
+    // parameters are per instance, so concurrent wrangles can't clobber each other
+    explicit Executable(std::shared_ptr<Code const> code_)
+        : code(std::move(code_)) {
+        std::memcpy(consts, code->consts, sizeof(consts));
+    }
+
     Executable(Executable const &) = delete;
-    ~Executable();
 
-    static std::unique_ptr<Executable> assemble
+    static std::shared_ptr<Code const> assemble
         ( std::string const &lines
         );
 };
 
 struct Assembler {
-    std::map<std::string, std::unique_ptr<Executable>> cache;
+    ShardedLruCache<Executable::Code> cache;
 
-    Executable *assemble(std::string const &lines) {
-        if (auto it = cache.find(lines); it != cache.end()) {
-            return it->second.get();
-        }
-        auto prog = Executable::assemble(lines);
-        auto raw_ptr = prog.get();
-        cache[lines] = std::move(prog);
-        return raw_ptr;
+    std::unique_ptr<Executable> assemble(std::string const &lines) {
+        return std::make_unique<Executable>(cache.get_or_create(lines, [&] {
+            return Executable::assemble(lines);
+        }));
+    }
+
+    // the assembler shared by all wrangles, so identical code is assembled once
+    static Assembler &shared() {
+        static Assembler assembler;
+        return assembler;
     }
 };
 
@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <sstream>
+#include <iomanip>
 #include <string>
 #include <vector>
 #include <memory>
 #include <tuple>
 #include <map>
+#include "cache.h"
 
 namespace zfx {
 
@@ -21,9 +23,11 @@ struct Options {
     bool reassign_parameters = true;
     bool reassign_channels = true;
 
-    bool merge_identical = false; // have bug...
+    bool merge_identical = true;
     bool kill_unreachable = true;
     bool constant_fold = true;
+    bool algebra_simplify = true;
+    bool fast_math = false;
 
     //Options() = default;
 
@@ -47,6 +51,7 @@ struct Options {
 
     std::map<std::string, int> symdims;
     std::map<std::string, int> pardims;
+    std::map<std::string, std::vector<float>> parvals;
 
     void define_symbol(std::string const &name, int dimension) {
         symdims[name] = dimension;
@@ -56,6 +61,12 @@ struct Options {
         pardims[name] = dimension;
     }
 
+    // compile the parameter in as a constant, specializing the program
+    // for this value; it still has to be defined with define_param
+    void fold_param(std::string const &name, std::vector<float> const &values) {
+        parvals[name] = values;
+    }
+
     void dump(std::ostream &os) const {
         for (auto const &[name, dim]: symdims) {
             os << '/' << name << '/' << dim;
@@ -63,11 +74,20 @@ struct Options {
         for (auto const &[name, dim]: pardims) {
             os << '\\' << name << '\\' << dim;
         }
+        for (auto const &[name, values]: parvals) {
+            os << '=' << name;
+            for (auto const &value: values) {
+                os << ':' << std::hexfloat << value << std::defaultfloat;
+            }
+        }
         os << '|' << const_parametrize;
         os << '|' << global_localize;
         os << '|' << reassign_channels;
         os << '|' << save_math_registers;
         os << '|' << arch_maxregs;
+        os << '|' << merge_identical;
+        os << '|' << algebra_simplify;
+        os << '|' << fast_math;
     }
 };
 
@@ -117,9 +137,9 @@ struct Program {
 };
 
 struct Compiler {
-    std::map<std::string, std::unique_ptr<Program>> cache;
+    ShardedLruCache<Program> cache;
 
-    Program *compile
+    std::shared_ptr<Program const> compile
         ( std::string const &code
         , Options const &options
         ) {
@@ -128,29 +148,29 @@ struct Compiler {
         options.dump(ss);
         auto key = ss.str();
 
-        auto it = cache.find(key);
-        if (it != cache.end()) {
-            return it->second.get();
-        }
+        return cache.get_or_create(key, [&] {
+            auto
+                [ assembly
+                , symbols
+                , params
+                , newsyms
+                ] = compile_to_assembly
+                ( code
+                , options
+                );
+            auto prog = std::make_shared<Program>();
+            prog->assembly = assembly;
+            prog->symbols = symbols;
+            prog->params = params;
+            prog->newsyms = newsyms;
+            return prog;
+        });
+    }
 
-        auto 
-            [ assembly
-            , symbols
-            , params
-            , newsyms
-            ] = compile_to_assembly
-            ( code
-            , options
-            );
-        auto prog = std::make_unique<Program>();
-        prog->assembly = assembly;
-        prog->symbols = symbols;
-        prog->params = params;
-        prog->newsyms = newsyms;
-
-        auto raw_ptr = prog.get();
-        cache[key] = std::move(prog);
-        return raw_ptr;
+    // the compiler shared by all wrangles, so identical code is compiled once
+    static Compiler &shared() {
+        static Compiler compiler;
+        return compiler;
     }
 };
 
@@ -19,8 +19,7 @@ struct ImplAssembler {
     int simdkind = simdtype::xmmps;
 
     std::unique_ptr<SIMDBuilder> builder = std::make_unique<SIMDBuilder>();
-    std::unique_ptr<Executable> exec = std::make_unique<Executable>();
-    static inline std::unique_ptr<FuncTable> functable;
+    std::unique_ptr<Executable::Code> exec = std::make_unique<Executable::Code>();
 
     int nconsts = 0;
     int nlocals = 0;
@@ -246,6 +245,13 @@ struct ImplAssembler {
                 builder->addAvxUnaryOp(simdkind, opcode::sqrt,
                     dst, src);
 
+            } else if (cmd == "rsqrt") {
+                ERROR_IF(linesep.size() < 2);
+                auto dst = from_string<int>(linesep[1]);
+                auto src = from_string<int>(linesep[2]);
+                builder->addAvxUnaryOp(simdkind, opcode::rsqrt,
+                    dst, src);
+
             } else if (cmd == "mov") {
                 ERROR_IF(linesep.size() < 2);
                 auto dst = from_string<int>(linesep[1]);
@@ -364,9 +370,8 @@ struct ImplAssembler {
         }
 #endif
 
-        if (!functable)
-            functable = std::make_unique<FuncTable>();
-        exec->functable = functable->funcptrs.data();
+        static FuncTable functable;
+        exec->functable = functable.funcptrs.data();
         exec->memsize = (insts.size() + 4095) / 4096 * 4096;
         exec->mem = (uint8_t *)exec_page_allocate(exec->memsize);
         for (int i = 0; i < insts.size(); i++) {
@@ -376,7 +381,7 @@ struct ImplAssembler {
     }
 };
 
-std::unique_ptr<Executable> Executable::assemble
+std::shared_ptr<Executable::Code const> Executable::assemble
     ( std::string const &lines
     ) {
     ImplAssembler a;
@@ -384,7 +389,7 @@ std::unique_ptr<Executable> Executable::assemble
     return std::move(a.exec);
 }
 
-Executable::~Executable() {
+Executable::Code::~Code() {
     if (mem) {
         exec_page_free(mem, memsize);
         mem = nullptr;
@@ -1,6 +1,7 @@
 #include "LowerAST.h"
 #include "Visitors.h"
 #include <zfx/zfx.h>
+#include <iomanip>
 
 namespace zfx {
 
@@ -106,11 +107,41 @@ std::tuple
     ir->print();
 #endif
 
+    if (options.parvals.size()) {
+#ifdef ZFX_PRINT_IR
+        cout << "=== ParameterFold" << endl;
+#endif
+        ir = apply_parameter_fold(ir.get(), params, options.parvals);
+#ifdef ZFX_PRINT_IR
+        ir->print();
+#endif
+    }
+
+    if (options.algebra_simplify) {
+#ifdef ZFX_PRINT_IR
+        cout << "=== AlgebraSimplify" << endl;
+#endif
+        ir = apply_algebra_simplify(ir.get(), options.fast_math);
+#ifdef ZFX_PRINT_IR
+        ir->print();
+#endif
+    }
+
     if (options.demote_math_funcs) {
 #ifdef ZFX_PRINT_IR
         cout << "=== DemoteMathFuncs" << endl;
 #endif
-        ir = apply_demote_math_funcs(ir.get());
+        ir = apply_demote_math_funcs(ir.get(), options.fast_math);
+#ifdef ZFX_PRINT_IR
+        ir->print();
+#endif
+    }
+
+    if (options.merge_identical) {
+#ifdef ZFX_PRINT_IR
+        cout << "=== MergeIdentical" << endl;
+#endif
+        ir = apply_merge_identical(ir.get());
 #ifdef ZFX_PRINT_IR
         ir->print();
 #endif
@@ -166,6 +197,7 @@ std::tuple
     }
 
     std::stringstream oss_end;
+    oss_end << std::setprecision(9);
     if (options.const_parametrize) {
 #ifdef ZFX_PRINT_IR
         cout << "=== ConstParametrize" << endl;
@@ -211,16 +243,6 @@ std::tuple
 #endif
     }
 
-    if (options.merge_identical) {
-#ifdef ZFX_PRINT_IR
-        cout << "=== MergeIdentical" << endl;
-#endif
-        ir = apply_merge_identical(ir.get());
-#ifdef ZFX_PRINT_IR
-        ir->print();
-#endif
-    }
-
     if (options.reassign_channels) {
 #ifdef ZFX_PRINT_IR
         cout << "=== ReassignGlobals" << endl;
@@ -16,8 +16,8 @@
 
 namespace zeno {
 namespace {
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 static void numeric_eval (zfx::x64::Executable *exec,
                          std::vector<float> &chs) {
@@ -158,7 +158,7 @@ struct NumericEval : zeno::INode {
         assert(name[0] == '@');
     }
 
-    numeric_eval(exec, chs);
+    numeric_eval(exec.get(), chs);
 
     std::vector<float> resex(chs.size());
     for (int i = 0; i < chs.size(); i++) {
@@ -12,8 +12,8 @@
 namespace {
     using namespace zeno;
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 static void numeric_wrangle
     ( zfx::x64::Executable *exec
@@ -141,7 +141,7 @@ struct NumericWrangle : zeno::INode {
             assert(name[0] == '@');
         }
 
-        numeric_wrangle(exec, chs);
+        numeric_wrangle(exec.get(), chs);
 
         for (int i = 0; i < chs.size(); i++) {
             auto [name, dimid] = prog->symbols[i];
@@ -13,8 +13,8 @@
 namespace zeno {
 namespace {
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 struct Buffer {
     float *base = nullptr;
@@ -215,7 +215,7 @@ struct ParticlesTwoWrangle : zeno::INode {
             });
             chs[i] = iob;
         }
-        vectors_wrangle(exec, chs);
+        vectors_wrangle(exec.get(), chs);
 
         set_output("prim", std::move(prim));
     }
@@ -8,13 +8,17 @@
 #include <zfx/zfx.h>
 #include <zfx/x64.h>
 #include <cassert>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 #include "dbg_printf.h"
+#include "reductions.h"
 
 namespace zeno {
 namespace {
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 struct Buffer {
     float *base = nullptr;
@@ -25,42 +29,75 @@ struct Buffer {
 static void vectors_wrangle
     ( zfx::x64::Executable *exec
     , std::vector<Buffer> const &chs
+    , size_t size
     , int *maskarr
+    , ZfxReductions const &reds
+    , std::vector<float> &result
     ) {
+    constexpr int W = zfx::x64::Executable::SimdWidth;
+    result = reds.make_partial();
     if (chs.size() == 0)
         return;
-    size_t size = chs[0].count;
-    for (int i = 1; i < chs.size(); i++) {
-        size = std::min(chs[i].count, size);
+    for (int i = 0; i < chs.size(); i++) {
+        if (chs[i].base)
+            size = std::min(chs[i].count, size);
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < size - exec->SimdWidth + 1; i += exec->SimdWidth) {
-        auto ctx = exec->make_context();
-        for (int j = 0; j < chs.size(); j++) {
-            for (int k = 0; k < exec->SimdWidth; k++)
-                ctx.channel(j)[k] = chs[j].base[chs[j].stride * (i + k)];
-        }
-        ctx.execute();
-        for (int k = 0; k < exec->SimdWidth; k++) {
+    int nthreads = 1;
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    std::vector<std::vector<float>> partials(nthreads, reds.make_partial());
+
+    #pragma omp parallel
+    {
+        int tid = 0;
+#if defined(_OPENMP)
+        tid = omp_get_thread_num();
+#endif
+        #pragma omp for
+        for (intptr_t i = 0; i < (intptr_t)(size / W * W); i += W) {
+            auto ctx = exec->make_context();
+            reds.init_context(ctx);
             for (int j = 0; j < chs.size(); j++) {
-                if (maskarr[i + k] != 0)
+                if (!chs[j].base) continue;
+                for (int k = 0; k < W; k++)
+                    ctx.channel(j)[k] = chs[j].base[chs[j].stride * (i + k)];
+            }
+            ctx.execute();
+            for (int k = 0; k < W; k++) {
+                if (maskarr[i + k] == 0) continue;
+                for (int j = 0; j < chs.size(); j++) {
+                    if (!chs[j].base) continue;
                     chs[j].base[chs[j].stride * (i + k)] = ctx.channel(j)[k];
+                }
             }
+            // masked-out lanes still run, but don't accumulate
+            reds.gather_context(ctx, W, partials[tid], maskarr + i);
         }
     }
-    for (int i = size / exec->SimdWidth * exec->SimdWidth; i < size; i++) {
+
+    std::vector<float> partial = reds.make_partial();
+    for (size_t i = size / W * W; i < size; i++) {
+        if (maskarr[i] == 0)
+            continue;
         auto ctx = exec->make_context();
+        reds.init_context(ctx);
         for (int j = 0; j < chs.size(); j++) {
+            if (!chs[j].base) continue;
             ctx.channel(j)[0] = chs[j].base[chs[j].stride * i];
         }
         ctx.execute();
         for (int j = 0; j < chs.size(); j++) {
-            if (maskarr[i] != 0) {
-                chs[j].base[chs[j].stride * i] = ctx.channel(j)[0];
-            }
+            if (!chs[j].base) continue;
+            chs[j].base[chs[j].stride * i] = ctx.channel(j)[0];
         }
+        reds.gather_context(ctx, 1, partial);
     }
+
+    for (auto const &p: partials)
+        reds.merge(result, p);
+    reds.merge(result, partial);
 }
 
 struct ParticlesMaskedWrangle : zeno::INode {
@@ -81,6 +118,9 @@ struct ParticlesMaskedWrangle : zeno::INode {
             opts.define_symbol('@' + key, dim);
         });
 
+        ZfxReductions reds(get_input2<std::string>("reductions"));
+        reds.define_symbols(opts);
+
         auto params = has_input("params") ?
             get_input<zeno::DictObject>("params") :
             std::make_shared<zeno::DictObject>();
@@ -151,6 +191,7 @@ struct ParticlesMaskedWrangle : zeno::INode {
 
         auto prog = compiler.compile(code, opts);
         auto exec = assembler.assemble(prog->assembly);
+        reds.bind(prog.get());
 
         for (auto const &[name, dim]: prog->newsyms) {
             dbg_printf("auto-defined new attribute: %s with dim %d\n",
@@ -182,8 +223,12 @@ struct ParticlesMaskedWrangle : zeno::INode {
         for (int i = 0; i < chs.size(); i++) {
             auto [name, dimid] = prog->symbols[i];
             dbg_printf("channel %d: %s.%d\n", i, name.c_str(), dimid);
-            assert(name[0] == '@');
             Buffer iob;
+            if (reds.is_reduction_symbol(name)) {
+                chs[i] = iob;
+                continue;
+            }
+            assert(name[0] == '@');
             prim->attr_visit(name.substr(1),
             [&, dimid_ = dimid] (auto const &arr) {
                 iob.base = (float *)arr.data() + dimid_;
@@ -193,16 +238,18 @@ struct ParticlesMaskedWrangle : zeno::INode {
             chs[i] = iob;
         }
         auto &maskarr = prim->attr<int>(get_input2<std::string>("maskAttr"));
-        vectors_wrangle(exec, chs, maskarr.data());
+        std::vector<float> result;
+        vectors_wrangle(exec.get(), chs, prim->size(), maskarr.data(), reds, result);
 
         set_output("prim", std::move(prim));
+        set_output("reductions", reds.make_result(result));
     }
 };
 
 ZENDEFNODE(ParticlesMaskedWrangle, {
     {{"PrimitiveObject", "prim"},
-     {"string", "zfxCode"}, {"DictObject:NumericObject", "params"}, {"string", "maskAttr", "mask"}},
-    {{"PrimitiveObject", "prim"}},
+     {"string", "zfxCode"}, {"DictObject:NumericObject", "params"}, {"string", "reductions", ""}, {"string", "maskAttr", "mask"}},
+    {{"PrimitiveObject", "prim"}, {"DictObject:NumericObject", "reductions"}},
     {},
     {"zenofx"},
 });
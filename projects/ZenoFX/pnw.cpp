@@ -1,6 +1,7 @@
 #include <zeno/zeno.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/PrimitiveObject.h>
+#include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/NumericObject.h>
 #include <zeno/types/DictObject.h>
 #include <zeno/extra/GlobalState.h>
@@ -12,14 +13,16 @@
 #include <cmath>
 #include <atomic>
 #include <algorithm>
+#include <cstring>
+#include <cstdint>
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 namespace zeno {
 namespace {
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 struct Buffer {
     float *base = nullptr;
@@ -174,8 +177,17 @@ struct ParticlesBuildHashGrid : zeno::INode {
         float radius = get_input<zeno::NumericObject>("radius")->get<float>();
         float radiusMin = has_input("radiusMin") ?
             get_input<zeno::NumericObject>("radiusMin")->get<float>() : -1.f;
-        auto hashgrid = std::make_shared<HashGrid>(
+        // reused while primNei keeps the same positions; keyed on the bits
+        // of the radii, as to_string would round close radii together
+        uint32_t radiusBits, radiusMinBits;
+        std::memcpy(&radiusBits, &radius, sizeof(radiusBits));
+        std::memcpy(&radiusMinBits, &radiusMin, sizeof(radiusMinBits));
+        auto kind = "hashgrid:" + std::to_string(radiusBits) + ":" + std::to_string(radiusMinBits);
+        auto version = primVersion(primNei.get(), PrimitiveCache::pos);
+        auto hashgrid = primNei->cache.get<HashGrid>(kind, version, [&] {
+            return std::make_shared<HashGrid>(
                 primNei->attr<zeno::vec3f>("pos"), radius, radiusMin);
+        });
         set_output("hashGrid", std::move(hashgrid));
     }
 };
@@ -363,7 +375,7 @@ struct ParticlesNeighborWrangle : zeno::INode {
             chs2[i] = iob;
         }
 
-        vectors_wrangle(exec, chs, chs2, prim->attr<zeno::vec3f>("pos"),
+        vectors_wrangle(exec.get(), chs, chs2, prim->attr<zeno::vec3f>("pos"),
                 hashgrid.get());
 
         set_output("prim", std::move(prim));
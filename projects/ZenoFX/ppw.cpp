@@ -7,14 +7,19 @@
 #include <zeno/core/Graph.h>
 #include <zfx/zfx.h>
 #include <zfx/x64.h>
+#include <zeno/utils/Error.h>
+#include <zeno/types/LinearBvh.h>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include "dbg_printf.h"
 
 namespace zeno {
 namespace {
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
 
 struct Buffer {
     float *base = nullptr;
@@ -23,37 +28,198 @@ struct Buffer {
     int which = 0;
 };
 
+// neighbor queries over primNei positions, on the core point bvh
+struct PointQuery {
+    std::vector<zeno::vec3f> const &refpos;
+    zeno::LBvh bvh;
 
-static void vectors_wrangle
+    explicit PointQuery(std::vector<zeno::vec3f> const &refpos_)
+        : refpos(refpos_) {
+        if (refpos.empty())
+            return;
+        // a stand-in prim of the positions only, so that the leaves are all
+        // the points of primNei, and not only its `points` if it has any
+        auto prim = std::make_shared<zeno::PrimitiveObject>();
+        prim->verts.values = refpos;
+        bvh.build(prim, 0.f, zeno::LBvh::element_c<zeno::LBvh::element_e::point>);
+    }
+
+    static float dist_sqr(zeno::LBvh::Box const &box, zeno::vec3f const &pos) {
+        auto d = zeno::max(zeno::max(box.first - pos, pos - box.second), zeno::vec3f(0));
+        return zeno::dot(d, d);
+    }
+
+    template <class F>
+    void iter_radius(zeno::vec3f const &pos, float radius, F const &f) const {
+        if (refpos.empty())
+            return;
+        float radius_sqr = radius * radius;
+        bvh.traverse([&] (zeno::LBvh::Box const &box) {
+            return dist_sqr(box, pos) <= radius_sqr;
+        }, [&] (int pid) {
+            auto d = refpos[pid] - pos;
+            if (zeno::dot(d, d) <= radius_sqr)
+                f(pid);
+        });
+    }
+
+    // k nearest points sorted by distance, optionally limited by radius (<= 0 for no limit)
+    void find_knn(zeno::vec3f const &pos, int k, float radius,
+                  std::vector<std::pair<float, int>> &heap) const {
+        heap.clear();
+        if (k <= 0 || refpos.empty())
+            return;
+        // narrowed to the k-th distance once k points are found
+        float bound_sqr = radius > 0 ? radius * radius : std::numeric_limits<float>::infinity();
+        bvh.traverse([&] (zeno::LBvh::Box const &box) {
+            return dist_sqr(box, pos) <= bound_sqr;
+        }, [&] (int pid) {
+            auto d = refpos[pid] - pos;
+            float dis2 = zeno::dot(d, d);
+            if (dis2 > bound_sqr)
+                return;
+            if (heap.size() < k) {
+                heap.emplace_back(dis2, pid);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (std::pair{dis2, pid} < heap.front()) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = {dis2, pid};
+                std::push_heap(heap.begin(), heap.end());
+            }
+            if (heap.size() == k)
+                bound_sqr = heap.front().first;
+        });
+        std::sort_heap(heap.begin(), heap.end());
+    }
+};
+
+static void load_neighbor
+    ( zfx::x64::Executable::Context &ctx
+    , std::vector<Buffer> const &chs
+    , int pid) {
+    for (int k = 0; k < chs.size(); k++) {
+        if (chs[k].which)
+            ctx.channel(k)[0] = chs[k].base[chs[k].stride * pid];
+    }
+}
+
+// brute force all-pairs: each SIMD lane carries a different particle of prim,
+// while the particles of primNei are broadcast to all lanes in cache-sized tiles
+static void vectors_wrangle_all
     ( zfx::x64::Executable *exec
     , std::vector<Buffer> const &chs
-    , std::vector<Buffer> const &chs2
-    , std::vector<zeno::vec3f> const &pos
-    , std::vector<zeno::vec3f> const &posj) {
-    if (chs.size() == 0)
-        return;
+    , size_t size
+    , size_t sizej) {
+    constexpr size_t W = zfx::x64::Executable::SimdWidth;
+    constexpr size_t TileI = 8;  // contexts alive per task, 8 * 4 KiB
+    constexpr size_t TileJ = 512;
+    size_t ngroups = (size + W - 1) / W;
 
     #pragma omp parallel for
-    for (int i = 0; i < pos.size(); i++) {
-        auto ctx = exec->make_context();
-        for (int k = 0; k < chs.size(); k++) {
-            if (!chs[k].which)
-                ctx.channel(k)[0] = chs[k].base[chs[k].stride * i];
+    for (intptr_t gb = 0; gb < (intptr_t)ngroups; gb += TileI) {
+        size_t ge = std::min(ngroups, gb + TileI);
+        zfx::x64::Executable::Context ctxs[TileI];
+        for (size_t g = gb; g < ge; g++) {
+            auto &ctx = ctxs[g - gb] = exec->make_context();
+            for (int k = 0; k < chs.size(); k++) {
+                if (chs[k].which) continue;
+                for (size_t l = 0; l < W; l++) {
+                    size_t i = std::min(g * W + l, size - 1);
+                    ctx.channel(k)[l] = chs[k].base[chs[k].stride * i];
+                }
+            }
+        }
+        for (size_t jb = 0; jb < sizej; jb += TileJ) {
+            size_t je = std::min(sizej, jb + TileJ);
+            for (size_t g = gb; g < ge; g++) {
+                auto &ctx = ctxs[g - gb];
+                for (size_t j = jb; j < je; j++) {
+                    for (int k = 0; k < chs.size(); k++) {
+                        if (!chs[k].which) continue;
+                        float val = chs[k].base[chs[k].stride * j];
+                        for (size_t l = 0; l < W; l++)
+                            ctx.channel(k)[l] = val;
+                    }
+                    ctx.execute();
+                }
+            }
         }
-        for(int pid=0;pid<posj.size();pid++) {
+        for (size_t g = gb; g < ge; g++) {
+            auto &ctx = ctxs[g - gb];
             for (int k = 0; k < chs.size(); k++) {
-                if (chs[k].which)
-                    ctx.channel(k)[0] = chs2[k].base[chs2[k].stride * pid];
+                if (chs[k].which) continue;
+                for (size_t l = 0; l < W && g * W + l < size; l++)
+                    chs[k].base[chs[k].stride * (g * W + l)] = ctx.channel(k)[l];
             }
-            ctx.execute();
         }
-        for (int k = 0; k < chs.size(); k++) {
-            if (!chs[k].which)
-                chs[k].base[chs[k].stride * i] = ctx.channel(k)[0];
+    }
+}
+
+static void vectors_wrangle_near
+    ( zfx::x64::Executable *exec
+    , std::vector<Buffer> const &chs
+    , std::vector<zeno::vec3f> const &pos
+    , PointQuery const &query
+    , float radius
+    , int knn) {
+    #pragma omp parallel
+    {
+        std::vector<std::pair<float, int>> heap;
+        #pragma omp for
+        for (int i = 0; i < pos.size(); i++) {
+            auto ctx = exec->make_context();
+            for (int k = 0; k < chs.size(); k++) {
+                if (!chs[k].which)
+                    ctx.channel(k)[0] = chs[k].base[chs[k].stride * i];
+            }
+            if (knn > 0) {
+                query.find_knn(pos[i], knn, radius, heap);
+                for (auto const &[dis2, pid]: heap) {
+                    load_neighbor(ctx, chs, pid);
+                    ctx.execute();
+                }
+            } else {
+                query.iter_radius(pos[i], radius, [&] (int pid) {
+                    load_neighbor(ctx, chs, pid);
+                    ctx.execute();
+                });
+            }
+            for (int k = 0; k < chs.size(); k++) {
+                if (!chs[k].which)
+                    chs[k].base[chs[k].stride * i] = ctx.channel(k)[0];
+            }
         }
     }
 }
 
+static void vectors_wrangle
+    ( zfx::x64::Executable *exec
+    , std::vector<Buffer> const &chs
+    , std::vector<zeno::vec3f> const &pos
+    , std::vector<zeno::vec3f> const &posj
+    , std::string const &mode
+    , float radius
+    , int knn) {
+    if (chs.size() == 0 || pos.size() == 0)
+        return;
+
+    if (mode == "all") {
+        vectors_wrangle_all(exec, chs, pos.size(), posj.size());
+    } else if (mode == "radius") {
+        if (radius <= 0)
+            throw makeError("radius must be positive in radius mode");
+        PointQuery query(posj);
+        vectors_wrangle_near(exec, chs, pos, query, radius, 0);
+    } else if (mode == "knn") {
+        if (knn <= 0)
+            return;
+        PointQuery query(posj);
+        vectors_wrangle_near(exec, chs, pos, query, radius, knn);
+    } else {
+        throw makeError("invalid mode: " + mode);
+    }
+}
+
 struct ParticleParticleWrangle : zeno::INode {
     virtual void apply() override {
         auto prim = get_input<zeno::PrimitiveObject>("prim1");
@@ -200,7 +366,7 @@ struct ParticleParticleWrangle : zeno::INode {
                 primPtr = prim.get();
                 iob.which = 0;
             }
-            prim->attr_visit(name, [&, dimid_ = dimid] (auto const &arr) {
+            primPtr->attr_visit(name, [&, dimid_ = dimid] (auto const &arr) {
                 iob.base = (float *)arr.data() + dimid_;
                 iob.count = arr.size();
                 iob.stride = sizeof(arr[0]) / sizeof(float);
@@ -208,31 +374,11 @@ struct ParticleParticleWrangle : zeno::INode {
             chs[i] = iob;
         }
 
-        std::vector<Buffer> chs2(prog->symbols.size());
-        for (int i = 0; i < chs2.size(); i++) {
-            auto [name, dimid] = prog->symbols[i];
-            dbg_printf("channel %d: %s.%d\n", i, name.c_str(), dimid);
-            assert(name[0] == '@');
-            Buffer iob;
-            zeno::PrimitiveObject *primPtr;
-            if (name[1] == '@') {
-                name = name.substr(2);
-                primPtr = primNei.get();
-                iob.which = 1;
-            } else {
-                name = name.substr(1);
-                primPtr = prim.get();
-                iob.which = 0;
-            }
-            primNei->attr_visit(name, [&, dimid_ = dimid] (auto const &arr) {
-                iob.base = (float *)arr.data() + dimid_;
-                iob.count = arr.size();
-                iob.stride = sizeof(arr[0]) / sizeof(float);
-            });
-            chs2[i] = iob;
-        }
-
-        vectors_wrangle(exec, chs, chs2, prim->attr<zeno::vec3f>("pos"), primNei->attr<zeno::vec3f>("pos"));
+        auto mode = get_input2<std::string>("mode");
+        auto radius = get_input2<float>("radius");
+        auto knn = get_input2<int>("k");
+        vectors_wrangle(exec.get(), chs, prim->attr<zeno::vec3f>("pos"),
+                primNei->attr<zeno::vec3f>("pos"), mode, radius, knn);
 
         set_output("prim", std::move(prim));
     }
@@ -240,7 +386,9 @@ struct ParticleParticleWrangle : zeno::INode {
 
 ZENDEFNODE(ParticleParticleWrangle, {
     {{"PrimitiveObject", "prim1"}, {"PrimitiveObject", "prim2"},
-     {"string", "zfxCode"}, {"DictObject:NumericObject", "params"}},
+     {"string", "zfxCode"}, {"DictObject:NumericObject", "params"},
+     {"enum all radius knn", "mode", "all"},
+     {"float", "radius", "0"}, {"int", "k", "8"}},
     {{"PrimitiveObject", "prim"}},
     {},
     {"zenofx"},
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <zeno/types/NumericObject.h>
+#include <zeno/types/DictObject.h>
+#include <zeno/utils/Error.h>
+#include <zfx/zfx.h>
+#include <zfx/x64.h>
+#include <sstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace zeno {
+
+// reduction outputs of a wrangle, declared by a spec like "max:maxspeed sum:com:3 count:n",
+// each sum, min or max is a `$name` channel accumulated per SIMD lane by the kernel itself, e.g.:
+//   $maxspeed = max($maxspeed, length(@vel))
+//   $com += @pos
+// a count has no channel, it is the number of elements processed (not masked out);
+// lanes are combined into a per thread partial after each SIMD group, and threads
+// are combined after the parallel loop
+struct ZfxReductions {
+    struct Reduction {
+        std::string op;
+        std::string name;
+        int dim = 1;
+    };
+
+    struct Component {
+        int red = 0;
+        int chid = -1;
+    };
+
+    std::vector<Reduction> reds;
+    std::vector<Component> comps;
+
+    explicit ZfxReductions(std::string const &spec) {
+        std::istringstream ss(spec);
+        std::string ent;
+        while (ss >> ent) {
+            Reduction red;
+            auto p = ent.find(':');
+            if (p == std::string::npos)
+                throw makeError("bad reduction `" + ent + "`, expect `op:name` or `op:name:dim`");
+            red.op = ent.substr(0, p);
+            red.name = ent.substr(p + 1);
+            if (auto q = red.name.find(':'); q != std::string::npos) {
+                red.dim = std::stoi(red.name.substr(q + 1));
+                red.name = red.name.substr(0, q);
+            }
+            if (red.op != "sum" && red.op != "min" && red.op != "max" && red.op != "count")
+                throw makeError("bad reduction op `" + red.op + "`, expect sum, min, max or count");
+            if (red.dim != 1 && red.dim != 3)
+                throw makeError("bad reduction dimension for `" + red.name + "`, expect 1 or 3");
+            if (red.op == "count" && red.dim != 1)
+                throw makeError("count reduction `" + red.name + "` must have dimension 1");
+            reds.push_back(red);
+        }
+    }
+
+    bool empty() const {
+        return reds.empty();
+    }
+
+    void define_symbols(zfx::Options &opts) const {
+        for (auto const &red: reds) {
+            if (red.op != "count")
+                opts.define_symbol('$' + red.name, red.dim);
+        }
+    }
+
+    bool is_reduction_symbol(std::string const &name) const {
+        return name.size() && name[0] == '$';
+    }
+
+    void bind(zfx::Program const *prog) {
+        comps.clear();
+        for (int r = 0; r < reds.size(); r++) {
+            for (int d = 0; d < reds[r].dim; d++) {
+                int chid = reds[r].op == "count" ? -1 : prog->symbol_id('$' + reds[r].name, d);
+                comps.push_back({r, chid});
+            }
+        }
+    }
+
+    float identity(int c) const {
+        auto const &op = reds[comps[c].red].op;
+        if (op == "min") return std::numeric_limits<float>::infinity();
+        if (op == "max") return -std::numeric_limits<float>::infinity();
+        return 0.f;
+    }
+
+    float combine(int c, float x, float y) const {
+        auto const &op = reds[comps[c].red].op;
+        if (op == "min") return std::min(x, y);
+        if (op == "max") return std::max(x, y);
+        return x + y;
+    }
+
+    std::vector<float> make_partial() const {
+        std::vector<float> partial(comps.size());
+        for (int c = 0; c < comps.size(); c++)
+            partial[c] = identity(c);
+        return partial;
+    }
+
+    void init_context(zfx::x64::Executable::Context &ctx) const {
+        for (int c = 0; c < comps.size(); c++) {
+            if (comps[c].chid == -1) continue;
+            for (int k = 0; k < zfx::x64::Executable::SimdWidth; k++)
+                ctx.channel(comps[c].chid)[k] = identity(c);
+        }
+    }
+
+    // fold the first `nlanes` lanes of the accumulators into `partial`, but
+    // those whose mask is zero
+    void gather_context(zfx::x64::Executable::Context &ctx, int nlanes,
+                        std::vector<float> &partial, int const *mask = nullptr) const {
+        for (int c = 0; c < comps.size(); c++) {
+            bool count = reds[comps[c].red].op == "count";
+            if (!count && comps[c].chid == -1) continue;
+            for (int k = 0; k < nlanes; k++) {
+                if (mask && mask[k] == 0) continue;
+                partial[c] = combine(c, partial[c], count ? 1.f : ctx.channel(comps[c].chid)[k]);
+            }
+        }
+    }
+
+    void merge(std::vector<float> &partial, std::vector<float> const &other) const {
+        for (int c = 0; c < comps.size(); c++)
+            partial[c] = combine(c, partial[c], other[c]);
+    }
+
+    std::shared_ptr<DictObject> make_result(std::vector<float> const &partial) const {
+        auto result = std::make_shared<DictObject>();
+        for (int c = 0, r = 0; r < reds.size(); c += reds[r].dim, r++) {
+            auto const &red = reds[r];
+            if (red.op == "count")
+                result->lut[red.name] = objectFromLiterial((int)partial[c]);
+            else if (red.dim == 3)
+                result->lut[red.name] = objectFromLiterial(vec3f(partial[c], partial[c + 1], partial[c + 2]));
+            else
+                result->lut[red.name] = objectFromLiterial(partial[c]);
+        }
+        return result;
+    }
+};
+
+}
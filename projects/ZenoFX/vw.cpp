@@ -11,6 +11,8 @@
 #include <zfx/zfx.h>
 #include <zfx/x64.h>
 #include <cassert>
+#include <atomic>
+#include <cmath>
 #include "dbg_printf.h"
 #include <zeno/StringObject.h>
 #include <zeno/utils/zeno_p.h>
@@ -18,103 +20,139 @@
 namespace zeno {
 namespace {
 
-static zfx::Compiler compiler;
-static zfx::x64::Assembler assembler;
+static auto &compiler = zfx::Compiler::shared();
+static auto &assembler = zfx::x64::Assembler::shared();
+
+template <class T>
+static void vdb_load_value(zfx::x64::Executable::Context &ctx, int lane, T const &v) {
+    if constexpr (std::is_same_v<T, openvdb::Vec3f>) {
+        ctx.channel(0)[lane] = v[0];
+        ctx.channel(1)[lane] = v[1];
+        ctx.channel(2)[lane] = v[2];
+    } else {
+        ctx.channel(0)[lane] = v;
+    }
+}
+
+template <class T>
+static void vdb_store_value(zfx::x64::Executable::Context &ctx, int lane, T &v) {
+    if constexpr (std::is_same_v<T, openvdb::Vec3f>) {
+        v[0] = ctx.channel(0)[lane];
+        v[1] = ctx.channel(1)[lane];
+        v[2] = ctx.channel(2)[lane];
+    } else {
+        v = ctx.channel(0)[lane];
+    }
+}
+
+template <class T>
+static float vdb_value_norm(T const &v) {
+    if constexpr (std::is_same_v<T, openvdb::Vec3f>) {
+        return std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+    } else {
+        return std::abs(v);
+    }
+}
 
 template <class GridPtr>
-void vdb_wrangle(zfx::x64::Executable *exec, GridPtr &grid, bool modifyActive, bool changeBackground, bool hasPos) {
-    //ZENO_P(grid->background());
-    auto wrangler = [&](auto &leaf, openvdb::Index leafpos) {
-        std::visit([&] (auto hasPos) {
-            for (auto iter = leaf.beginValueOn(); iter != leaf.endValueOn(); ++iter) {
-                iter.modifyValue([&](auto &v) {
-                    auto ctx = exec->make_context();
-                    if constexpr (std::is_same_v<std::decay_t<decltype(v)>, openvdb::Vec3f>) {
-                        ctx.channel(0)[0] = v[0];
-                        ctx.channel(1)[0] = v[1];
-                        ctx.channel(2)[0] = v[2];
-                        if (hasPos) {
-                            openvdb::Vec3f p = grid->transformPtr()->indexToWorld(iter.getCoord());
-                            ctx.channel(3)[0] = p[0];
-                            ctx.channel(4)[0] = p[1];
-                            ctx.channel(5)[0] = p[2];
-                        }
-                        ctx.execute();
-                        v[0] = ctx.channel(0)[0];
-                        v[1] = ctx.channel(1)[0];
-                        v[2] = ctx.channel(2)[0];
-        
-                    } else {
-                        ctx.channel(0)[0] = v;
-                        if (hasPos) {
-                            openvdb::Vec3f p = grid->transformPtr()->indexToWorld(iter.getCoord());
-                            ctx.channel(1)[0] = p[0];
-                            ctx.channel(2)[0] = p[1];
-                            ctx.channel(3)[0] = p[2];
-                        }
-                        ctx.execute();
-                        v = ctx.channel(0)[0];
+void vdb_wrangle(zfx::x64::Executable *exec, GridPtr &grid, bool modifyActive, bool changeBackground, bool hasPos, bool activeOnly) {
+    using TreeT = std::decay_t<decltype(grid->tree())>;
+    using LeafT = typename TreeT::LeafNodeType;
+    using ValueT = typename TreeT::ValueType;
+    constexpr int SimdWidth = zfx::x64::Executable::SimdWidth;
+    constexpr int posBase = std::is_same_v<ValueT, openvdb::Vec3f> ? 3 : 1;
 
-                    }
-                    
-                });
-
-                if(modifyActive){
-                    float testv;
-                    auto v = iter.getValue();
-                    if constexpr (std::is_same_v<std::decay_t<decltype(v)>, openvdb::Vec3f>)
-                    {
-                        testv = std::sqrt(v[0]*v[0]+v[1]*v[1]+v[2]*v[2]);
+    // for linear transforms world position is affine in the voxel index:
+    // p = indexToWorld(origin) + x * ax + y * ay + z * az
+    auto const &xform = grid->transform();
+    bool isLinear = xform.isLinear();
+    openvdb::Vec3d w0 = xform.indexToWorld(openvdb::Vec3d(0, 0, 0));
+    openvdb::Vec3d ax = xform.indexToWorld(openvdb::Vec3d(1, 0, 0)) - w0;
+    openvdb::Vec3d ay = xform.indexToWorld(openvdb::Vec3d(0, 1, 0)) - w0;
+    openvdb::Vec3d az = xform.indexToWorld(openvdb::Vec3d(0, 0, 1)) - w0;
+
+    std::atomic<bool> hasConstLeaf{false};
+
+    auto wrangler = [&](LeafT &leaf, openvdb::Index leafpos) {
+        ValueT *data = leaf.buffer().data();
+        auto origin = leaf.origin();
+        openvdb::Vec3d base = xform.indexToWorld(origin);
+
+        openvdb::Index offsets[SimdWidth];
+        int nlanes = 0;
+        auto ctx = exec->make_context();
+
+        auto flush = [&] {
+            for (int k = 0; k < nlanes; k++) {
+                vdb_load_value(ctx, k, data[offsets[k]]);
+                if (hasPos) {
+                    openvdb::Vec3d p;
+                    if (isLinear) {
+                        auto n = offsets[k];
+                        int x = n >> (2 * LeafT::LOG2DIM);
+                        int y = (n >> LeafT::LOG2DIM) & (LeafT::DIM - 1);
+                        int z = n & (LeafT::DIM - 1);
+                        p = base + ax * x + ay * y + az * z;
                     } else {
-                        testv = std::abs(v);
-                    }
-                    if(testv<1e-5)
-                    {
-                        iter.setValueOn(false);
-                    }
-                    else{
-                        iter.setValueOn(true);
+                        p = xform.indexToWorld(leaf.offsetToGlobalCoord(offsets[k]));
                     }
+                    ctx.channel(posBase + 0)[k] = p[0];
+                    ctx.channel(posBase + 1)[k] = p[1];
+                    ctx.channel(posBase + 2)[k] = p[2];
                 }
             }
-        }, boolean_variant(hasPos));
+            ctx.execute();
+            for (int k = 0; k < nlanes; k++) {
+                auto &v = data[offsets[k]];
+                vdb_store_value(ctx, k, v);
+                if (modifyActive)
+                    leaf.setActiveState(offsets[k], !(vdb_value_norm(v) < 1e-5));
+            }
+            nlanes = 0;
+        };
+
+        if (activeOnly) {
+            for (auto iter = leaf.getValueMask().beginOn(); iter; ++iter) {
+                offsets[nlanes++] = iter.pos();
+                if (nlanes == SimdWidth)
+                    flush();
+            }
+        } else {
+            for (openvdb::Index n = 0; n < LeafT::SIZE; n++) {
+                offsets[nlanes++] = n;
+                if (nlanes == SimdWidth)
+                    flush();
+            }
+        }
+        if (nlanes)
+            flush();
+
+        // record prune candidates here, while the leaf is still hot in cache,
+        // so that the tree-wide prune pass can be skipped when there are none
+        ValueT firstValue;
+        bool state;
+        if (leaf.isConstant(firstValue, state))
+            hasConstLeaf.store(true, std::memory_order_relaxed);
     };
-    auto velman = openvdb::tree::LeafManager<std::decay_t<decltype(grid->tree())>>(grid->tree());
+    auto velman = openvdb::tree::LeafManager<TreeT>(grid->tree());
     velman.foreach(wrangler);
     if (changeBackground) {
         auto v = grid->background();
         {
             auto ctx = exec->make_context();
-            openvdb::Vec3f p(0, 0, 0);
-                    if constexpr (std::is_same_v<std::decay_t<decltype(v)>, openvdb::Vec3f>) {
-                        ctx.channel(0)[0] = v[0];
-                        ctx.channel(1)[0] = v[1];
-                        ctx.channel(2)[0] = v[2];
-                        if (hasPos) {
-                            ctx.channel(3)[0] = p[0];
-                            ctx.channel(4)[0] = p[1];
-                            ctx.channel(5)[0] = p[2];
-                        }
-                        ctx.execute();
-                        v[0] = ctx.channel(0)[0];
-                        v[1] = ctx.channel(1)[0];
-                        v[2] = ctx.channel(2)[0];
-        
-                    } else {
-                        ctx.channel(0)[0] = v;
-                        if (hasPos) {
-                            ctx.channel(1)[0] = p[0];
-                            ctx.channel(2)[0] = p[1];
-                            ctx.channel(3)[0] = p[2];
-                        }
-                        ctx.execute();
-                        v = ctx.channel(0)[0];
-
-                    }
+            vdb_load_value(ctx, 0, v);
+            if (hasPos) {
+                ctx.channel(posBase + 0)[0] = 0;
+                ctx.channel(posBase + 1)[0] = 0;
+                ctx.channel(posBase + 2)[0] = 0;
+            }
+            ctx.execute();
+            vdb_store_value(ctx, 0, v);
         }
         openvdb::tools::changeBackground(grid->tree(), v);
     }
-    openvdb::tools::prune(grid->tree());
+    if (hasConstLeaf.load(std::memory_order_relaxed))
+        openvdb::tools::prune(grid->tree());
 }
 
 struct VDBWrangle : zeno::INode {
@@ -214,10 +252,12 @@ struct VDBWrangle : zeno::INode {
             (get_input<zeno::StringObject>("ModifyActive")->get())=="true" : false;
         auto changeBackground = has_input("ChangeBackground") ?
             (get_input<zeno::StringObject>("ChangeBackground")->get())=="true" : false;
+        auto activeOnly = has_input("ActiveOnly") ?
+            (get_input<zeno::StringObject>("ActiveOnly")->get())=="true" : true;
         if (auto p = std::dynamic_pointer_cast<zeno::VDBFloatGrid>(grid); p)
-            vdb_wrangle(exec, p->m_grid, modifyActive, changeBackground, hasPos);
+            vdb_wrangle(exec.get(), p->m_grid, modifyActive, changeBackground, hasPos, activeOnly);
         else if (auto p = std::dynamic_pointer_cast<zeno::VDBFloat3Grid>(grid); p)
-            vdb_wrangle(exec, p->m_grid, modifyActive, changeBackground, hasPos);
+            vdb_wrangle(exec.get(), p->m_grid, modifyActive, changeBackground, hasPos, activeOnly);
 
         set_output("grid", std::move(grid));
     }
@@ -227,6 +267,7 @@ ZENDEFNODE(VDBWrangle, {
     {{"VDBGrid", "grid"}, {"string", "zfxCode"},
      {"enum true false","ModifyActive","false"},
      {"enum true false","ChangeBackground","false"},
+     {"enum true false","ActiveOnly","true"},
      {"DictObject:NumericObject", "params"}},
     {{"VDBGrid", "grid"}},
     {},
@@ -0,0 +1,287 @@
+#include <zeno/zeno.h>
+#include <zeno/VDBGrid.h>
+#include <zeno/funcs/ObjectCodec.h>
+#include <zeno/para/parallel_for.h>
+#include <zeno/utils/log.h>
+#include <openvdb/io/Stream.h>
+#include <openvdb/io/io.h>
+#include <streambuf>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+
+// off until an encode and decode round trip of each grid type has been run
+#ifdef ZENO_VDB_OBJECT_CODEC
+
+namespace zeno {
+namespace {
+
+// a grid is encoded as its type name, then one of:
+// - kLeaves, for grids of plain values: the transform and metadata, the
+//   background, the tiles, and every leaf as its origin, value mask and the
+//   values of its buffer, which are copied out and in again in parallel
+// - kStream, for point data grids: the openvdb stream format, compressed
+enum : std::uint8_t {
+    kLeaves = 0,
+    kStream = 1,
+};
+
+template <class T>
+void put(std::vector<char> &buf, T const &val) {
+    buf.insert(buf.end(), (char const *)&val, (char const *)(&val + 1));
+}
+
+void put_string(std::vector<char> &buf, std::string const &str) {
+    put(buf, (std::uint64_t)str.size());
+    buf.insert(buf.end(), str.begin(), str.end());
+}
+
+template <class T>
+bool take(char const *&it, char const *end, T &val) {
+    if ((std::size_t)(end - it) < sizeof(T))
+        return false;
+    std::memcpy(&val, it, sizeof(T));
+    it += sizeof(T);
+    return true;
+}
+
+bool take_string(char const *&it, char const *end, std::string &str) {
+    std::uint64_t size;
+    if (!take(it, end, size) || size > (std::uint64_t)(end - it))
+        return false;
+    str.assign(it, size);
+    it += size;
+    return true;
+}
+
+// reads from memory with no copy of it
+struct MemoryBuf : std::streambuf {
+    MemoryBuf(char const *data, std::size_t size) {
+        auto p = const_cast<char *>(data);
+        setg(p, p, p + size);
+    }
+};
+
+template <class GridT>
+void encode_leaves(GridT const &grid, std::vector<char> &buf) {
+    using TreeT = typename GridT::TreeType;
+    using LeafT = typename TreeT::LeafNodeType;
+    using MaskT = typename LeafT::NodeMaskType;
+    using ValueT = typename GridT::ValueType;
+
+    std::ostringstream meta(std::ios::binary);
+    grid.transform().write(meta);
+    grid.writeMeta(meta);
+    put_string(buf, meta.str());
+    put(buf, grid.background());
+
+    // tiles, of any level above the leaves, that are active or not background
+    std::vector<char> tiles;
+    std::uint64_t ntiles = 0;
+    auto tileIt = grid.tree().cbeginValueAll();
+    tileIt.setMaxDepth(decltype(tileIt)::LEAF_DEPTH - 1);
+    for (; tileIt; ++tileIt) {
+        if (!tileIt.isValueOn() && openvdb::math::isExactlyEqual(*tileIt, grid.background()))
+            continue;
+        auto xyz = tileIt.getCoord();
+        put(tiles, (std::int32_t)xyz.x());
+        put(tiles, (std::int32_t)xyz.y());
+        put(tiles, (std::int32_t)xyz.z());
+        put(tiles, (std::uint32_t)tileIt.getLevel());
+        put(tiles, *tileIt);
+        put(tiles, (std::uint8_t)tileIt.isValueOn());
+        ntiles++;
+    }
+    put(buf, ntiles);
+    buf.insert(buf.end(), tiles.begin(), tiles.end());
+
+    std::vector<LeafT const *> leaves;
+    leaves.reserve(grid.tree().leafCount());
+    for (auto it = grid.tree().cbeginLeaf(); it; ++it)
+        leaves.push_back(it.getLeaf());
+    put(buf, (std::uint64_t)leaves.size());
+
+    constexpr std::size_t kRecord = 3 * sizeof(std::int32_t) + MaskT::WORD_COUNT * sizeof(openvdb::Index64)
+        + LeafT::SIZE * sizeof(ValueT);
+    std::size_t base = buf.size();
+    buf.resize(base + leaves.size() * kRecord);
+    parallel_for(leaves.size(), [&] (std::size_t i) {
+        auto const *leaf = leaves[i];
+        char *out = buf.data() + base + i * kRecord;
+        auto origin = leaf->origin();
+        std::int32_t xyz[3] = {origin.x(), origin.y(), origin.z()};
+        std::memcpy(out, xyz, sizeof(xyz));
+        out += sizeof(xyz);
+        auto const &mask = leaf->getValueMask();
+        for (openvdb::Index w = 0; w < MaskT::WORD_COUNT; w++) {
+            openvdb::Index64 word = mask.template getWord<openvdb::Index64>(w);
+            std::memcpy(out, &word, sizeof(word));
+            out += sizeof(word);
+        }
+        std::memcpy(out, leaf->buffer().data(), LeafT::SIZE * sizeof(ValueT));
+    });
+}
+
+template <class GridT>
+typename GridT::Ptr decode_leaves(char const *it, char const *end) {
+    using TreeT = typename GridT::TreeType;
+    using LeafT = typename TreeT::LeafNodeType;
+    using MaskT = typename LeafT::NodeMaskType;
+    using ValueT = typename GridT::ValueType;
+
+    std::string meta;
+    ValueT background;
+    std::uint64_t ntiles;
+    if (!take_string(it, end, meta) || !take(it, end, background) || !take(it, end, ntiles))
+        return nullptr;
+    auto grid = GridT::create(background);
+    MemoryBuf metabuf(meta.data(), meta.size());
+    std::istream metais(&metabuf);
+    // a bare stream has no file version, with which the transform would be
+    // read in the legacy format
+    openvdb::io::setCurrentVersion(metais);
+    auto transform = openvdb::math::Transform::createLinearTransform();
+    transform->read(metais);
+    grid->setTransform(transform);
+    grid->readMeta(metais);
+
+    for (std::uint64_t t = 0; t < ntiles; t++) {
+        std::int32_t x, y, z;
+        std::uint32_t level;
+        ValueT value;
+        std::uint8_t active;
+        if (!take(it, end, x) || !take(it, end, y) || !take(it, end, z) || !take(it, end, level)
+            || !take(it, end, value) || !take(it, end, active))
+            return nullptr;
+        grid->tree().addTile(level, openvdb::Coord(x, y, z), value, active != 0);
+    }
+
+    std::uint64_t nleaves;
+    constexpr std::size_t kRecord = 3 * sizeof(std::int32_t) + MaskT::WORD_COUNT * sizeof(openvdb::Index64)
+        + LeafT::SIZE * sizeof(ValueT);
+    if (!take(it, end, nleaves) || nleaves > (std::uint64_t)(end - it) / kRecord)
+        return nullptr;
+    std::vector<LeafT *> leaves(nleaves);
+    parallel_for((std::size_t)nleaves, [&] (std::size_t i) {
+        char const *in = it + i * kRecord;
+        std::int32_t xyz[3];
+        std::memcpy(xyz, in, sizeof(xyz));
+        in += sizeof(xyz);
+        auto leaf = new LeafT(openvdb::Coord(xyz[0], xyz[1], xyz[2]), background);
+        MaskT mask;
+        for (openvdb::Index w = 0; w < MaskT::WORD_COUNT; w++) {
+            std::memcpy(&mask.template getWord<openvdb::Index64>(w), in, sizeof(openvdb::Index64));
+            in += sizeof(openvdb::Index64);
+        }
+        leaf->setValueMask(mask);
+        std::memcpy(leaf->buffer().data(), in, LeafT::SIZE * sizeof(ValueT));
+        leaves[i] = leaf;
+    });
+    // the tree takes the leaves over, one after another
+    for (auto leaf: leaves)
+        grid->tree().addLeaf(leaf);
+    return grid;
+}
+
+template <class GridT>
+void encode_stream(typename GridT::Ptr const &grid, std::vector<char> &buf) {
+    std::ostringstream os(std::ios::binary);
+    openvdb::io::Stream stream(os);
+    stream.setCompression(openvdb::io::Archive::hasBloscCompression()
+        ? openvdb::io::COMPRESS_BLOSC | openvdb::io::COMPRESS_ACTIVE_MASK
+        : openvdb::io::COMPRESS_ZIP | openvdb::io::COMPRESS_ACTIVE_MASK);
+    stream.write(openvdb::GridCPtrVec{grid});
+    put_string(buf, os.str());
+}
+
+template <class GridT>
+typename GridT::Ptr decode_stream(char const *it, char const *end) {
+    std::uint64_t size;
+    if (!take(it, end, size) || size > (std::uint64_t)(end - it))
+        return nullptr;
+    MemoryBuf membuf(it, size);
+    std::istream is(&membuf);
+    openvdb::io::Stream stream(is, false);
+    auto grids = stream.getGrids();
+    if (!grids || grids->empty())
+        return nullptr;
+    return openvdb::gridPtrCast<GridT>(grids->front());
+}
+
+// calls f with a null pointer of each wrapper type, until it returns true
+template <class F>
+bool visit_vdb_types(F &&f) {
+    return f((VDBFloatGrid *)nullptr) || f((VDBIntGrid *)nullptr) || f((VDBFloat3Grid *)nullptr)
+        || f((VDBInt3Grid *)nullptr) || f((VDBPointsGrid *)nullptr);
+}
+
+template <class WrapperT>
+using grid_of = typename decltype(std::declval<WrapperT>().m_grid)::element_type;
+
+template <class GridT>
+constexpr bool is_points_grid = std::is_same_v<GridT, openvdb::points::PointDataGrid>;
+
+bool encodeVDBGrid(IObject const *object, std::vector<char> &buf) {
+    return visit_vdb_types([&] (auto *tag) {
+        using WrapperT = std::remove_pointer_t<decltype(tag)>;
+        using GridT = grid_of<WrapperT>;
+        auto obj = dynamic_cast<WrapperT const *>(object);
+        if (!obj)
+            return false;
+        auto grid = obj->m_grid ? obj->m_grid : GridT::create();
+        put_string(buf, obj->getType());
+        if constexpr (is_points_grid<GridT>) {
+            put(buf, (std::uint8_t)kStream);
+            encode_stream<GridT>(grid, buf);
+        } else {
+            put(buf, (std::uint8_t)kLeaves);
+            encode_leaves(*grid, buf);
+        }
+        return true;
+    });
+}
+
+std::shared_ptr<IObject> decodeVDBGrid(const char *buf, size_t len) {
+    char const *it = buf, *end = buf + len;
+    std::string type;
+    std::uint8_t encoding;
+    if (!take_string(it, end, type) || !take(it, end, encoding)) {
+        log_error("vdb grid data broken");
+        return nullptr;
+    }
+    std::shared_ptr<IObject> result;
+    try {
+        visit_vdb_types([&] (auto *tag) {
+            using WrapperT = std::remove_pointer_t<decltype(tag)>;
+            using GridT = grid_of<WrapperT>;
+            auto obj = std::make_shared<WrapperT>();
+            if (obj->getType() != type)
+                return false;
+            typename GridT::Ptr grid;
+            if (encoding == kStream) {
+                grid = decode_stream<GridT>(it, end);
+            } else if constexpr (!is_points_grid<GridT>) {
+                if (encoding == kLeaves)
+                    grid = decode_leaves<GridT>(it, end);
+            }
+            if (grid) {
+                obj->m_grid = std::move(grid);
+                result = std::move(obj);
+            }
+            return true;
+        });
+    } catch (std::exception const &e) {
+        log_error("vdb grid data broken: {}", e.what());
+        return nullptr;
+    }
+    if (!result)
+        log_error("vdb grid data broken, or of unknown type `{}`", type);
+    return result;
+}
+
+static int defVDBGridCodec = registerObjectCodec("VDBGrid", encodeVDBGrid, decodeVDBGrid);
+
+}
+}
+
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <zeno/core/IObject.h>
+#include <functional>
 #include <vector>
 #include <string>
 #include <memory>
@@ -10,4 +11,11 @@ namespace zeno {
 ZENO_API std::shared_ptr<IObject> decodeObject(const char *buf, size_t len);
 ZENO_API bool encodeObject(IObject const *object, std::vector<char> &buf);
 
+// codecs of object types that live in extension modules, which the core does
+// not know of: `encode` appends to `buf` and returns false for objects not of
+// its type, `decode` gets exactly what `encode` appended
+using ObjectEncoder = std::function<bool(IObject const *object, std::vector<char> &buf)>;
+using ObjectDecoder = std::function<std::shared_ptr<IObject>(const char *buf, size_t len)>;
+ZENO_API int registerObjectCodec(std::string const &name, ObjectEncoder encode, ObjectDecoder decode);
+
 }
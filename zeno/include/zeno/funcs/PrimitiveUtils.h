@@ -6,6 +6,9 @@
 
 namespace zeno {
 
+struct LBvh;
+struct PrimitiveTopology;
+
 ZENO_API void primTriangulateQuads(PrimitiveObject *prim);
 ZENO_API void primTriangulate(PrimitiveObject *prim, bool with_uv = true, bool has_lines = true);
 ZENO_API void primPolygonate(PrimitiveObject *prim, bool with_uv = true);
@@ -14,12 +17,13 @@ ZENO_API void primSepTriangles(PrimitiveObject *prim, bool smoothNormal = true,
 //ZENO_API void primSmoothNormal(PrimitiveObject *prim, bool isFlipped = false);
 
 ZENO_API void primFlipFaces(PrimitiveObject *prim);
-ZENO_API void primCalcNormal(PrimitiveObject *prim, float flip = 1.0f, std::string nrmAttr = "nrm");
+ZENO_API void primCalcNormal(PrimitiveObject *prim, float flip = 1.0f, std::string nrmAttr = "nrm", std::string weightType = "area");
 //ZENO_API void primCalcInsetDir(PrimitiveObject *prim, float flip = 1.0f, std::string nrmAttr = "nrm");
 
 ZENO_API void primWireframe(PrimitiveObject *prim, bool removeFaces = false, bool toEdges = false);
 ZENO_API void primEdgeBound(PrimitiveObject *prim, bool removeFaces = false, bool toEdges = false);
 ZENO_API void primKillDeadVerts(PrimitiveObject *prim);
+ZENO_API std::shared_ptr<PrimitiveTopology const> primTopology(PrimitiveObject const *prim);
 
 ZENO_API void primDecodeUVs(PrimitiveObject *prim);
 ZENO_API void primLoopUVsToVerts(PrimitiveObject *prim);
@@ -33,6 +37,7 @@ ZENO_API void primLineDistance(PrimitiveObject *prim, std::string resAttr, int s
 ZENO_API void primFilterVerts(PrimitiveObject *prim, std::string tagAttr, int tagValue, bool isInversed = false, std::string revampAttrO = {});
 
 ZENO_API void primMarkIsland(PrimitiveObject *prim, std::string tagAttr);
+ZENO_API void primMarkClose(PrimitiveObject *prim, std::string tagAttr, float distance);
 ZENO_API std::vector<std::shared_ptr<PrimitiveObject>> primUnmergeVerts(PrimitiveObject *prim, std::string tagAttr);
 
 ZENO_API void primSimplifyTag(PrimitiveObject *prim, std::string tagAttr);
@@ -43,10 +48,15 @@ ZENO_API void primScale(PrimitiveObject *prim, vec3f const &scale);
 
 ZENO_API std::pair<vec3f, vec3f> primBoundingBox(PrimitiveObject *prim);
 
+ZENO_API std::uint64_t primVersion(PrimitiveObject const *prim, unsigned deps);
+ZENO_API std::shared_ptr<LBvh> primCachedBvh(std::shared_ptr<PrimitiveObject> const &prim, std::string type = "auto", float thickness = 0.f, int width = 0);
+
 ZENO_API void primRandomize(PrimitiveObject *prim, std::string attr, std::string dirAttr, std::string seedAttr, std::string randType, float base, float scale, int seed);
 ZENO_API void primPerlinNoise(PrimitiveObject *prim, std::string inAttr, std::string outAttr, std::string outType, float scale, float detail, float roughness, float disortion, vec3f offset, float average, float strength);
 
 ZENO_API std::shared_ptr<PrimitiveObject> primScatter(
     PrimitiveObject *prim, std::string type, std::string denAttr, float density, float minRadius, bool interpAttrs, int seed);
 
+ZENO_API std::shared_ptr<PrimitiveObject> primReadObj(std::string const &path, std::vector<vec3f> *nrms = nullptr);
+
 }
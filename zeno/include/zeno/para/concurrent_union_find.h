@@ -0,0 +1,78 @@
+#pragma once
+
+#include <zeno/para/parallel_for.h>
+#include <zeno/para/parallel_scan.h>
+#include <zeno/para/counter_iterator.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace zeno {
+
+// lock-free disjoint sets over 0..n, safe to unite() and find() from many
+// threads at once; the larger root is always linked under the smaller one,
+// so once all unions are done, find(i) is the lowest index in the set of i,
+// whatever order the unions ran in
+struct concurrent_union_find {
+    std::unique_ptr<std::atomic<int>[]> parents;
+    std::size_t count{};
+
+    concurrent_union_find() = default;
+
+    explicit concurrent_union_find(std::size_t n)
+        : parents(std::make_unique<std::atomic<int>[]>(n)), count(n) {
+        parallel_for(n, [&] (std::size_t i) {
+            parents[i].store((int)i, std::memory_order_relaxed);
+        });
+    }
+
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    // root of i, halving the path on the way
+    int find(int i) const noexcept {
+        while (true) {
+            int p = parents[i].load(std::memory_order_relaxed);
+            if (p == i)
+                return i;
+            int gp = parents[p].load(std::memory_order_relaxed);
+            if (gp != p)
+                parents[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+            i = gp;
+        }
+    }
+
+    // returns false if a and b were in the same set already
+    bool unite(int a, int b) noexcept {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return false;
+            if (a > b)
+                std::swap(a, b);
+            int expected = b;
+            if (parents[b].compare_exchange_strong(expected, a, std::memory_order_acq_rel))
+                return true;
+        }
+    }
+
+    // dense set ids, numbered in order of the lowest index of each set, into
+    // out[0..n); returns the number of sets
+    template <class Labels>
+    int labels(Labels &out) const {
+        std::vector<int> rootRank(count);
+        parallel_inclusive_scan_sum(counter_iterator<std::size_t>(0), counter_iterator<std::size_t>(count),
+                                    rootRank.begin(), [&] (std::size_t i) {
+            return int(find((int)i) == (int)i);
+        });
+        parallel_for(count, [&] (std::size_t i) {
+            out[i] = rootRank[find((int)i)] - 1;
+        });
+        return count ? rootRank[count - 1] : 0;
+    }
+};
+
+}
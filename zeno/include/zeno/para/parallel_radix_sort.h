@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace zeno {
+
+// stable lsd radix sort of `keys` with `values` permuted alongside, only the
+// low `numBits` of the keys are looked at; a pass is skipped when all keys
+// share its digit, so narrow keys in a wide type cost no extra passes
+template <class Key, class Value>
+void parallel_radix_sort(std::vector<Key> &keys, std::vector<Value> &values,
+                         int numBits = sizeof(Key) * 8) {
+    static_assert(std::is_unsigned_v<Key>, "radix sort needs unsigned keys");
+    constexpr int digitBits = 11;
+    constexpr size_t numBuckets = size_t(1) << digitBits;
+    const size_t n = keys.size();
+    if (n < 2)
+        return;
+
+    int nthreads = 1;
+#if defined(_OPENMP)
+    nthreads = std::max(1, std::min(omp_get_max_threads(), (int)(n / 16384)));
+#endif
+    std::vector<Key> keysTmp(n);
+    std::vector<Value> valuesTmp(n);
+    std::vector<size_t> offsets(nthreads * numBuckets);
+
+    for (int shift = 0; shift < numBits; shift += digitBits) {
+        auto digit = [shift] (Key k) {
+            return (size_t)(k >> shift) & (numBuckets - 1);
+        };
+        std::fill(offsets.begin(), offsets.end(), 0);
+#pragma omp parallel for num_threads(nthreads)
+        for (int t = 0; t < nthreads; t++) {
+            auto *hist = offsets.data() + t * numBuckets;
+            for (size_t i = n * t / nthreads; i < n * (t + 1) / nthreads; i++)
+                hist[digit(keys[i])]++;
+        }
+
+        // bucket-major, thread-minor, so that each thread scatters its chunk
+        // right after the chunks of lower threads, keeping the sort stable
+        bool trivial = false;
+        size_t base = 0;
+        for (size_t b = 0; b < numBuckets; b++) {
+            size_t count = 0;
+            for (int t = 0; t < nthreads; t++) {
+                auto c = offsets[t * numBuckets + b];
+                offsets[t * numBuckets + b] = base + count;
+                count += c;
+            }
+            trivial |= count == n;
+            base += count;
+        }
+        if (trivial)
+            continue;
+
+#pragma omp parallel for num_threads(nthreads)
+        for (int t = 0; t < nthreads; t++) {
+            auto *offs = offsets.data() + t * numBuckets;
+            for (size_t i = n * t / nthreads; i < n * (t + 1) / nthreads; i++) {
+                auto dst = offs[digit(keys[i])]++;
+                keysTmp[dst] = keys[i];
+                valuesTmp[dst] = values[i];
+            }
+        }
+        keys.swap(keysTmp);
+        values.swap(valuesTmp);
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <zeno/para/parallel_for.h>
+#include <zeno/utils/vec.h>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace zeno {
+
+// floating point to_chars needs libstdc++ 11, older ones fall back to snprintf
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+inline constexpr bool has_float_to_chars = true;
+#else
+inline constexpr bool has_float_to_chars = false;
+#endif
+
+// text built by appending, numbers are formatted by to_chars, so they do not
+// depend on the locale, and floats are the shortest text that reads back to
+// the same value (or, with the fallback, 9 or 17 digits, which read back too)
+struct text_buffer {
+    std::string str;
+
+    text_buffer &operator<<(char c) {
+        str.push_back(c);
+        return *this;
+    }
+
+    text_buffer &operator<<(std::string_view s) {
+        str.append(s);
+        return *this;
+    }
+
+    template <class T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    text_buffer &operator<<(T val) {
+        char buf[32];
+        if constexpr (has_float_to_chars || !std::is_floating_point_v<T>) {
+            auto res = std::to_chars(buf, buf + sizeof(buf), val);
+            str.append(buf, res.ptr);
+        } else {
+            int len = std::snprintf(buf, sizeof(buf), "%.*g",
+                                    std::is_same_v<T, float> ? 9 : 17, (double)val);
+            // the host app may have set a locale with a decimal comma
+            std::replace(buf, buf + len, ',', '.');
+            str.append(buf, len);
+        }
+        return *this;
+    }
+
+    // components separated by `sep`
+    template <size_t N, class T>
+    text_buffer &append(vec<N, T> const &v, char sep = ' ') {
+        *this << v[0];
+        for (size_t i = 1; i < N; i++)
+            *this << sep << v[i];
+        return *this;
+    }
+};
+
+// writes format(buf, i) for i in 0..n to fp, in order: batches of items are
+// formatted concurrently, each into its own buffer, and the buffers of a
+// round of batches are then written out sequentially, so memory stays bounded
+template <class Format>
+bool parallel_text_write(std::FILE *fp, std::size_t n, Format &&format, std::size_t batchSize = 16384) {
+    std::size_t nthreads = 1;
+#if defined(_OPENMP)
+    nthreads = omp_get_max_threads();
+#endif
+    std::size_t nbatches = (n + batchSize - 1) / batchSize;
+    std::size_t roundSize = nthreads * 4;
+    std::vector<text_buffer> bufs(std::min(nbatches, roundSize));
+    for (std::size_t r = 0; r < nbatches; r += roundSize) {
+        std::size_t rn = std::min(roundSize, nbatches - r);
+        parallel_for(rn, [&] (std::size_t b) {
+            auto &buf = bufs[b];
+            buf.str.clear();
+            std::size_t lo = (r + b) * batchSize, hi = std::min(n, lo + batchSize);
+            for (std::size_t i = lo; i < hi; i++)
+                format(buf, i);
+        });
+        for (std::size_t b = 0; b < rn; b++) {
+            auto const &str = bufs[b].str;
+            if (std::fwrite(str.data(), 1, str.size(), fp) != str.size())
+                return false;
+        }
+    }
+    return true;
+}
+
+}
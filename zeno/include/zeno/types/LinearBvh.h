@@ -0,0 +1,157 @@
+#pragma once
+
+#include <zeno/core/IObject.h>
+#include <zeno/types/PrimitiveObject.h>
+#include <zeno/utils/SpatialUtils.h>
+#include <zeno/utils/vec.h>
+#include <zeno/utils/api.h>
+#include <limits>
+
+namespace zeno {
+
+// linear bvh over the points, lines, tris or tets (quads) of a primitive,
+// shared by all nodes doing projection, nearest, ray or containment queries
+struct LBvh : IObjectClone<LBvh> {
+  enum element_e { point = 0, line, tri, tet };
+  template <element_e et>
+  using element_t = std::integral_constant<element_e, et>;
+  template <element_e et> static constexpr element_t<et> element_c{};
+
+  using TV = vec3f;
+  using Box = std::pair<TV, TV>;
+  using Ti = int;
+  using Tu = std::make_unsigned_t<Ti>;
+
+  std::weak_ptr<const PrimitiveObject> primPtr;
+  std::vector<Box> sortedBvs;
+  std::vector<Ti> auxIndices, levels, parents, leafIndices;
+  float thickness{0};
+  element_e eleCategory{element_e::point}; // element category
+
+  /// optional 4- or 8-wide copy of the tree: per node, the child boxes as
+  /// SoA (min x, y, z, max x, y, z, each `wideWidth` floats), and per slot
+  /// the child node, or ~eid for a leaf, and the binary node it came from
+  int wideWidth{0};
+  std::vector<float> wideBvs;
+  std::vector<Ti> wideChildren, wideSources;
+
+  LBvh() noexcept = default;
+  LBvh(const std::shared_ptr<PrimitiveObject> &prim, float thickness = 0.f) {
+    build(prim, thickness);
+  }
+  template <element_e et>
+  LBvh(const std::shared_ptr<PrimitiveObject> &prim, float thickness,
+       element_t<et> t) {
+    build(prim, thickness, t);
+  }
+
+  std::size_t getNumLeaves() const noexcept { return leafIndices.size(); }
+  std::size_t getNumNodes() const noexcept { return getNumLeaves() * 2 - 1; }
+
+  template <element_e et>
+  ZENO_API void build(const std::shared_ptr<PrimitiveObject> &prim, float thickness,
+             element_t<et>);
+  ZENO_API void build(const std::shared_ptr<PrimitiveObject> &prim, float thickness);
+  /// recompute the boxes after the positions moved, keeping the topology
+  template <element_e et> ZENO_API void refit(element_t<et>);
+  ZENO_API void refit();
+
+  /// build the wide tree used by batched queries, kept up to date by later
+  /// builds and refits; width 0 drops it
+  ZENO_API void collapse(int width);
+  ZENO_API void refit_wide();
+
+  static bool intersect(const Box &box, const TV &p) noexcept {
+    constexpr int dim = 3;
+    for (Ti d = 0; d != dim; ++d)
+      if (p[d] < box.first[d] || p[d] > box.second[d])
+        return false;
+    return true;
+  }
+  static float distance(const Box &bv, const TV &x) {
+    const auto &[mi, ma] = bv;
+    TV center = (mi + ma) / 2;
+    TV point = abs(x - center) - (ma - mi) / 2;
+    float max = std::numeric_limits<float>::lowest();
+    for (int d = 0; d != 3; ++d) {
+      if (point[d] > max)
+        max = point[d];
+      if (point[d] < 0)
+        point[d] = 0;
+    }
+    return (max < 0.f ? max : 0.f) + length(point);
+  }
+  static float distance(const TV &x, const Box &bv) { return distance(bv, x); }
+
+  /// closest bounding box
+  template <element_e et>
+  ZENO_API TV find_nearest(TV const &pos, Ti &id, float &dist, element_t<et>) const;
+  ZENO_API TV find_nearest(TV const &pos, Ti &id, float &dist) const;
+
+  /// find_nearest for every point of `pos` in parallel, traversing in morton
+  /// order and on the wide tree if any; outputs are indexed like `pos`, ids
+  /// are floats to be written straight into prim attributes, null ones skipped
+  template <element_e et>
+  ZENO_API void find_nearest_batch(std::vector<TV> const &pos, float *ids,
+                                   float *dists, TV *ws, element_t<et>) const;
+  ZENO_API void find_nearest_batch(std::vector<TV> const &pos, float *ids,
+                                   float *dists, TV *ws) const;
+
+  /// closest point on the primitive, with `id` the element it lies on
+  ZENO_API TV find_closest_point(TV const &pos, Ti &id, float &dist) const;
+
+  /// the triangle hit with the smallest |t| among t in [tmin, tmax], where
+  /// the hit point is ro + t * rd; returns infinity with id = -1 when missed
+  ZENO_API float ray_intersect(TV const &ro, TV const &rd, Ti &id,
+                      float tmin = std::numeric_limits<float>::lowest(),
+                      float tmax = std::numeric_limits<float>::max()) const;
+
+  /// the tet containing `pos` and its barycentric weights, or -1 if none
+  ZENO_API Ti find_containing_tet(TV const &pos, vec4f &bary) const;
+
+  ZENO_API std::shared_ptr<PrimitiveObject> retrievePrimitive(Ti eid) const;
+  ZENO_API vec3f retrievePrimitiveCenter(Ti eid, const TV &w) const;
+
+  /// visit the elements of every leaf whose box passes `pred`, pruning the
+  /// subtrees whose box fails it; `pred` may narrow down during traversal
+  template <class Pred, class F> void traverse(Pred &&pred, F &&f) const {
+    if (auto numLeaves = getNumLeaves(); numLeaves <= 2) {
+      for (Ti i = 0; i != numLeaves; ++i) {
+        if (pred(sortedBvs[i]))
+          f(auxIndices[i]);
+      }
+      return;
+    }
+    const Ti numNodes = sortedBvs.size();
+    Ti node = 0;
+    while (node != -1 && node != numNodes) {
+      Ti level = levels[node];
+      // level and node are always in sync
+      for (; level; --level, ++node)
+        if (!pred(sortedBvs[node]))
+          break;
+      // leaf node check
+      if (level == 0) {
+        if (pred(sortedBvs[node]))
+          f(auxIndices[node]);
+        node++;
+      } else // separate at internal nodes
+        node = auxIndices[node];
+    }
+  }
+
+  /// elements whose box (inflated by thickness) contains `pos`
+  template <class F> void iter_neighbors(TV const &pos, F &&f) const {
+    traverse([&](Box const &bv) { return intersect(bv, pos); },
+             std::forward<F>(f));
+  }
+
+  /// elements whose box is within `radius` of `pos`, the caller is
+  /// responsible for the exact per-element test
+  template <class F> void iter_radius(TV const &pos, float radius, F &&f) const {
+    traverse([&](Box const &bv) { return distance(bv, pos) <= radius; },
+             std::forward<F>(f));
+  }
+};
+
+} // namespace zeno
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+
+namespace zeno {
+
+// acceleration structures derived from a primitive (bvh, adjacency, hash
+// grids...), kept on it so later nodes, and later frames of an unchanged
+// input, reuse them; each entry stores the version of the parts it was built
+// from, see primVersion, and is rebuilt once that changes. copies of the
+// primitive start with an empty cache, as entries may refer to their owner
+struct PrimitiveCache {
+    enum Deps : unsigned {
+        pos = 1,
+        points = 2,
+        lines = 4,
+        tris = 8,
+        quads = 16,
+        polys = 32, // loops and polys
+        topology = points | lines | tris | quads | polys,
+    };
+
+    struct Entry {
+        std::shared_ptr<void> data;
+        std::uint64_t version{};
+        std::type_index type{typeid(void)};
+    };
+
+    std::mutex mtx;
+    std::map<std::string, Entry> entries;
+
+    PrimitiveCache() = default;
+    PrimitiveCache(PrimitiveCache const &) {}
+    PrimitiveCache(PrimitiveCache &&) {}
+    PrimitiveCache &operator=(PrimitiveCache const &) { clear(); return *this; }
+    PrimitiveCache &operator=(PrimitiveCache &&) { clear(); return *this; }
+
+    void clear() {
+        std::lock_guard lck(mtx);
+        entries.clear();
+    }
+
+    // the entry `kind` if it was built at `version`, otherwise build() it;
+    // the lock is not held while building, so concurrent misses may both
+    // build, and the last one to finish is kept
+    template <class T, class F>
+    std::shared_ptr<T> get(std::string const &kind, std::uint64_t version, F &&build) {
+        {
+            std::lock_guard lck(mtx);
+            if (auto it = entries.find(kind); it != entries.end()
+                && it->second.version == version && it->second.type == typeid(T))
+                return std::static_pointer_cast<T>(it->second.data);
+        }
+        std::shared_ptr<T> data = build();
+        {
+            std::lock_guard lck(mtx);
+            entries[kind] = Entry{data, version, typeid(T)};
+        }
+        return data;
+    }
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include <zeno/core/IObject.h>
 #include <zeno/types/AttrVector.h>
+#include <zeno/types/PrimitiveCache.h>
 #include <zeno/utils/type_traits.h>
 #include <zeno/utils/vec.h>
 #include <optional>
@@ -33,6 +34,8 @@ struct PrimitiveObject : IObjectClone<PrimitiveObject> {
     std::shared_ptr<MaterialObject> mtl;
     std::shared_ptr<InstancingObject> inst;
 
+    mutable PrimitiveCache cache;
+
     // deprecated:
     template <class Accept = std::variant<vec3f, float>, class F>
     void foreach_attr(F &&f) {
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <zeno/types/PrimitiveObject.h>
+#include <zeno/utils/vec.h>
+#include <zeno/utils/api.h>
+#include <vector>
+
+namespace zeno {
+
+// connectivity of a primitive as flat CSR tables, shared by the mesh nodes
+// instead of each deriving its own adjacency from tris/quads/polys.
+//
+// faces are numbered tris first, then quads, then polys, so face f is the
+// poly f - polyBase(); the corners of face f are faceVerts[faceOffsets[f]
+// .. faceOffsets[f + 1]). every corner c is also the half-edge leaving
+// faceVerts[c] towards the next corner of its face; the lines follow as
+// half-edges without a face, so halfedges[numCorners() + i] is lines[i]
+struct PrimitiveTopology {
+    int numVerts{0};
+    int numTris{0}, numQuads{0}, numPolys{0};
+
+    std::vector<int> faceOffsets;     // numFaces() + 1
+    std::vector<int> faceVerts;       // numCorners()
+
+    std::vector<vec2i> halfedges;     // (from, to)
+    std::vector<int> heFace;          // -1 for lines
+    std::vector<int> heTwin;          // the other face half-edge of a two-faced edge, else -1
+    std::vector<int> heEdge;          // -1 for degenerate (from == to) half-edges
+
+    // unique undirected edges sorted by (min, max) vertex, each oriented like
+    // its first half-edge, with the half-edges on it in increasing order
+    std::vector<vec2i> edges;
+    std::vector<int> edgeOffsets;     // edges.size() + 1
+    std::vector<int> edgeHalfedges;
+
+    // faces around each vertex in increasing order, a face appearing once
+    // per corner it has there, and those corners
+    std::vector<int> vertFaceOffsets; // numVerts + 1
+    std::vector<int> vertFaces;
+    std::vector<int> vertCorners;
+
+    // neighbouring vertices along edges (or lines), sorted ascending
+    std::vector<int> vertVertOffsets; // numVerts + 1
+    std::vector<int> vertVerts;
+
+    PrimitiveTopology() = default;
+    explicit PrimitiveTopology(PrimitiveObject const *prim) {
+        build(prim);
+    }
+
+    ZENO_API void build(PrimitiveObject const *prim);
+
+    int numFaces() const noexcept { return numTris + numQuads + numPolys; }
+    int numCorners() const noexcept { return (int)faceVerts.size(); }
+    int polyBase() const noexcept { return numTris + numQuads; }
+    int faceSize(int f) const noexcept { return faceOffsets[f + 1] - faceOffsets[f]; }
+
+    int heNext(int he) const noexcept {
+        int f = heFace[he];
+        if (f < 0) return -1;
+        return he + 1 == faceOffsets[f + 1] ? faceOffsets[f] : he + 1;
+    }
+    int hePrev(int he) const noexcept {
+        int f = heFace[he];
+        if (f < 0) return -1;
+        return he == faceOffsets[f] ? faceOffsets[f + 1] - 1 : he - 1;
+    }
+
+    // number of half-edges (face sides and lines) on edge e
+    int edgeValence(int e) const noexcept { return edgeOffsets[e + 1] - edgeOffsets[e]; }
+    int vertValence(int v) const noexcept { return vertVertOffsets[v + 1] - vertVertOffsets[v]; }
+
+    // the edge joining a and b, or -1 if there is none
+    ZENO_API int findEdge(int a, int b) const;
+};
+
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <zeno/utils/vec.h>
+#include <algorithm>
+#include <limits>
+#include <utility>
 
 namespace zeno {
 
@@ -199,4 +202,65 @@ inline auto dist_pt(const vec3f &p, const vec3f &t0, const vec3f &t1,
   return std::sqrt(dist_pt_sqr(p, t0, t1, t2, ws));
 }
 
-} // namespace zeno
\ No newline at end of file
+//! ray-triangle, signed distance along rd, or infinity when missed
+// ref: Fast, Minimum Storage Ray/Triangle Intersection, Moller & Trumbore, 1997
+inline float ray_tri_intersect(const vec3f &ro, const vec3f &rd, const vec3f &t0,
+                               const vec3f &t1, const vec3f &t2) noexcept {
+  constexpr float eps = 1e-6f;
+  vec3f e1 = t1 - t0;
+  vec3f e2 = t2 - t0;
+  vec3f p = cross(rd, e2);
+  float det = dot(e1, p);
+  if (std::abs(det) <= eps * std::sqrt(lengthSquared(e1) * lengthSquared(e2)))
+    return std::numeric_limits<float>::infinity();
+  float inv = 1 / det;
+  vec3f s = ro - t0;
+  float u = dot(s, p) * inv;
+  if (u < -eps || u > 1 + eps)
+    return std::numeric_limits<float>::infinity();
+  vec3f q = cross(s, e1);
+  float v = dot(rd, q) * inv;
+  if (v < -eps || u + v > 1 + eps * 2)
+    return std::numeric_limits<float>::infinity();
+  return dot(e2, q) * inv;
+}
+
+//! ray-box, whether the segment ro + t * rd, t in [tmin, tmax] hits the box
+// ref: An Efficient and Robust Ray-Box Intersection Algorithm, 2005
+inline bool ray_box_intersect(const vec3f &ro, const vec3f &rd,
+                              const std::pair<vec3f, vec3f> &box, float tmin,
+                              float tmax) noexcept {
+  for (int d = 0; d != 3; ++d) {
+    if (rd[d] == 0) {
+      if (ro[d] < box.first[d] || ro[d] > box.second[d])
+        return false;
+      continue;
+    }
+    float invd = 1 / rd[d];
+    float t0 = (box.first[d] - ro[d]) * invd;
+    float t1 = (box.second[d] - ro[d]) * invd;
+    if (invd < 0)
+      std::swap(t0, t1);
+    tmin = std::max(tmin, t0);
+    tmax = std::min(tmax, t1);
+    if (tmin > tmax)
+      return false;
+  }
+  return true;
+}
+
+//! point-tetrahedron, barycentric weights of p, all in [0, 1] when inside
+inline vec4f bary_tet(const vec3f &p, const vec3f &t0, const vec3f &t1,
+                      const vec3f &t2, const vec3f &t3) noexcept {
+  auto vol = [](vec3d const &a, vec3d const &b, vec3d const &c, vec3d const &d) {
+    return dot(b - a, cross(c - a, d - a));
+  };
+  vec3d x{p}, a{t0}, b{t1}, c{t2}, d{t3};
+  double v = vol(a, b, c, d);
+  if (v == 0)
+    return vec4f(-1);
+  return vec4f(vol(x, b, c, d) / v, vol(a, x, c, d) / v, vol(a, b, x, d) / v,
+               vol(a, b, c, x) / v);
+}
+
+} // namespace zeno
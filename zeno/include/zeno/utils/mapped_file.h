@@ -0,0 +1,31 @@
+#pragma once
+
+#include <zeno/utils/api.h>
+#include <cstddef>
+#include <string>
+
+namespace zeno {
+
+// read-only view of a whole file, memory-mapped so large inputs are paged in
+// on demand instead of copied into a buffer first; a file that cannot be
+// opened (or an empty one) gives an empty view, like file_get_binary
+class mapped_file {
+    char const *m_data{};
+    std::size_t m_size{};
+    void *m_handle{};
+
+public:
+    mapped_file() = default;
+    ZENO_API explicit mapped_file(std::string const &path);
+    ZENO_API ~mapped_file();
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+
+    char const *data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+    char const *begin() const noexcept { return m_data; }
+    char const *end() const noexcept { return m_data + m_size; }
+};
+
+}
@@ -2,8 +2,10 @@
 #include <zeno/extra/GlobalState.h>
 #include <zeno/funcs/ObjectCodec.h>
 #include <zeno/utils/log.h>
+#include <zeno/utils/mapped_file.h>
 #include <filesystem>
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 
 namespace zeno {
@@ -25,11 +27,12 @@ static void toDisk(std::string cachedir, int frameid, GlobalComm::ViewObjects &o
 
     auto path = std::filesystem::path(cachedir) / (std::to_string(1000000 + frameid).substr(1) + ".zencache");
     log_critical("dump cache to disk {}", path);
-    std::ofstream ofs(path);
-    std::ostreambuf_iterator<char> oit(ofs);
-    std::copy(keys.begin(), keys.end(), oit);
-    std::copy_n((const char *)poses.data(), poses.size() * sizeof(size_t), oit);
-    std::copy(buf.begin(), buf.end(), oit);
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(keys.data(), keys.size());
+    ofs.write((const char *)poses.data(), poses.size() * sizeof(size_t));
+    ofs.write(buf.data(), buf.size());
+    if (!ofs)
+        log_error("failed to write cache file {}", path);
     objs.clear();
 }
 
@@ -38,10 +41,7 @@ static void fromDisk(std::string cachedir, int frameid, GlobalComm::ViewObjects
     objs.clear();
     auto path = std::filesystem::path(cachedir) / (std::to_string(1000000 + frameid).substr(1) + ".zencache");
     log_critical("load cache from disk {}", path);
-    std::ifstream ifs(path);
-    std::istreambuf_iterator<char> iit(ifs), iite;
-    std::vector<char> dat;
-    std::copy(iit, iite, std::back_inserter(dat));
+    mapped_file dat(path.string());
 
     if (dat.size() <= 8 || std::string(dat.data(), 8) != "ZENCACHE") {
         log_error("zeno cache file broken (1)");
@@ -65,11 +65,15 @@ static void fromDisk(std::string cachedir, int frameid, GlobalComm::ViewObjects
         pos = newpos + 1;
     }
 
+    if (keyscount < 0 || (keyscount + 1) * sizeof(size_t) > dat.size() - pos) {
+        log_error("zeno cache file broken (5)");
+        return;
+    }
     std::vector<size_t> poses(keyscount + 1);
-    std::copy_n(dat.data() + pos, (keyscount + 1) * sizeof(size_t), (char *)poses.data());
+    std::memcpy(poses.data(), dat.data() + pos, (keyscount + 1) * sizeof(size_t));
     pos += (keyscount + 1) * sizeof(size_t);
     for (int k = 0; k < keyscount; k++) {
-        if (poses[k] > dat.size() - pos || poses[k + 1] < poses[k]) {
+        if (poses[k + 1] > dat.size() - pos || poses[k + 1] < poses[k]) {
             log_error("zeno cache file broken (4.{})", k);
             return;
         }
@@ -9,8 +9,10 @@
 #include <zeno/types/ListObject.h>
 #include <zeno/utils/cppdemangle.h>
 #include <zeno/types/UserData.h>
+#include <zeno/funcs/PrimitiveIO.h>
 #include <zeno/utils/log.h>
 #include <algorithm>
+#include <map>
 #include <cstring>
 
 namespace zeno {
@@ -20,6 +22,7 @@ namespace {
 #define _PER_OBJECT_TYPE(TypeName, ...) TypeName,
 enum class ObjectType : int32_t {
     ZENO_XMACRO_IObject(_PER_OBJECT_TYPE)
+    Extension,
 };
 #undef _PER_OBJECT_TYPE
 
@@ -32,6 +35,23 @@ struct ObjectHeader {
     size_t beginUserData;
 };
 
+// after the header, an extension object has the name of its codec (after
+// the length of it), the size of its data, then the data
+struct ExtensionCodec {
+    ObjectEncoder encode;
+    ObjectDecoder decode;
+};
+
+std::map<std::string, ExtensionCodec> &extensionCodecs() {
+    static std::map<std::string, ExtensionCodec> codecs;
+    return codecs;
+}
+
+}
+
+ZENO_API int registerObjectCodec(std::string const &name, ObjectEncoder encode, ObjectDecoder decode) {
+    extensionCodecs().insert_or_assign(name, ExtensionCodec{std::move(encode), std::move(decode)});
+    return 1;
 }
 
 namespace _implObjectCodec {
@@ -39,7 +59,7 @@ namespace _implObjectCodec {
 
 #define _PER_OBJECT_TYPE(TypeName, ...) \
 std::shared_ptr<TypeName> decode##TypeName(const char *it); \
-bool encode##TypeName(TypeName const *obj, std::back_insert_iterator<std::vector<char>> it);
+bool encode##TypeName(TypeName const *obj, std::vector<char> &buf);
 ZENO_XMACRO_IObject(_PER_OBJECT_TYPE)
 #undef _PER_OBJECT_TYPE
 
@@ -63,6 +83,35 @@ static std::shared_ptr<IObject> _decodeObjectImpl(const char *buf, size_t len) {
 ZENO_XMACRO_IObject(_PER_OBJECT_TYPE)
 #undef _PER_OBJECT_TYPE
 
+    } else if (header.type == ObjectType::Extension) {
+        size_t left = len - sizeof(ObjectHeader);
+        size_t namelen, size;
+        if (left < sizeof(namelen)) {
+            log_error("extension object header broken");
+            return nullptr;
+        }
+        std::memcpy(&namelen, it, sizeof(namelen));
+        it += sizeof(namelen);
+        left -= sizeof(namelen);
+        if (left < sizeof(size) || left - sizeof(size) < namelen) {
+            log_error("extension object header broken");
+            return nullptr;
+        }
+        std::string name{it, namelen};
+        it += namelen;
+        std::memcpy(&size, it, sizeof(size));
+        it += sizeof(size);
+        left -= namelen + sizeof(size);
+        if (left < size) {
+            log_error("extension object `{}` data broken", name);
+            return nullptr;
+        }
+        auto codec = extensionCodecs().find(name);
+        if (codec == extensionCodecs().end()) {
+            log_error("no codec for extension object `{}`", name);
+            return nullptr;
+        }
+        return codec->second.decode(it, size);
     } else {
         log_error("invalid object header type {}", (int)header.type);
         return nullptr;
@@ -70,6 +119,10 @@ ZENO_XMACRO_IObject(_PER_OBJECT_TYPE)
 }
 
 std::shared_ptr<IObject> decodeObject(const char *buf, size_t len) {
+    if (len < sizeof(ObjectHeader)) {
+        log_error("data too short, giving up");
+        return nullptr;
+    }
     auto &header = *(ObjectHeader *)buf;
     if (header.magicNumber != ObjectHeader::kMagicNumber) {
         log_error("object header magic number mismatch");
@@ -77,6 +130,8 @@ std::shared_ptr<IObject> decodeObject(const char *buf, size_t len) {
     }
 
     auto object = _decodeObjectImpl(buf, len);
+    if (!object)
+        return nullptr;
 
     auto ptr = buf + header.beginUserData;
     for (int i = 0; i < header.numUserData; i++) {
@@ -101,7 +156,6 @@ std::shared_ptr<IObject> decodeObject(const char *buf, size_t len) {
 }
 
 static bool _encodeObjectImpl(IObject const *object, std::vector<char> &buf) {
-    auto it = std::back_inserter(buf);
     ObjectHeader header;
     header.magicNumber = ObjectHeader::kMagicNumber;
 
@@ -110,39 +164,79 @@ static bool _encodeObjectImpl(IObject const *object, std::vector<char> &buf) {
 #define _PER_OBJECT_TYPE(TypeName, ...) \
     } else if (auto obj = dynamic_cast<TypeName const *>(object)) { \
         header.type = ObjectType::TypeName; \
-        it = std::copy_n((char *)&header, sizeof(ObjectHeader), it); \
-        return encode##TypeName(obj, it);
+        buf.insert(buf.end(), (char const *)&header, (char const *)(&header + 1)); \
+        return encode##TypeName(obj, buf);
 ZENO_XMACRO_IObject(_PER_OBJECT_TYPE)
 #undef _PER_OBJECT_TYPE
 
     } else {
+        header.type = ObjectType::Extension;
+        auto oldsize = buf.size();
+        for (auto const &[name, codec]: extensionCodecs()) {
+            size_t namelen = name.size();
+            buf.insert(buf.end(), (char const *)&header, (char const *)(&header + 1));
+            buf.insert(buf.end(), (char const *)&namelen, (char const *)(&namelen + 1));
+            buf.insert(buf.end(), name.begin(), name.end());
+            auto sizepos = buf.size();
+            buf.resize(sizepos + sizeof(size_t));
+            if (codec.encode(object, buf)) {
+                size_t size = buf.size() - sizepos - sizeof(size_t);
+                std::memcpy(buf.data() + sizepos, &size, sizeof(size));
+                return true;
+            }
+            buf.resize(oldsize);
+        }
         log_error("invalid object type to encode `{}`", cppdemangle(typeid(*object)));
         return false;
     }
 }
 
+// upper bound of the encoded size, exact for the bulk of primitive data
+static size_t _encodedSizeHint(IObject const *object) {
+    size_t size = sizeof(ObjectHeader) + 256;
+    if (auto prim = dynamic_cast<PrimitiveObject const *>(object)) {
+        size += zpmsize(prim);
+    } else if (auto lst = dynamic_cast<ListObject const *>(object)) {
+        for (auto const &elm: lst->arr)
+            size += 2 * sizeof(size_t) + _encodedSizeHint(elm.get());
+    }
+    for (auto const &[key, val]: object->userData())
+        size += 2 * sizeof(size_t) + key.size() + _encodedSizeHint(val.get());
+    return size;
+}
+
+// the buffer is grown once for the whole object, then everything is appended
+// to it in place, so the payloads keep the alignment they were encoded with,
+// relative to the start of `buf`
 bool encodeObject(IObject const *object, std::vector<char> &buf) {
     auto oldsize = buf.size();
-    if (!_encodeObjectImpl(object, buf))
+    auto need = oldsize + _encodedSizeHint(object);
+    if (need > buf.capacity())
+        buf.reserve(std::max(need, buf.capacity() * 2));
+    if (!_encodeObjectImpl(object, buf)) {
+        buf.resize(oldsize);
         return false;
+    }
 
-    std::vector<std::vector<char>> valbufs;
+    size_t numUserData = 0;
+    size_t beginUserData = buf.size() - oldsize;
     for (auto const &[key, val]: object->userData()) {
-        std::vector<char> valbuf;
+        size_t valpos = buf.size();
         size_t keysize = key.size();
-        valbuf.insert(valbuf.end(), (char *)&keysize, (char *)(&keysize + 1));
-        valbuf.insert(valbuf.end(), key.begin(), key.end());
-        if (encodeObject(val.get(), valbuf))
-            valbufs.push_back(std::move(valbuf));
+        buf.resize(valpos + sizeof(size_t));
+        buf.insert(buf.end(), (char *)&keysize, (char *)(&keysize + 1));
+        buf.insert(buf.end(), key.begin(), key.end());
+        if (!encodeObject(val.get(), buf)) {
+            buf.resize(valpos);
+            continue;
+        }
+        size_t valbufsize = buf.size() - valpos - sizeof(size_t);
+        std::memcpy(buf.data() + valpos, &valbufsize, sizeof(valbufsize));
+        numUserData++;
     }
     auto &header = *(ObjectHeader *)(buf.data() + oldsize);
-    header.numUserData = valbufs.size();
-    header.beginUserData = buf.size() - oldsize;
-    for (auto const &valbuf: valbufs) {
-        size_t valbufsize = valbuf.size();
-        buf.insert(buf.end(), (char *)&valbufsize, (char *)(&valbufsize + 1));
-        buf.insert(buf.end(), valbuf.begin(), valbuf.end());
-    }
+    header.numUserData = numUserData;
+    header.beginUserData = beginUserData;
     return true;
 }
 
@@ -16,9 +16,10 @@ std::shared_ptr<CameraObject> decodeCameraObject(const char *it) {
     return obj;
 }
 
-bool encodeCameraObject(CameraObject const *obj, std::back_insert_iterator<std::vector<char>> it);
-bool encodeCameraObject(CameraObject const *obj, std::back_insert_iterator<std::vector<char>> it) {
-    it = std::copy_n((char const *)static_cast<CameraData const *>(obj), sizeof(CameraData), it);
+bool encodeCameraObject(CameraObject const *obj, std::vector<char> &buf);
+bool encodeCameraObject(CameraObject const *obj, std::vector<char> &buf) {
+    auto data = (char const *)static_cast<CameraData const *>(obj);
+    buf.insert(buf.end(), data, data + sizeof(CameraData));
     return true;
 }
 
@@ -29,9 +30,10 @@ std::shared_ptr<LightObject> decodeLightObject(const char *it) {
     return obj;
 }
 
-bool encodeLightObject(LightObject const *obj, std::back_insert_iterator<std::vector<char>> it);
-bool encodeLightObject(LightObject const *obj, std::back_insert_iterator<std::vector<char>> it) {
-    it = std::copy_n((char const *)static_cast<LightData const *>(obj), sizeof(LightData), it);
+bool encodeLightObject(LightObject const *obj, std::vector<char> &buf);
+bool encodeLightObject(LightObject const *obj, std::vector<char> &buf) {
+    auto data = (char const *)static_cast<LightData const *>(obj);
+    buf.insert(buf.end(), data, data + sizeof(LightData));
     return true;
 }
 
@@ -29,28 +29,25 @@ std::shared_ptr<ListObject> decodeListObject(const char *it) {
     return obj;
 }
 
-bool encodeListObject(ListObject const *obj, std::back_insert_iterator<std::vector<char>> it);
-bool encodeListObject(ListObject const *obj, std::back_insert_iterator<std::vector<char>> it) {
+bool encodeListObject(ListObject const *obj, std::vector<char> &buf);
+bool encodeListObject(ListObject const *obj, std::vector<char> &buf) {
     size_t size = obj->arr.size();
-    std::copy_n((char const *)&size, sizeof(size), it);
+    buf.insert(buf.end(), (char const *)&size, (char const *)(&size + 1));
 
-    std::vector<char> buf;
-    std::vector<char> fin;
+    // the elements are encoded right after the table, which is filled last
     std::vector<size_t> tab(size * 2);
-    size_t base = 0;
+    size_t tabpos = buf.size();
+    buf.resize(tabpos + sizeof(size_t) * tab.size());
+    size_t base = buf.size();
     for (size_t i = 0; i < size; i++) {
         auto const *elm = obj->arr[i].get();
+        size_t pos = buf.size();
         if (!encodeObject(elm, buf))
             return false;
-        size_t len = buf.size();
-        fin.insert(fin.end(), buf.begin(), buf.end());
-        buf.clear();
-        tab[i * 2] = base;
-        tab[i * 2 + 1] = len;
-        base += len;
+        tab[i * 2] = pos - base;
+        tab[i * 2 + 1] = buf.size() - pos;
     }
-    std::copy_n(tab.data(), tab.size() * sizeof(size_t), it);
-    std::copy(fin.begin(), fin.end(), it);
+    std::memcpy(buf.data() + tabpos, tab.data(), sizeof(size_t) * tab.size());
 
     return true;
 }
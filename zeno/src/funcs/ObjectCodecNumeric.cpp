@@ -27,13 +27,13 @@ std::shared_ptr<NumericObject> decodeNumericObject(const char *it) {
     return succ ? obj : nullptr;
 }
 
-bool encodeNumericObject(NumericObject const *obj, std::back_insert_iterator<std::vector<char>> it);
-bool encodeNumericObject(NumericObject const *obj, std::back_insert_iterator<std::vector<char>> it) {
+bool encodeNumericObject(NumericObject const *obj, std::vector<char> &buf);
+bool encodeNumericObject(NumericObject const *obj, std::vector<char> &buf) {
     size_t index = obj->value.index();
-    it = std::copy_n((char const *)&index, sizeof(index), it);
+    buf.insert(buf.end(), (char const *)&index, (char const *)(&index + 1));
     std::visit([&] (auto const &val) {
         using T = std::decay_t<decltype(val)>;
-        it = std::copy_n((char const *)&val, sizeof(val), it);
+        buf.insert(buf.end(), (char const *)&val, (char const *)(&val + 1));
     }, obj->value);
     return true;
 }
@@ -47,12 +47,12 @@ std::shared_ptr<StringObject> decodeStringObject(const char *it) {
     return obj;
 }
 
-bool encodeStringObject(StringObject const *obj, std::back_insert_iterator<std::vector<char>> it);
-bool encodeStringObject(StringObject const *obj, std::back_insert_iterator<std::vector<char>> it) {
+bool encodeStringObject(StringObject const *obj, std::vector<char> &buf);
+bool encodeStringObject(StringObject const *obj, std::vector<char> &buf) {
     size_t size = obj->value.size();
     char const *data = obj->value.data();
-    it = std::copy_n((char const *)&size, sizeof(size), it);
-    it = std::copy_n(data, size, it);
+    buf.insert(buf.end(), (char const *)&size, (char const *)(&size + 1));
+    buf.insert(buf.end(), data, data + size);
     return true;
 }
 
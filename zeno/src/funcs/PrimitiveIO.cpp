@@ -0,0 +1,537 @@
+#include <zeno/funcs/PrimitiveIO.h>
+#include <zeno/types/MaterialObject.h>
+#include <zeno/para/parallel_for.h>
+#include <zeno/utils/variantswitch.h>
+#include <zeno/utils/mapped_file.h>
+#include <zeno/utils/log.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+namespace zeno {
+
+namespace {
+
+constexpr char kMagic[] = "\x7fZPMv002";
+constexpr char kMagicV001[] = "\x7fZPMv001";
+constexpr char kIndexMagic[] = "ZPMINDEX";
+constexpr std::size_t kAlign = 64;
+constexpr std::size_t kChunkBytes = std::size_t(1) << 22;
+constexpr std::uint8_t kMtlGroup = 255;
+constexpr std::uint8_t kBytesType = 255;
+
+enum Codec : std::uint8_t {
+    kRaw = 0,
+    kShuffleRLE = 1,
+};
+
+struct ChunkEntry {
+    std::uint64_t offset{};
+    std::uint64_t storedSize{};
+    std::uint8_t codec{kRaw};
+};
+
+struct ColumnEntry {
+    std::uint8_t group{};
+    std::uint8_t type{};
+    std::string name;              // empty for the values of a group
+    std::uint64_t count{};         // number of elements
+    std::uint32_t elemSize{};
+    std::uint32_t chunkElems{};    // elements per chunk, the last may be short
+    std::vector<ChunkEntry> chunks;
+};
+
+// calls f(group, arr) for each AttrVector of the primitive, in a fixed order
+template <class Prim, class F>
+void foreach_group(Prim *prim, F &&f) {
+    f(0, prim->verts);
+    f(1, prim->points);
+    f(2, prim->lines);
+    f(3, prim->tris);
+    f(4, prim->quads);
+    f(5, prim->loops);
+    f(6, prim->polys);
+    f(7, prim->edges);
+    f(8, prim->uvs);
+    f(9, prim->loop_uvs);
+}
+
+// all element types are made of 4-byte scalars: their bytes are split into 4
+// planes, so the high bytes of nearby values (exponents, index prefixes)
+// line up, then runs are coded as a count byte c, which is followed by c + 1
+// literal bytes if c < 128, and by one byte repeated c - 125 times otherwise
+std::vector<char> pack_shuffle_rle(char const *src, std::size_t size) {
+    std::size_t m = size / 4;
+    std::vector<unsigned char> planes(size);
+    for (std::size_t i = 0; i < m; i++)
+        for (int p = 0; p < 4; p++)
+            planes[p * m + i] = src[i * 4 + p];
+
+    std::vector<char> out;
+    out.reserve(size / 2);
+    std::size_t i = 0, lit = 0;
+    auto flush_literal = [&] (std::size_t end) {
+        while (lit < end) {
+            std::size_t n = std::min<std::size_t>(end - lit, 128);
+            out.push_back(char(n - 1));
+            out.insert(out.end(), planes.begin() + lit, planes.begin() + lit + n);
+            lit += n;
+        }
+    };
+    while (i < size) {
+        std::size_t j = i + 1;
+        while (j < size && j - i < 130 && planes[j] == planes[i])
+            ++j;
+        if (j - i >= 3) {
+            flush_literal(i);
+            out.push_back(char(j - i + 125));
+            out.push_back(char(planes[i]));
+            lit = i = j;
+        } else {
+            i = j;
+        }
+    }
+    flush_literal(size);
+    return out;
+}
+
+bool unpack_shuffle_rle(char const *src, std::size_t srcSize, char *dst, std::size_t size) {
+    std::vector<unsigned char> planes(size);
+    std::size_t i = 0, o = 0;
+    while (i < srcSize) {
+        unsigned c = (unsigned char)src[i++];
+        if (c < 128) {
+            std::size_t n = c + 1;
+            if (i + n > srcSize || o + n > size)
+                return false;
+            std::memcpy(planes.data() + o, src + i, n);
+            i += n;
+            o += n;
+        } else {
+            std::size_t n = c - 125;
+            if (i >= srcSize || o + n > size)
+                return false;
+            std::memset(planes.data() + o, (unsigned char)src[i++], n);
+            o += n;
+        }
+    }
+    if (o != size)
+        return false;
+    std::size_t m = size / 4;
+    for (std::size_t i = 0; i < m; i++)
+        for (int p = 0; p < 4; p++)
+            dst[i * 4 + p] = planes[p * m + i];
+    return true;
+}
+
+std::size_t align_up(std::size_t n) {
+    return (n + kAlign - 1) & ~(kAlign - 1);
+}
+
+template <class T>
+void put(std::vector<char> &buf, T const &val) {
+    buf.insert(buf.end(), (char const *)&val, (char const *)(&val + 1));
+}
+
+// what a primitive is written as: the columns with their chunks laid out,
+// pointing into the primitive or into packed copies, and the index after them
+struct ZpmLayout {
+    struct Block {
+        char const *src;
+        std::size_t size;
+        std::vector<char> packed;
+    };
+
+    std::vector<ColumnEntry> columns;
+    std::vector<Block> blocks;     // in column then chunk order
+    std::vector<char> mtl;
+    std::vector<char> index;
+    std::size_t indexOffset{};
+
+    ZpmLayout(PrimitiveObject const *prim, bool compress) {
+        auto add_column = [&] (std::uint8_t group, std::uint8_t type, std::string const &name,
+                               char const *data, std::size_t count, std::size_t elemSize) {
+            auto &col = columns.emplace_back();
+            col.group = group;
+            col.type = type;
+            col.name = name;
+            col.count = count;
+            col.elemSize = (std::uint32_t)elemSize;
+            col.chunkElems = (std::uint32_t)std::max<std::size_t>(1, kChunkBytes / elemSize);
+            for (std::size_t i = 0; i < count; i += col.chunkElems) {
+                std::size_t n = std::min<std::size_t>(col.chunkElems, count - i);
+                blocks.push_back({data + i * elemSize, n * elemSize, {}});
+                col.chunks.emplace_back();
+            }
+        };
+        foreach_group(prim, [&] (std::uint8_t group, auto const &avec) {
+            avec.template forall_attr<AttrAcceptAll>([&] (auto const &key, auto const &arr) {
+                using T = std::decay_t<decltype(arr[0])>;
+                bool isValues = (void const *)&arr == (void const *)&avec.values;
+                add_column(group, (std::uint8_t)variant_index<AttrAcceptAll, T>::value,
+                           isValues ? std::string() : key, (char const *)arr.data(), arr.size(), sizeof(T));
+            });
+        });
+        if (prim->mtl) {
+            mtl = prim->mtl->serialize();
+            add_column(kMtlGroup, kBytesType, "mtl", mtl.data(), mtl.size(), 1);
+        }
+
+        if (compress) {
+            parallel_for(blocks.size(), [&] (std::size_t b) {
+                auto &blk = blocks[b];
+                if (blk.size < 256 || blk.size % 4)
+                    return;
+                auto packed = pack_shuffle_rle(blk.src, blk.size);
+                if (packed.size() < blk.size - blk.size / 8)
+                    blk.packed = std::move(packed);
+            });
+        }
+
+        std::size_t offset = align_up(sizeof(kMagic) - 1);
+        std::size_t b = 0;
+        for (auto &col: columns) {
+            for (auto &chunk: col.chunks) {
+                auto &blk = blocks[b++];
+                chunk.offset = offset;
+                chunk.codec = blk.packed.empty() ? kRaw : kShuffleRLE;
+                chunk.storedSize = blk.packed.empty() ? blk.size : blk.packed.size();
+                offset = align_up(offset + chunk.storedSize);
+            }
+        }
+        indexOffset = offset;
+
+        put(index, (std::uint32_t)columns.size());
+        for (auto const &col: columns) {
+            put(index, col.group);
+            put(index, col.type);
+            put(index, (std::uint16_t)col.name.size());
+            index.insert(index.end(), col.name.begin(), col.name.end());
+            put(index, col.count);
+            put(index, col.elemSize);
+            put(index, col.chunkElems);
+            for (auto const &chunk: col.chunks) {
+                put(index, chunk.offset);
+                put(index, chunk.storedSize);
+                put(index, chunk.codec);
+            }
+        }
+        std::uint64_t indexSize = index.size();
+        put(index, (std::uint64_t)indexOffset);
+        put(index, indexSize);
+        index.insert(index.end(), kIndexMagic, kIndexMagic + 8);
+    }
+
+    std::size_t totalSize() const {
+        return indexOffset + index.size();
+    }
+
+    char const *block_data(Block const &blk) const {
+        return blk.packed.empty() ? blk.src : blk.packed.data();
+    }
+};
+
+template <class T>
+bool take(char const *&it, char const *end, T &val) {
+    if ((std::size_t)(end - it) < sizeof(T))
+        return false;
+    std::memcpy(&val, it, sizeof(T));
+    it += sizeof(T);
+    return true;
+}
+
+// the file ends with the index, its offset and size, and kIndexMagic
+bool parse_index(char const *data, std::size_t size, std::vector<ColumnEntry> &columns) {
+    constexpr std::size_t tail = 2 * sizeof(std::uint64_t) + 8;
+    if (size < 8 + tail || std::memcmp(data + size - 8, kIndexMagic, 8))
+        return false;
+    std::uint64_t indexOffset, indexSize;
+    std::memcpy(&indexOffset, data + size - tail, sizeof(indexOffset));
+    std::memcpy(&indexSize, data + size - tail + sizeof(indexOffset), sizeof(indexSize));
+    if (indexOffset > size - tail || indexSize != size - tail - indexOffset)
+        return false;
+    char const *it = data + indexOffset;
+    char const *end = data + size - tail;
+    std::uint32_t ncols;
+    if (!take(it, end, ncols) || ncols > (std::size_t)(end - it))
+        return false;
+    columns.resize(ncols);
+    for (auto &col: columns) {
+        std::uint16_t namelen;
+        if (!take(it, end, col.group) || !take(it, end, col.type) || !take(it, end, namelen)
+            || (std::size_t)(end - it) < namelen)
+            return false;
+        col.name.assign(it, namelen);
+        it += namelen;
+        if (!take(it, end, col.count) || !take(it, end, col.elemSize) || !take(it, end, col.chunkElems)
+            || !col.chunkElems)
+            return false;
+        std::uint64_t nchunks = (col.count + col.chunkElems - 1) / col.chunkElems;
+        if (nchunks > (std::uint64_t)(end - it))
+            return false;
+        col.chunks.resize(nchunks);
+        for (auto &chunk: col.chunks) {
+            if (!take(it, end, chunk.offset) || !take(it, end, chunk.storedSize) || !take(it, end, chunk.codec))
+                return false;
+            if (chunk.offset > indexOffset || chunk.storedSize > indexOffset - chunk.offset)
+                return false;
+        }
+    }
+    return true;
+}
+
+// the v001 layout: only float and vec3f vertex attributes, tris and quads
+// with their attributes, points, lines and the material
+struct AttrVectorHeaderV001 {
+    size_t size;
+    size_t nattrs;
+};
+
+struct AttributeHeaderV001 {
+    int type;
+    size_t size;
+    size_t namelen;
+    char name[128];
+};
+
+template <typename T>
+void deserialize_v001(std::vector<char> const &str, AttrVector<T> &arr) {
+    auto buff = str.data();
+    AttrVectorHeaderV001 header;
+    std::memcpy(&header, buff, sizeof(header));
+    buff += sizeof(header);
+    arr.values.resize(header.size);
+    std::memcpy(arr.values.data(), buff, sizeof(T) * header.size);
+    buff += sizeof(T) * header.size;
+    for (std::size_t i = 0; i < header.nattrs; ++i) {
+        AttributeHeaderV001 ah;
+        std::memcpy(&ah, buff, sizeof(ah));
+        buff += sizeof(ah);
+        std::string key{ah.name, ah.namelen};
+        if (ah.type == 0) {
+            auto &attr = arr.template add_attr<vec3f>(key);
+            attr.resize(ah.size);
+            std::memcpy(attr.data(), buff, sizeof(vec3f) * ah.size);
+            buff += sizeof(vec3f) * ah.size;
+        } else {
+            auto &attr = arr.template add_attr<float>(key);
+            attr.resize(ah.size);
+            std::memcpy(attr.data(), buff, sizeof(float) * ah.size);
+            buff += sizeof(float) * ah.size;
+        }
+    }
+}
+
+bool readzpm_v001(PrimitiveObject *prim, FILE *fp) {
+    size_t size = 0;
+    std::ignore = fread(&size, sizeof(size), 1, fp);
+    prim->resize(size);
+
+    int count = 0;
+    std::ignore = fread(&count, sizeof(count), 1, fp);
+    if (count < 0 || count >= 1024)
+        return false;
+
+    for (int i = 0; i < count; i++) {
+        char type[5];
+        std::ignore = fread(type, 4, 1, fp);
+        type[4] = '\0';
+
+        size_t namelen = 0;
+        std::ignore = fread(&namelen, sizeof(namelen), 1, fp);
+        if (namelen >= 1024)
+            return false;
+        std::string name(namelen, '\0');
+        std::ignore = fread(name.data(), sizeof(name[0]), namelen, fp);
+
+        if (!strcmp(type, "f")) {
+            prim->add_attr<float>(name);
+        } else if (!strcmp(type, "3f")) {
+            prim->add_attr<vec3f>(name);
+        } else {
+            return false;
+        }
+    }
+
+    // pos first, then the attributes in the order of the (ordered) map
+    prim->foreach_attr([&] (auto const &key, auto &attr) {
+        std::ignore = fread(attr.data(), sizeof(attr[0]), size, fp);
+    });
+
+    std::ignore = fread(&size, sizeof(size_t), 1, fp);
+    prim->points.resize(size);
+    std::ignore = fread(prim->points.data(), sizeof(prim->points[0]), prim->points.size(), fp);
+
+    std::ignore = fread(&size, sizeof(size_t), 1, fp);
+    prim->lines.resize(size);
+    std::ignore = fread(prim->lines.data(), sizeof(prim->lines[0]), prim->lines.size(), fp);
+
+    std::ignore = fread(&size, sizeof(size_t), 1, fp);
+    if (size != 0) {
+        std::vector<char> trisStr(size);
+        std::ignore = fread(trisStr.data(), sizeof(trisStr[0]), trisStr.size(), fp);
+        deserialize_v001(trisStr, prim->tris);
+    }
+
+    std::ignore = fread(&size, sizeof(size_t), 1, fp);
+    if (size != 0) {
+        std::vector<char> quadsStr(size);
+        std::ignore = fread(quadsStr.data(), sizeof(quadsStr[0]), quadsStr.size(), fp);
+        deserialize_v001(quadsStr, prim->quads);
+    }
+
+    size = 0;
+    std::ignore = fread(&size, sizeof(size_t), 1, fp);
+    if (size != 0) {
+        std::vector<char> mtlStr(size);
+        std::ignore = fread(mtlStr.data(), sizeof(mtlStr[0]), mtlStr.size(), fp);
+        prim->mtl = std::make_shared<MaterialObject>(MaterialObject::deserialize(mtlStr));
+    }
+    return true;
+}
+
+}
+
+ZENO_API std::size_t zpmsize(PrimitiveObject const *prim) {
+    return ZpmLayout(prim, false).totalSize();
+}
+
+ZENO_API void encodezpm(PrimitiveObject const *prim, std::vector<char> &buf, bool compress) {
+    ZpmLayout layout(prim, compress);
+    std::size_t base = buf.size();
+    buf.resize(base + layout.totalSize());
+    char *out = buf.data() + base;
+    std::memcpy(out, kMagic, 8);
+    std::vector<std::pair<ChunkEntry const *, ZpmLayout::Block const *>> chunks;
+    std::size_t b = 0;
+    for (auto const &col: layout.columns)
+        for (auto const &chunk: col.chunks)
+            chunks.emplace_back(&chunk, &layout.blocks[b++]);
+    parallel_for(chunks.size(), [&] (std::size_t i) {
+        auto [chunk, blk] = chunks[i];
+        std::memcpy(out + chunk->offset, layout.block_data(*blk), chunk->storedSize);
+    });
+    std::memcpy(out + layout.indexOffset, layout.index.data(), layout.index.size());
+}
+
+ZENO_API bool writezpm(PrimitiveObject const *prim, const char *path, bool compress) {
+    ZpmLayout layout(prim, compress);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        perror(path);
+        return false;
+    }
+    static const char zeros[kAlign] = {};
+    bool ok = fwrite(kMagic, 1, 8, fp) == 8;
+    std::size_t pos = 8, b = 0;
+    for (auto const &col: layout.columns) {
+        for (auto const &chunk: col.chunks) {
+            auto const &blk = layout.blocks[b++];
+            ok = ok && fwrite(zeros, 1, chunk.offset - pos, fp) == chunk.offset - pos;
+            ok = ok && fwrite(layout.block_data(blk), 1, chunk.storedSize, fp) == chunk.storedSize;
+            pos = chunk.offset + chunk.storedSize;
+        }
+    }
+    ok = ok && fwrite(zeros, 1, layout.indexOffset - pos, fp) == layout.indexOffset - pos;
+    ok = ok && fwrite(layout.index.data(), 1, layout.index.size(), fp) == layout.index.size();
+    ok = !fclose(fp) && ok;
+    if (!ok)
+        log_error("failed to write zpm file [{}]", path);
+    return ok;
+}
+
+ZENO_API bool decodezpm(PrimitiveObject *prim, const char *data, std::size_t size,
+                        std::vector<std::string> const *attrs) {
+    std::vector<ColumnEntry> columns;
+    if (size < 8 || std::memcmp(data, kMagic, 8) || !parse_index(data, size, columns)) {
+        log_error("broken zpm data");
+        return false;
+    }
+
+    // allocate the arrays, then decode all their chunks at once
+    struct Task {
+        ChunkEntry const *chunk;
+        char *dst;
+        std::size_t size;
+    };
+    std::vector<Task> tasks;
+    std::vector<char> mtl;
+    bool ok = true;
+    for (auto const &col: columns) {
+        char *dst = nullptr;
+        if (col.group == kMtlGroup && col.type == kBytesType) {
+            mtl.resize(col.count);
+            dst = mtl.data();
+        } else if (col.group < 10 && col.type < std::variant_size_v<AttrAcceptAll>) {
+            foreach_group(prim, [&] (std::uint8_t group, auto &avec) {
+                if (group != col.group)
+                    return;
+                index_switch<std::variant_size_v<AttrAcceptAll>>(col.type, [&] (auto type) {
+                    using T = std::variant_alternative_t<type.value, AttrAcceptAll>;
+                    if (col.elemSize != sizeof(T))
+                        return;
+                    using V = std::decay_t<decltype(avec.values[0])>;
+                    if (col.name.empty()) {
+                        if constexpr (std::is_same_v<T, V>) {
+                            avec.resize(col.count);
+                            dst = (char *)avec.values.data();
+                        }
+                    } else if (col.count == avec.size() && (!attrs
+                        || std::find(attrs->begin(), attrs->end(), col.name) != attrs->end())) {
+                        auto &arr = avec.template add_attr<T>(col.name);
+                        dst = (char *)arr.data();
+                    }
+                });
+            });
+        }
+        if (!dst)
+            continue;
+        for (std::size_t c = 0; c < col.chunks.size(); c++) {
+            std::size_t first = c * col.chunkElems;
+            std::size_t n = std::min<std::size_t>(col.chunkElems, col.count - first);
+            tasks.push_back({&col.chunks[c], dst + first * col.elemSize, n * col.elemSize});
+        }
+    }
+
+    std::vector<std::uint8_t> failed(tasks.size());
+    parallel_for(tasks.size(), [&] (std::size_t i) {
+        auto const &[chunk, dst, size] = tasks[i];
+        char const *src = data + chunk->offset;
+        if (chunk->codec == kRaw && chunk->storedSize == size) {
+            std::memcpy(dst, src, size);
+        } else if (chunk->codec == kShuffleRLE) {
+            failed[i] = !unpack_shuffle_rle(src, chunk->storedSize, dst, size);
+        } else {
+            failed[i] = 1;
+        }
+    });
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+        log_error("broken zpm data chunk");
+        ok = false;
+    }
+    if (!mtl.empty()) {
+        prim->mtl = std::make_shared<MaterialObject>(MaterialObject::deserialize(mtl));
+    }
+    return ok;
+}
+
+ZENO_API bool readzpm(PrimitiveObject *prim, const char *path, std::vector<std::string> const *attrs) {
+    mapped_file file(path);
+    if (file.size() >= 8 && !std::memcmp(file.data(), kMagicV001, 8)) {
+        FILE *fp = fopen(path, "rb");
+        if (!fp) {
+            perror(path);
+            return false;
+        }
+        std::fseek(fp, 8, SEEK_SET);
+        bool ok = readzpm_v001(prim, fp);
+        fclose(fp);
+        if (!ok)
+            log_error("broken zpm file [{}]", path);
+        return ok;
+    }
+    return decodezpm(prim, file.data(), file.size(), attrs);
+}
+
+}
@@ -0,0 +1,197 @@
+#include <zeno/zeno.h>
+#include <zeno/types/LinearBvh.h>
+#include <zeno/types/PrimitiveObject.h>
+#include <zeno/types/NumericObject.h>
+#include <zeno/types/StringObject.h>
+#include <zeno/funcs/PrimitiveUtils.h>
+#include <numeric>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace zeno {
+
+ZENO_API std::shared_ptr<LBvh> primCachedBvh(std::shared_ptr<PrimitiveObject> const &prim,
+                                             std::string type, float thickness, int width) {
+  if (type == "auto")
+    type = prim->quads.size() ? "quad" : prim->tris.size() ? "tri"
+         : prim->lines.size() ? "line" : "point";
+  unsigned deps = PrimitiveCache::pos;
+  if (type == "point") {
+    deps |= PrimitiveCache::points;
+    // the same as LBvh::build would do, but before the version is taken
+    if (prim->points.size() == 0) {
+      prim->points.resize(prim->verts.size());
+      std::iota(prim->points.begin(), prim->points.end(), 0);
+    }
+  } else if (type == "line") {
+    deps |= PrimitiveCache::lines;
+  } else if (type == "tri") {
+    deps |= PrimitiveCache::tris;
+  } else if (type == "quad") {
+    deps |= PrimitiveCache::quads;
+  } else {
+    throw std::runtime_error("unknown bvh element type: " + type);
+  }
+  // key on the bits, as to_string would round close thicknesses together
+  uint32_t thicknessBits;
+  std::memcpy(&thicknessBits, &thickness, sizeof(thicknessBits));
+  auto kind = "lbvh:" + type + ":" + std::to_string(thicknessBits) + ":" + std::to_string(width);
+  return prim->cache.get<LBvh>(kind, primVersion(prim.get(), deps), [&] {
+    std::shared_ptr<LBvh> lbvh;
+    if (type == "point")
+      lbvh = std::make_shared<LBvh>(prim, thickness, LBvh::element_c<LBvh::element_e::point>);
+    else if (type == "line")
+      lbvh = std::make_shared<LBvh>(prim, thickness, LBvh::element_c<LBvh::element_e::line>);
+    else if (type == "tri")
+      lbvh = std::make_shared<LBvh>(prim, thickness, LBvh::element_c<LBvh::element_e::tri>);
+    else
+      lbvh = std::make_shared<LBvh>(prim, thickness, LBvh::element_c<LBvh::element_e::tet>);
+    if (width)
+      lbvh->collapse(width);
+    return lbvh;
+  });
+}
+
+namespace {
+
+struct BuildPrimitiveBvh : zeno::INode {
+  virtual void apply() override {
+    auto prim = get_input<zeno::PrimitiveObject>("prim");
+    float thickness =
+        has_input("thickness")
+            ? get_input<zeno::NumericObject>("thickness")->get<float>()
+            : 0.f;
+    auto primType = get_param<std::string>("prim_type");
+    auto width = std::stoi(get_param<std::string>("width"));
+    // reused as long as the prim is unchanged; a wide tree is only used by
+    // batched queries, for which it is much faster
+    auto lbvh = zeno::primCachedBvh(prim, primType, thickness,
+                                    width == 2 ? 0 : width);
+    set_output("lbvh", std::move(lbvh));
+  }
+};
+
+ZENDEFNODE(BuildPrimitiveBvh,
+           {
+               {{"PrimitiveObject", "prim"}, {"float", "thickness", "0"}},
+               {{"LBvh", "lbvh"}},
+               {{"enum auto point line tri quad", "prim_type", "auto"},
+                {"enum 2 4 8", "width", "4"}},
+               {"zenofx"},
+           });
+
+struct RefitPrimitiveBvh : zeno::INode {
+  virtual void apply() override {
+    // the input may be the one cached on its prim, so refit a copy of it
+    auto lbvh = std::make_shared<zeno::LBvh>(*get_input<zeno::LBvh>("lbvh"));
+    lbvh->refit();
+    set_output("lbvh", std::move(lbvh));
+  }
+};
+
+ZENDEFNODE(RefitPrimitiveBvh, {
+                                  {{"LBvh", "lbvh"}},
+                                  {{"LBvh", "lbvh"}},
+                                  {},
+                                  {"zenofx"},
+                              });
+
+struct QueryNearestPrimitive : zeno::INode {
+  struct KVPair {
+    zeno::vec3f w;
+    float dist;
+    int pid;
+    bool operator<(const KVPair &o) const noexcept { return dist < o.dist; }
+  };
+  virtual void apply() override {
+    using namespace zeno;
+
+    auto lbvh = get_input<LBvh>("lbvh");
+    auto line = std::make_shared<PrimitiveObject>();
+
+    using Ti = typename LBvh::Ti;
+    Ti pid = 0;
+    Ti bvhId = -1;
+    float dist = std::numeric_limits<float>::max();
+    zeno::vec3f w{0.f, 0.f, 0.f};
+    if (has_input<PrimitiveObject>("prim")) {
+      auto prim = get_input<PrimitiveObject>("prim");
+
+      auto idTag = get_input2<std::string>("idTag");
+      auto distTag = get_input2<std::string>("distTag");
+      auto weightTag = get_input2<std::string>("weightTag");
+
+      auto &bvhids = prim->add_attr<float>(idTag);
+      auto &dists = prim->add_attr<float>(distTag);
+      auto &ws = prim->add_attr<zeno::vec3f>(weightTag);
+
+      // all points at once, in morton order, straight into the attributes
+      lbvh->find_nearest_batch(prim->verts.values, bvhids.data(), dists.data(),
+                               ws.data());
+
+      KVPair mi{zeno::vec3f{0.f, 0.f, 0.f}, std::numeric_limits<float>::max(), -1};
+// ref:
+// https://stackoverflow.com/questions/28258590/using-openmp-to-get-the-index-of-minimum-element-parallelly
+#ifndef _MSC_VER
+#if defined(_OPENMP)
+#pragma omp declare reduction(minimum:KVPair                                   \
+                              : omp_out = omp_in < omp_out ? omp_in : omp_out) \
+    initializer(omp_priv = KVPair{zeno::vec3f{0.f, 0.f, 0.f}, std::numeric_limits <float>::max(), -1})
+#pragma omp parallel for reduction(minimum : mi)
+#endif
+#endif
+      for (Ti i = 0; i < prim->size(); ++i) {
+        if (dists[i] < mi.dist)
+          mi = KVPair{ws[i], dists[i], i};
+      }
+      pid = mi.pid;
+      dist = mi.dist;
+      w = mi.w;
+      bvhId = bvhids[pid];
+      line->verts.push_back(prim->verts[pid]);
+#if 0
+      fmt::print("done nearest reduction. dist: {}, bvh[{}] (of {})-prim[{}]"
+                 "(of {})\n",
+                 dist, bvhId, lbvh->getNumLeaves(), pid, prim->size());
+#endif
+    } else if (has_input<NumericObject>("prim")) {
+      auto p = get_input<NumericObject>("prim")->get<vec3f>();
+      w = lbvh->find_nearest(p, bvhId, dist);
+      line->verts.push_back(p);
+    } else
+      throw std::runtime_error("unknown primitive kind (only supports "
+                               "PrimitiveObject and NumericObject::vec3f).");
+
+    line->verts.push_back(lbvh->retrievePrimitiveCenter(bvhId, w));
+    line->lines.push_back({0, 1});
+
+    set_output("primid", std::make_shared<NumericObject>(pid));
+    set_output("bvh_primid", std::make_shared<NumericObject>(bvhId));
+    set_output("dist", std::make_shared<NumericObject>(dist));
+    set_output("bvh_prim", lbvh->retrievePrimitive(bvhId));
+    set_output("segment", std::move(line));
+  }
+};
+
+ZENDEFNODE(QueryNearestPrimitive, {
+                                      {{"prim"}, {"LBvh", "lbvh"},
+                                      {"string", "idTag", "bvh_id"},
+                                      {"string", "distTag", "bvh_dist"},
+                                      {"string", "weightTag", "bvh_ws"}
+                                      },
+                                      {{"NumericObject", "primid"},
+                                       {"NumericObject", "bvh_primid"},
+                                       {"NumericObject", "dist"},
+                                       {"PrimitiveObject", "bvh_prim"},
+                                       {"PrimitiveObject", "segment"}},
+                                      {},
+                                      {"zenofx"},
+                                  });
+
+} // namespace
+} // namespace zeno
@@ -7,48 +7,54 @@
 #include <zeno/utils/string.h>
 #include <zeno/utils/log.h>
 #include <zeno/utils/vec.h>
-#include <fstream>
+#include <zeno/utils/Error.h>
+#include <zeno/para/parallel_text_write.h>
+#include <cstdio>
 
 namespace zeno {
 namespace {
 
-static void dump(int const &v, std::ostream &fout) {
-    fout << v;
+static void dump(int const &v, text_buffer &buf) {
+    buf << v;
 }
 
-static void dump(float const &v, std::ostream &fout) {
-    fout << v;
+static void dump(float const &v, text_buffer &buf) {
+    buf << v;
 }
 
 template <size_t N, class T>
-static void dump(vec<N, T> const &v, std::ostream &fout) {
-    fout << v[0];
-    for (int i = 1; i < N; i++)
-        fout << ' ' << v[i];
+static void dump(vec<N, T> const &v, text_buffer &buf) {
+    buf.append(v);
 }
 
 template <class T>
-void dump_csv(AttrVector<T> avec, std::ostream &fout) {
-    fout << "pos";
-    avec.template foreach_attr<AttrAcceptAll>([&] (auto const &key, auto &arr) {
-        fout << ',' << key;
+bool dump_csv(AttrVector<T> const &avec, std::FILE *fp) {
+    text_buffer header;
+    header << "pos";
+    avec.template foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &arr) {
+        header << ',' << key;
     });
-    fout << '\n';
-    for (int i = 0; i < avec.size(); i++) {
-        dump(avec[i], fout);
-        avec.template foreach_attr<AttrAcceptAll>([&] (auto const &key, auto &arr) {
-            fout << ',';
-            dump(arr[i], fout);
+    header << '\n';
+    if (std::fwrite(header.str.data(), 1, header.str.size(), fp) != header.str.size())
+        return false;
+    return parallel_text_write(fp, avec.size(), [&] (text_buffer &buf, size_t i) {
+        dump(avec[i], buf);
+        avec.template foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &arr) {
+            buf << ',';
+            dump(arr[i], buf);
         });
-        fout << '\n';
-    }
+        buf << '\n';
+    });
 }
 
 struct WritePrimToCSV : INode {
     virtual void apply() override {
         auto prim = get_input<PrimitiveObject>("prim");
         auto path = get_input<StringObject>("path")->get();
-        std::ofstream fout(path);
+        std::FILE *fp = std::fopen(path.c_str(), "wb");
+        if (!fp) {
+            throw makeError("cannot open file for write: " + path);
+        }
         auto mbr = funcalt_variant(array_index(
                 {"verts", "points", "lines", "tris", "quads", "loops", "polys"},
                 get_input2<std::string>("type")),
@@ -59,9 +65,13 @@ struct WritePrimToCSV : INode {
             &PrimitiveObject::quads,
             &PrimitiveObject::loops,
             &PrimitiveObject::polys);
-        std::visit([&] (auto const &mbr) {
-            dump_csv(mbr(*prim), fout);
+        bool ok = std::visit([&] (auto const &mbr) {
+            return dump_csv(mbr(*prim), fp);
         }, mbr);
+        ok = !std::fclose(fp) && ok;
+        if (!ok) {
+            throw makeError("failed to write file: " + path);
+        }
         set_output("prim", std::move(prim));
     }
 };
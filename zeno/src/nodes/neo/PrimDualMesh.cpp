@@ -2,6 +2,8 @@
 #include <zeno/types/StringObject.h>
 #include <zeno/types/PrimitiveObject.h>
 #include <zeno/funcs/PrimitiveUtils.h>
+#include <zeno/types/PrimitiveTopology.h>
+#include <zeno/para/parallel_for.h>
 #include <zeno/utils/variantswitch.h>
 #include <zeno/utils/arrayindex.h>
 #include <zeno/utils/scope_exit.h>
@@ -104,35 +106,26 @@ struct PrimDualMesh : INode {
 
         scope_exit<> revertoldpolysize;
         if (keepBounds) {
-            std::map<std::pair<int, int>, int> bounde2f;
+            // sides of only one poly become two-corner polys, so that the
+            // boundary vertices get a closed ring of dual faces too
+            std::vector<vec2i> bounds;
             {
-                std::vector<std::pair<int, int>> notbound;
-                for (int f = 0; f < prim->polys.size(); f++) {
-                    auto each_edge = [&] (int v1, int v2) {
-                        std::pair<int, int> key(std::min(v1, v2), std::max(v1, v2));
-                        auto [it, succ] = bounde2f.try_emplace(key, f);
-                        if (!succ) {
-                            notbound.push_back(key);
-                            it->second = -1;
-                        }
-                    };
-                    auto [start, len] = prim->polys[f];
-                    if (len >= 1) {
-                        for (int l = start; l < start + len - 1; l++) {
-                            each_edge(prim->loops[l], prim->loops[l + 1]);
-                        }
-                        each_edge(prim->loops[start + len - 1], prim->loops[start]);
+                auto topo = primTopology(prim.get());
+                for (int e = 0; e < topo->edges.size(); e++) {
+                    int npolys = 0;
+                    for (int i = topo->edgeOffsets[e]; i < topo->edgeOffsets[e + 1]; i++)
+                        npolys += topo->heFace[topo->edgeHalfedges[i]] >= topo->polyBase();
+                    if (npolys == 1) {
+                        auto [v1, v2] = topo->edges[e];
+                        bounds.emplace_back(std::min(v1, v2), std::max(v1, v2));
                     }
                 }
-                for (auto const &nbk: notbound)
-                    bounde2f.erase(nbk);
             }
             auto oldpolysize = prim->polys.size();
             revertoldpolysize = scope_exit<>([prim, oldpolysize] {
                 prim->polys.resize(oldpolysize);
             });
-            for (auto const &[ev, f]: bounde2f) {
-                auto [v1, v2] = ev;
+            for (auto const &[v1, v2]: bounds) {
                 int loopbase = prim->loops.size();
                 prim->loops.push_back(v1);
                 prim->loops.push_back(v2);
@@ -140,17 +133,28 @@ struct PrimDualMesh : INode {
             }
         }
 
-        std::map<int, std::vector<int>> v2f;
+        auto topo = primTopology(prim.get());
+        int polyBase = topo->polyBase();
         outprim->verts.resize(prim->polys.size());
-        for (int f = 0; f < prim->polys.size(); f++) {
+        parallel_for(prim->polys.size(), [&] (size_t f) {
             meth_average<vec3f> reducer;
             auto [start, len] = prim->polys[f];
             for (int l = start; l < start + len; l++) {
-                int v = prim->loops[l];
-                reducer.add(prim->verts[v]);
-                v2f[v].push_back(f);
+                reducer.add(prim->verts[prim->loops[l]]);
             }
             outprim->verts[f] = reducer.get();
+        });
+
+        // the polys around each vertex, in increasing order
+        std::vector<std::pair<int, std::vector<int>>> v2f;
+        for (int v = 0; v < topo->numVerts; v++) {
+            std::vector<int> faceids;
+            for (int i = topo->vertFaceOffsets[v]; i < topo->vertFaceOffsets[v + 1]; i++) {
+                if (topo->vertFaces[i] >= polyBase)
+                    faceids.push_back(topo->vertFaces[i] - polyBase);
+            }
+            if (!faceids.empty())
+                v2f.emplace_back(v, std::move(faceids));
         }
 
         std::for_each(v2f.begin(), v2f.end(), [&] (auto const &v2fent) {
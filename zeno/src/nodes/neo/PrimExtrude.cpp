@@ -1,6 +1,7 @@
 #include <zeno/para/parallel_for.h>
 #include <zeno/types/NumericObject.h>
 #include <zeno/types/PrimitiveObject.h>
+#include <zeno/types/PrimitiveTopology.h>
 #include <zeno/types/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/utils/arrayindex.h>
@@ -8,8 +9,8 @@
 #include <zeno/extra/TempNode.h>
 #include <zeno/core/INode.h>
 #include <zeno/zeno.h>
+#include <algorithm>
 #include <numeric>
-#include <set>
 
 namespace zeno {
 namespace {
@@ -144,42 +145,31 @@ struct PrimExtrude : INode {
             primFlipFaces(prim.get());
         }
 
-        struct segment_less {
-            bool operator()(vec2i const &a, vec2i const &b) const {
-                return std::make_pair(std::min(a[0], a[1]), std::max(a[0], a[1]))
-                    < std::make_pair(std::min(b[0], b[1]), std::max(b[0], b[1]));
-            }
-        };
-        std::map<vec2i, bool, segment_less> segments;
-        auto append = [&] (int i, int j) {
-            auto [it, succ] = segments.emplace(vec2i(i, j), false);
-            if (!succ)
-                it->second = true;
-        };
-        for (auto const &ind: prim2->lines) {
-            append(ind[0], ind[1]);
-        }
-        for (auto const &ind: prim2->tris) {
-            append(ind[0], ind[1]);
-            append(ind[1], ind[2]);
-            append(ind[2], ind[0]);
-        }
-        for (auto const &ind: prim2->quads) {
-            append(ind[0], ind[1]);
-            append(ind[1], ind[2]);
-            append(ind[2], ind[3]);
-            append(ind[3], ind[0]);
+        // sides used by one face or line only, plus the given edges no face
+        // has, ordered by (min, max) vertex
+        auto topo = primTopology(prim2.get());
+        std::vector<vec2i> bounds;
+        for (int e = 0; e < topo->edges.size(); e++) {
+            if (topo->edgeValence(e) == 1)
+                bounds.push_back(topo->edges[e]);
         }
-        for (auto const &[start, len]: prim2->polys) {
-            if (len < 2)
-                continue;
-            for (int i = start + 1; i < start + len; i++) {
-                append(prim2->loops[i - 1], prim2->loops[i]);
+        auto segment_key = [] (vec2i const &a) {
+            return std::make_pair(std::min(a[0], a[1]), std::max(a[0], a[1]));
+        };
+        bool hasLooseEdges = false;
+        for (auto const &ind: prim2->edges) {
+            if (topo->findEdge(ind[0], ind[1]) == -1) {
+                bounds.push_back(ind);
+                hasLooseEdges = true;
             }
-            append(prim2->loops[start + len - 1], prim2->loops[start]);
         }
-        for (auto const &ind: prim2->edges) {
-            segments.emplace(vec2i(ind[0], ind[1]), false); // if fail then just let it fail
+        if (hasLooseEdges) {
+            std::stable_sort(bounds.begin(), bounds.end(), [&] (vec2i const &a, vec2i const &b) {
+                return segment_key(a) < segment_key(b);
+            });
+            bounds.erase(std::unique(bounds.begin(), bounds.end(), [&] (vec2i const &a, vec2i const &b) {
+                return segment_key(a) == segment_key(b);
+            }), bounds.end());
         }
 
         //if (avgoffset != 0) {
@@ -208,11 +198,6 @@ struct PrimExtrude : INode {
 
         //auto tmpBoundTagAttr = "%%extrude1";
         //primMarkBoundaryEdges(prim2.get(), tmpBoundTagAttr);
-        std::vector<vec2i> bounds;
-        for (auto const &[edge, hasdup]: segments) {
-            if (!hasdup)
-                bounds.push_back(edge);
-        }
 
         int p1size = prim->verts.size();
         int p2size = prim2->verts.size();
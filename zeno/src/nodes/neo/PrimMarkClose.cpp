@@ -1,14 +1,98 @@
 #include <zeno/zeno.h>
 #include <zeno/types/PrimitiveObject.h>
-#include <zeno/types/PrimitiveUtils.h>
+#include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/NumericObject.h>
-#include <zeno/utils/tuple_hash.h>
 #include <zeno/para/parallel_for.h>
+#include <zeno/para/concurrent_union_find.h>
 #include <zeno/utils/log.h>
-#include <unordered_map>
+#include <zeno/para/parallel_radix_sort.h>
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
 
 namespace zeno {
+
+ZENO_API void primMarkClose(PrimitiveObject *prim, std::string tagAttr, float distance) {
+    auto const &pos = prim->verts.values;
+    size_t n = pos.size();
+    float factor = 1.0f / distance;
+
+    // cells `distance` wide, so close pairs lie in neighbouring cells; the
+    // points are sorted by cell in (z, y, x) order by three stable radix
+    // sorts, ties keeping the point order
+    std::vector<vec3i> cells(n);
+    parallel_for(n, [&] (size_t i) {
+        cells[i] = vec3i(floor(pos[i] * factor));
+    });
+    std::vector<int> order(n);
+    {
+        std::vector<std::uint32_t> keys(n);
+        parallel_for(n, [&] (size_t i) {
+            order[i] = (int)i;
+        });
+        for (int axis = 0; axis < 3; axis++) {
+            parallel_for(n, [&] (size_t k) {
+                keys[k] = std::uint32_t(cells[order[k]][axis]) ^ 0x80000000u;
+            });
+            parallel_radix_sort(keys, order);
+        }
+    }
+    std::vector<vec3i> sortedCells(n);
+    std::vector<vec3f> sortedPos(n);
+    parallel_for(n, [&] (size_t k) {
+        sortedCells[k] = cells[order[k]];
+        sortedPos[k] = pos[order[k]];
+    });
+    cells = {};
+
+    // each pair is seen from the point whose cell comes first, or from the
+    // first point when they share a cell: for a point, that is the rest of
+    // its own row up to x + 1, and the x - 1 .. x + 1 spans of the 4 rows
+    // after it; as the points are visited in sorted order, the start of
+    // each span only moves forward, so a chunk of points sweeps all spans
+    // with a cursor per row instead of looking them up
+    auto cell_less = [] (vec3i const &a, vec3i const &b) {
+        return std::tie(a[2], a[1], a[0]) < std::tie(b[2], b[1], b[0]);
+    };
+    static const vec3i rowOffsets[4] = {{0, 1, 0}, {0, -1, 1}, {0, 0, 1}, {0, 1, 1}};
+    concurrent_union_find uf(n);
+    float dist2 = distance * distance;
+    auto test = [&] (size_t k, size_t j) {
+        if (lengthSquared(sortedPos[j] - sortedPos[k]) <= dist2)
+            uf.unite(order[k], order[j]);
+    };
+    constexpr size_t chunkSize = 4096;
+    parallel_for((n + chunkSize - 1) / chunkSize, [&] (size_t chunk) {
+        size_t lo = chunk * chunkSize, hi = std::min(n, lo + chunkSize);
+        size_t cursors[4];
+        for (int r = 0; r < 4; r++) {
+            auto first = sortedCells[lo] + rowOffsets[r] - vec3i(1, 0, 0);
+            cursors[r] = std::lower_bound(sortedCells.begin(), sortedCells.end(), first, cell_less) - sortedCells.begin();
+        }
+        for (size_t k = lo; k < hi; k++) {
+            auto c = sortedCells[k];
+            for (size_t j = k + 1; j < n && sortedCells[j][2] == c[2]
+                 && sortedCells[j][1] == c[1] && sortedCells[j][0] <= c[0] + 1; j++)
+                test(k, j);
+            for (int r = 0; r < 4; r++) {
+                auto first = c + rowOffsets[r] - vec3i(1, 0, 0);
+                auto last = c + rowOffsets[r] + vec3i(1, 0, 0);
+                auto &j0 = cursors[r];
+                while (j0 < n && cell_less(sortedCells[j0], first))
+                    ++j0;
+                for (size_t j = j0; j < n && !cell_less(last, sortedCells[j]); j++)
+                    test(k, j);
+            }
+        }
+    });
+
+    // each cluster is tagged by the rank of its lowest point
+    auto &tag = prim->verts.add_attr<int>(tagAttr);
+    int nclusters = uf.labels(tag);
+    zeno::log_info("PrimMarkClose: collapse from {} to {}", n, nclusters);
+}
+
 namespace {
 
 struct PrimMarkClose : INode {
@@ -17,28 +101,7 @@ struct PrimMarkClose : INode {
         auto tagAttr = get_input<StringObject>("tagAttr")->get();
         float distance = get_input<NumericObject>("distance")->get<float>();
 
-        float factor = 1.0f / distance;
-        std::unordered_multimap<vec3i, int, tuple_hash, tuple_equal> lut;
-        lut.reserve(prim->verts.size());
-        for (int i = 0; i < prim->verts.size(); i++) {
-            vec3f pos = prim->verts[i];
-            vec3i posi = vec3i(floor(pos * factor));
-            lut.emplace(posi, i);
-        }
-
-        auto &tag = prim->verts.add_attr<int>(tagAttr);
-        if (lut.size()) {
-            int cnt = 0;
-            auto last_key = lut.begin()->first;
-            for (auto const &[key, idx]: lut) {
-                if (!tuple_equal{}(last_key, key)) {
-                    ++cnt;
-                    last_key = key;
-                }
-                tag[idx] = cnt;
-            }
-            zeno::log_info("PrimMarkClose: collapse from {} to {}", prim->verts.size(), cnt + 1);
-        }
+        primMarkClose(prim.get(), tagAttr, distance);
 
         set_output("prim", std::move(prim));
     }
@@ -5,14 +5,17 @@
 #include <zeno/types/NumericObject.h>
 #include <zeno/para/parallel_for.h>
 #include <zeno/para/parallel_scan.h>
+#include <zeno/para/parallel_radix_sort.h>
+#include <zeno/para/counter_iterator.h>
 #define ZENO_NOTICKTOCK
 #include <zeno/utils/ticktock.h>
 #include <zeno/utils/variantswitch.h>
 #include <zeno/utils/wangsrng.h>
-#include <zeno/utils/tuple_hash.h>
 #include <zeno/utils/log.h>
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
 #include <random>
+#include <tuple>
 #include <cmath>
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -22,63 +25,172 @@ namespace zeno {
 
 template <class T>
 static void revamp_vector(std::vector<T> &arr, std::vector<int> const &revamp) {
-    std::vector<T> newarr(arr.size());
-    for (int i = 0; i < revamp.size(); i++) {
+    std::vector<T> newarr(revamp.size());
+    parallel_for(revamp.size(), [&] (size_t i) {
         newarr[i] = arr[revamp[i]];
-    }
+    });
     std::swap(arr, newarr);
 }
 
+// greedy poisson-disk thinning: a point is kept unless a kept point lies
+// within minRadius. cells are minRadius wide, so conflicts are between
+// neighbouring cells only, and the cells are done in 8 phases by the parity
+// of their coordinates: cells of one phase are never neighbours, so they are
+// thinned concurrently, each looking at what earlier phases kept around it.
+// within a cell the points go in index order, so the result does not depend
+// on the thread count
 static void primPossionFilter(PrimitiveObject *prim, float minRadius) {
     if (minRadius <= 0) return;
 
     TICK(possion);
+    auto const &pos = prim->verts.values;
+    size_t n = pos.size();
+    if (!n) return;
     float invRadius = 1.f / minRadius;
-    std::unordered_map<vec3i, std::vector<int>, tuple_hash, tuple_equal> lut;
-    for (int i = 0; i < prim->verts.size(); i++) {
-        vec3i ipos(prim->verts[i] * invRadius);
-        lut[ipos].push_back(i);
+
+    // sort the points by cell in (z, y, x) order, ties keeping index order
+    std::vector<vec3i> cells(n);
+    parallel_for(n, [&] (size_t i) {
+        cells[i] = vec3i(floor(pos[i] * invRadius));
+    });
+    std::vector<int> order(n);
+    {
+        std::vector<std::uint32_t> keys(n);
+        parallel_for(n, [&] (size_t i) {
+            order[i] = (int)i;
+        });
+        for (int axis = 0; axis < 3; axis++) {
+            parallel_for(n, [&] (size_t k) {
+                keys[k] = std::uint32_t(cells[order[k]][axis]) ^ 0x80000000u;
+            });
+            parallel_radix_sort(keys, order);
+        }
+    }
+    std::vector<vec3i> sortedCells(n);
+    std::vector<vec3f> sortedPos(n);
+    parallel_for(n, [&] (size_t k) {
+        sortedCells[k] = cells[order[k]];
+        sortedPos[k] = pos[order[k]];
+    });
+    cells = {};
+
+    // the occupied cells, as runs of the sorted points
+    std::vector<int> cellStart(n + 1);
+    cellStart[0] = 0;
+    parallel_inclusive_scan_sum(counter_iterator<size_t>(0), counter_iterator<size_t>(n),
+                                cellStart.begin() + 1, [&] (size_t k) {
+        return int(k == 0 || anytrue(sortedCells[k] != sortedCells[k - 1]));
+    });
+    int ncells = cellStart[n];
+    std::vector<int> cellOffsets(ncells + 1);
+    std::vector<vec3i> cellCoords(ncells);
+    parallel_for(n, [&] (size_t k) {
+        if (cellStart[k] != cellStart[k + 1]) {
+            cellOffsets[cellStart[k]] = (int)k;
+            cellCoords[cellStart[k]] = sortedCells[k];
+        }
+    });
+    cellOffsets[ncells] = (int)n;
+    cellStart = {};
+    sortedCells = {};
+
+    // group the cells by phase
+    std::vector<int> phaseCells(ncells);
+    std::vector<int> phaseOffsets(9);
+    {
+        std::vector<std::uint32_t> keys(ncells);
+        parallel_for((size_t)ncells, [&] (size_t c) {
+            auto coord = cellCoords[c];
+            keys[c] = (coord[0] & 1) | (coord[1] & 1) << 1 | (coord[2] & 1) << 2;
+            phaseCells[c] = (int)c;
+        });
+        parallel_radix_sort(keys, phaseCells, 3);
+        for (std::uint32_t phase = 0; phase <= 8; phase++)
+            phaseOffsets[phase] = std::lower_bound(keys.begin(), keys.end(), phase) - keys.begin();
     }
 
-    std::vector<uint8_t> erased(prim->verts.size());
-    for (int i = 0; i < prim->verts.size(); i++) {
-        if (erased[i])
-            continue;
-        vec3i ipos(prim->verts[i] * invRadius);
-        erased[i] = [&] {
-            for (int dz = -1; dz <= 1; dz++) {
-                for (int dy = -1; dy <= 1; dy++) {
-                    for (int dx = -1; dx <= 1; dx++) {
-                        auto it = lut.find(ipos + vec3i(dx, dy, dz));
-                        if (it != lut.end()) {
-                            for (int j: it->second) {
-                                if (j == i || erased[j])
-                                    continue;
-                                auto dis = prim->verts[i] - prim->verts[j];
-                                if (length(dis) < minRadius)
-                                    return true;
+    auto cell_less = [] (vec3i const &a, vec3i const &b) {
+        return std::tie(a[2], a[1], a[0]) < std::tie(b[2], b[1], b[0]);
+    };
+
+    // the cells of a phase stay in sorted order, so the neighbouring rows of
+    // successive cells only move forward: a chunk of them sweeps each of its
+    // 9 rows with a pair of cursors instead of looking them up. a thinned
+    // cell moves its kept points to the front of its run, so its neighbours
+    // only test those
+    std::vector<int> numKept(ncells);
+    float radius2 = minRadius * minRadius;
+    constexpr size_t chunkSize = 1024;
+    for (int phase = 0; phase < 8; phase++) {
+        size_t begin = phaseOffsets[phase], end = phaseOffsets[phase + 1];
+        parallel_for((end - begin + chunkSize - 1) / chunkSize, [&] (size_t chunk) {
+            size_t lo = begin + chunk * chunkSize, hi = std::min(end, lo + chunkSize);
+            size_t cursors[9][2];
+            for (int r = 0; r < 9; r++) {
+                auto first = cellCoords[phaseCells[lo]] + vec3i(-1, r % 3 - 1, r / 3 - 1);
+                cursors[r][0] = cursors[r][1] = std::lower_bound(cellCoords.begin(), cellCoords.end(), first, cell_less) - cellCoords.begin();
+            }
+            for (size_t i = lo; i < hi; i++) {
+                int c = phaseCells[i];
+                for (int r = 0; r < 9; r++) {
+                    auto first = cellCoords[c] + vec3i(-1, r % 3 - 1, r / 3 - 1);
+                    auto last = cellCoords[c] + vec3i(1, r % 3 - 1, r / 3 - 1);
+                    auto &[c0, c1] = cursors[r];
+                    while (c0 < (size_t)ncells && cell_less(cellCoords[c0], first))
+                        ++c0;
+                    c1 = std::max(c0, c1);
+                    while (c1 < (size_t)ncells && !cell_less(last, cellCoords[c1]))
+                        ++c1;
+                }
+                int w = cellOffsets[c];
+                for (int k = cellOffsets[c]; k < cellOffsets[c + 1]; k++) {
+                    auto p = sortedPos[k];
+                    bool keep = [&] {
+                        for (auto const &[c0, c1]: cursors) {
+                            for (size_t nc = c0; nc < c1; nc++) {
+                                for (int j = cellOffsets[nc], e = j + numKept[nc]; j < e; j++) {
+                                    if (lengthSquared(sortedPos[j] - p) < radius2)
+                                        return false;
+                                }
                             }
                         }
+                        return true;
+                    }();
+                    if (keep) {
+                        std::swap(sortedPos[w], sortedPos[k]);
+                        std::swap(order[w], order[k]);
+                        numKept[c] = ++w - cellOffsets[c];
                     }
                 }
             }
-            return false;
-        }();
+        });
     }
+    sortedPos = {};
 
-    std::vector<int> revamp(prim->verts.size());
-    int nrevamp = 0;
-    for (int i = 0; i < erased.size(); i++) {
-        if (!erased[i])
-            revamp[nrevamp++] = i;
-    }
-    revamp.resize(nrevamp);
+    // compact the kept points, in their original order
+    std::vector<uint8_t> keep(n);
+    parallel_for((size_t)ncells, [&] (size_t c) {
+        for (int k = cellOffsets[c], e = k + numKept[c]; k < e; k++)
+            keep[order[k]] = 1;
+    });
+    order = {};
+    std::vector<int> keptRank(n);
+    parallel_inclusive_scan_sum(keep.begin(), keep.end(), keptRank.begin(), [] (uint8_t k) {
+        return (int)k;
+    });
+    int nrevamp = keptRank[n - 1];
+    std::vector<int> revamp(nrevamp);
+    parallel_for(n, [&] (size_t i) {
+        if (keep[i])
+            revamp[keptRank[i] - 1] = (int)i;
+    });
 
     prim->verts.forall_attr([&] (auto const &key, auto &arr) {
         revamp_vector(arr, revamp);
     });
     prim->verts.resize(nrevamp);
     TOCK(possion);
+    zeno::log_info("PrimScatter possion filter kept {} of {} points", nrevamp, n);
 }
 
 ZENO_API std::shared_ptr<PrimitiveObject> primScatter(
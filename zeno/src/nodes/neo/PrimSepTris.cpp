@@ -46,6 +46,10 @@ ZENO_API void primSepTriangles(PrimitiveObject *prim, bool smoothNormal, bool ke
     //}
     bool needCompNormal = !prim->verts.has_attr("nrm");
     bool needCompUVs = !prim->verts.has_attr("uv");
+    if (smoothNormal && needCompNormal) {
+        // gathered on the shared vertices, then copied out with the other attrs
+        primCalcNormal(prim, 1.0f, "nrm", "uniform");
+    }
 
     std::vector<int> v;
     int loopcount = 0;
@@ -167,26 +171,6 @@ ZENO_API void primSepTriangles(PrimitiveObject *prim, bool smoothNormal, bool ke
     prim->loops.clear();
     prim->uvs.clear();
 
-    if (smoothNormal && needCompNormal) {
-        std::vector<vec3f> shn(prim->verts.size());
-        for (size_t i = 0; i < v.size() / 3; i++) {
-            auto a = new_verts[i * 3 + 0];
-            auto b = new_verts[i * 3 + 1];
-            auto c = new_verts[i * 3 + 2];
-            auto n = cross(b - a, c - a);
-            n = normalizeSafe(n);
-            shn[v[i * 3 + 0]] += n;
-            shn[v[i * 3 + 1]] += n;
-            shn[v[i * 3 + 2]] += n;
-        }
-        auto &new_nrm = new_verts.add_attr<vec3f>("nrm");
-        for (size_t i = 0; i < v.size(); i++) {
-            auto n = shn[v[i]];
-            n = normalizeSafe(n);
-            new_nrm[i] = n;
-        }
-    }
-
     std::swap(new_verts, prim->verts);
 
     if (!smoothNormal && needCompNormal) {
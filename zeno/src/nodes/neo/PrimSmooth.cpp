@@ -1,6 +1,7 @@
 #include <zeno/para/parallel_for.h>
 #include <zeno/types/NumericObject.h>
 #include <zeno/types/PrimitiveObject.h>
+#include <zeno/types/PrimitiveTopology.h>
 #include <zeno/types/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/CurveObject.h>
@@ -17,7 +18,30 @@ namespace {
 struct PrimSmooth : INode {
     virtual void apply() override {
         auto prim = get_input<PrimitiveObject>("prim");
-        throw makeError("WIP");
+        auto iterations = get_input2<int>("iterations");
+        auto weight = get_input2<float>("weight");
+
+        // laplacian smoothing: move each vertex towards the average of its
+        // neighbours along edges, vertices without any are left in place
+        auto topo = primTopology(prim.get());
+        auto &pos = prim->verts.values;
+        std::vector<vec3f> newpos(pos.size());
+        for (int it = 0; it < iterations; it++) {
+            parallel_for(pos.size(), [&] (size_t v) {
+                int begin = topo->vertVertOffsets[v], end = topo->vertVertOffsets[v + 1];
+                if (begin == end) {
+                    newpos[v] = pos[v];
+                    return;
+                }
+                vec3f avg(0);
+                for (int i = begin; i < end; i++)
+                    avg += pos[topo->vertVerts[i]];
+                avg /= float(end - begin);
+                newpos[v] = pos[v] + weight * (avg - pos[v]);
+            });
+            pos.swap(newpos);
+        }
+
         set_output("prim", std::move(prim));
     }
 };
@@ -25,6 +49,8 @@ struct PrimSmooth : INode {
 ZENDEFNODE(PrimSmooth, {
     {
     {"PrimitiveObject", "prim"},
+    {"int", "iterations", "1"},
+    {"float", "weight", "0.5"},
     },
     {
     {"PrimitiveObject", "prim"},
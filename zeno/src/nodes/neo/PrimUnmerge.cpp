@@ -3,152 +3,184 @@
 #include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/ListObject.h>
 #include <zeno/types/StringObject.h>
+#include <zeno/types/UserData.h>
 #include <zeno/para/parallel_reduce.h>
 #include <zeno/para/parallel_for.h>
+#include <zeno/para/parallel_radix_sort.h>
+#include <algorithm>
+#include <cstdint>
 
 namespace zeno {
 
+namespace {
+
+// stable grouping of 0..n by group(i), items outside 0..numGroups dropped:
+// group g lists order[offsets[g] .. offsets[g + 1]) in increasing order
+template <class Group>
+void group_items(size_t n, int numGroups, Group group, std::vector<int> &offsets, std::vector<int> &order) {
+    std::vector<std::uint32_t> keys(n);
+    order.resize(n);
+    parallel_for(n, [&] (size_t i) {
+        int g = group(i);
+        keys[i] = g >= 0 && g < numGroups ? g : numGroups;
+        order[i] = (int)i;
+    });
+    int numBits = 1;
+    while ((std::uint32_t(1) << numBits) <= (std::uint32_t)numGroups)
+        ++numBits;
+    parallel_radix_sort(keys, order, numBits);
+    offsets.resize(numGroups + 1);
+    parallel_for((size_t)numGroups + 1, [&] (size_t g) {
+        offsets[g] = int(std::lower_bound(keys.begin(), keys.end(), (std::uint32_t)g) - keys.begin());
+    });
+    order.resize(offsets[numGroups]);
+}
+
+}
+
 ZENO_API std::vector<std::shared_ptr<PrimitiveObject>> primUnmergeVerts(PrimitiveObject *prim, std::string tagAttr) {
     if (!prim->verts.size()) return {};
 
     auto const &tagArr = prim->verts.attr<int>(tagAttr);
     int tagMax = parallel_reduce_max(tagArr.begin(), tagArr.end()) + 1;
+    if (tagMax <= 0) return {};
+
+    // every piece in one pass, instead of filtering a full copy per tag:
+    // vertices and elements are grouped by tag, an element going to the
+    // piece all its vertices are in, and indices remapped into the piece
+    std::vector<int> vertOffsets, vertOrder;
+    group_items(prim->verts.size(), tagMax, [&] (size_t i) {
+        return tagArr[i];
+    }, vertOffsets, vertOrder);
+    std::vector<int> localIndex(prim->verts.size(), -1);
+    parallel_for(vertOrder.size(), [&] (size_t k) {
+        int i = vertOrder[k];
+        localIndex[i] = (int)k - vertOffsets[tagArr[i]];
+    });
 
     std::vector<std::shared_ptr<PrimitiveObject>> primList(tagMax);
-    for (int tag = 0; tag < tagMax; tag++) {
-        primList[tag] = std::make_shared<PrimitiveObject>();
-    }
-
-#if 1
-    for (int tag = 0; tag < tagMax; tag++) {
-        primList[tag]->assign(prim);
-        primFilterVerts(primList[tag].get(), tagAttr, tag);
-    }
-
-#else
-    std::vector<std::vector<int>> vert_revamp(tagMax);
-    std::vector<int> vert_unrevamp(prim->verts.size());
-
-    for (size_t i = 0; i < prim->verts.size(); i++) {
-        int tag = tagArr[i];
-        vert_revamp[tag].push_back(i);
-        vert_unrevamp[i] = tag;
-    }
-
-    for (int tag = 0; tag < tagMax; tag++) {
-        auto &revamp = vert_revamp[tag];
-        auto const &outprim = primList[tag];
-
-        outprim->verts.resize(revamp.size());
-        parallel_for((size_t)0, revamp.size(), [&] (size_t i) {
-            outprim->verts[i] = prim->verts[revamp[i]];
-        });
-        prim->verts.foreach_attr([&] (auto const &key, auto const &inarr) {
+    auto const &userData = prim->userData();
+    parallel_for((size_t)tagMax, [&] (size_t tag) {
+        auto outprim = std::make_shared<PrimitiveObject>();
+        int beg = vertOffsets[tag], end = vertOffsets[tag + 1];
+        outprim->verts.resize(end - beg);
+        for (int k = beg; k < end; k++)
+            outprim->verts[k - beg] = prim->verts[vertOrder[k]];
+        prim->verts.foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &inarr) {
             using T = std::decay_t<decltype(inarr[0])>;
             auto &outarr = outprim->verts.add_attr<T>(key);
-            parallel_for((size_t)0, revamp.size(), [&] (size_t i) {
-                outarr[i] = inarr[revamp[i]];
-            });
+            for (int k = beg; k < end; k++)
+                outarr[k - beg] = inarr[vertOrder[k]];
         });
-    }
-
-    std::vector<std::vector<int>> face_revamp;
+        outprim->mtl = prim->mtl;
+        outprim->inst = prim->inst;
+        outprim->userData() = userData;
+        primList[tag] = std::move(outprim);
+    });
 
     auto mock = [&] (auto getter) {
         auto &prim_tris = getter(prim);
-        if (prim_tris.size()) {
-            face_revamp.clear();
-            face_revamp.resize(tagMax);
-            using T = std::decay_t<decltype(prim_tris[0])>;
-
-            for (size_t i = 0; i < prim_tris.size(); i++) {
-                auto ind = reinterpret_cast<decay_vec_t<T> const *>(&prim_tris[i]);
-                int tag = vert_unrevamp[ind[0]];
-                bool bad = false;
-                for (int j = 1; j < is_vec_n<T>; j++) {
-                    int new_tag = vert_unrevamp[ind[j]];
-                    if (tag != new_tag) {
-                        bad = true;
-                        break;
-                    }
-                }
-                if (!bad) face_revamp[tag].push_back(i);
+        if (!prim_tris.size()) return;
+        using T = std::decay_t<decltype(prim_tris[0])>;
+        constexpr int N = std::is_same_v<T, int> ? 1 : is_vec_n<T>;
+        auto indices = [] (auto &ind) {
+            if constexpr (N == 1)
+                return &ind;
+            else
+                return std::addressof(ind[0]);
+        };
+
+        std::vector<int> faceOffsets, faceOrder;
+        group_items(prim_tris.size(), tagMax, [&] (size_t i) {
+            auto ind = indices(prim_tris[i]);
+            int tag = tagArr[ind[0]];
+            for (int j = 1; j < N; j++)
+                if (tagArr[ind[j]] != tag)
+                    return -1;
+            return tag;
+        }, faceOffsets, faceOrder);
+
+        parallel_for((size_t)tagMax, [&] (size_t tag) {
+            int beg = faceOffsets[tag], end = faceOffsets[tag + 1];
+            auto &outprim_tris = getter(primList[tag].get());
+            outprim_tris.resize(end - beg);
+            for (int k = beg; k < end; k++) {
+                auto ind = indices(prim_tris[faceOrder[k]]);
+                auto outind = indices(outprim_tris[k - beg]);
+                for (int j = 0; j < N; j++)
+                    outind[j] = localIndex[ind[j]];
             }
-
-            for (int tag = 0; tag < tagMax; tag++) {
-                auto &revamp = face_revamp[tag];
-                auto &v_revamp = vert_revamp[tag];
-                auto *outprim = primList[tag].get();
-                auto &outprim_tris = getter(outprim);
-
-                outprim_tris.resize(revamp.size());
-                parallel_for((size_t)0, revamp.size(), [&] (size_t i) {
-                    auto ind = reinterpret_cast<decay_vec_t<T> const *>(&prim_tris[revamp[i]]);
-                    auto outind = reinterpret_cast<decay_vec_t<T> *>(&outprim_tris[i]);
-                    for (int j = 0; j < is_vec_n<T>; j++) {
-                        outind[j] = v_revamp[ind[j]];
-                    }
-                });
-
-                prim_tris.foreach_attr([&] (auto const &key, auto const &inarr) {
-                    using T = std::decay_t<decltype(inarr[0])>;
-                    auto &outarr = outprim_tris.template add_attr<T>(key);
-                    parallel_for((size_t)0, revamp.size(), [&] (size_t i) {
-                        outarr[i] = inarr[revamp[i]];
-                    });
-                });
-            }
-        }
+            prim_tris.template foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &inarr) {
+                using T = std::decay_t<decltype(inarr[0])>;
+                auto &outarr = outprim_tris.template add_attr<T>(key);
+                for (int k = beg; k < end; k++)
+                    outarr[k - beg] = inarr[faceOrder[k]];
+            });
+        });
     };
     mock([] (auto &&p) -> auto & { return p->points; });
     mock([] (auto &&p) -> auto & { return p->lines; });
     mock([] (auto &&p) -> auto & { return p->tris; });
     mock([] (auto &&p) -> auto & { return p->quads; });
+    mock([] (auto &&p) -> auto & { return p->edges; });
 
     if (prim->polys.size()) {
-        face_revamp.clear();
-        face_revamp.resize(tagMax);
-
-        for (size_t i = 0; i < prim->polys.size(); i++) {
-            auto &[base, len] = prim->polys[i];
-            if (len <= 0) continue;
-            int tag = vert_unrevamp[prim->loops[base]];
-            bool bad = false;
-            for (int j = base + 1; j < base + len; i++) {
-                int new_tag = vert_unrevamp[prim->loops[j]];
-                if (tag != new_tag) {
-                    bad = true;
-                    break;
-                }
-            }
-            if (!bad) face_revamp[tag].push_back(i);
-        }
-
-        for (int tag = 0; tag < tagMax; tag++) {
-            auto &revamp = face_revamp[tag];
-            auto &v_revamp = vert_revamp[tag];
+        std::vector<int> polyOffsets, polyOrder;
+        group_items(prim->polys.size(), tagMax, [&] (size_t i) {
+            auto [base, len] = prim->polys[i];
+            if (len <= 0) return -1;
+            int tag = tagArr[prim->loops[base]];
+            for (int j = base + 1; j < base + len; j++)
+                if (tagArr[prim->loops[j]] != tag)
+                    return -1;
+            return tag;
+        }, polyOffsets, polyOrder);
+
+        bool hasLoopUVs = prim->loop_uvs.size() == prim->loops.size() && prim->uvs.size();
+        parallel_for((size_t)tagMax, [&] (size_t tag) {
+            int beg = polyOffsets[tag], end = polyOffsets[tag + 1];
             auto *outprim = primList[tag].get();
-
-            outprim->polys.resize(revamp.size());
-            for (size_t i = 0; i < revamp.size(); i++) {
-                auto const &[base, len] = prim->polys[revamp[i]];
-                int new_base = outprim->loops.size();
-                for (int j = base; j < base + len; j++) {
-                    outprim->loops.push_back(prim->loops[j]);
-                }
-                outprim->polys[i] = {new_base, len};
+            outprim->polys.resize(end - beg);
+            std::vector<int> loopRevamp;
+            for (int k = beg; k < end; k++) {
+                auto [base, len] = prim->polys[polyOrder[k]];
+                outprim->polys[k - beg] = {(int)loopRevamp.size(), len};
+                for (int j = base; j < base + len; j++)
+                    loopRevamp.push_back(j);
             }
-
-            prim->polys.foreach_attr([&] (auto const &key, auto const &inarr) {
+            outprim->loops.resize(loopRevamp.size());
+            for (size_t l = 0; l < loopRevamp.size(); l++)
+                outprim->loops[l] = localIndex[prim->loops[loopRevamp[l]]];
+            prim->loops.foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &inarr) {
+                using T = std::decay_t<decltype(inarr[0])>;
+                auto &outarr = outprim->loops.add_attr<T>(key);
+                for (size_t l = 0; l < loopRevamp.size(); l++)
+                    outarr[l] = inarr[loopRevamp[l]];
+            });
+            prim->polys.foreach_attr<AttrAcceptAll>([&] (auto const &key, auto const &inarr) {
                 using T = std::decay_t<decltype(inarr[0])>;
                 auto &outarr = outprim->polys.add_attr<T>(key);
-                parallel_for((size_t)0, revamp.size(), [&] (size_t i) {
-                    outarr[i] = inarr[revamp[i]];
-                });
+                for (int k = beg; k < end; k++)
+                    outarr[k - beg] = inarr[polyOrder[k]];
             });
-        }
+
+            // only the uvs used by this piece are kept
+            if (hasLoopUVs) {
+                std::vector<int> uvRevamp(loopRevamp.size());
+                for (size_t l = 0; l < loopRevamp.size(); l++)
+                    uvRevamp[l] = prim->loop_uvs[loopRevamp[l]];
+                std::sort(uvRevamp.begin(), uvRevamp.end());
+                uvRevamp.erase(std::unique(uvRevamp.begin(), uvRevamp.end()), uvRevamp.end());
+                outprim->loop_uvs.resize(loopRevamp.size());
+                for (size_t l = 0; l < loopRevamp.size(); l++)
+                    outprim->loop_uvs[l] = int(std::lower_bound(uvRevamp.begin(), uvRevamp.end(),
+                                                                prim->loop_uvs[loopRevamp[l]]) - uvRevamp.begin());
+                outprim->uvs.resize(uvRevamp.size());
+                for (size_t u = 0; u < uvRevamp.size(); u++)
+                    outprim->uvs[u] = prim->uvs[uvRevamp[u]];
+            }
+        });
     }
-#endif
 
     return primList;
 }
@@ -3,18 +3,21 @@
 #include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/NumericObject.h>
-#include <unordered_map>
+#include <zeno/para/parallel_for.h>
+#include <zeno/para/parallel_scan.h>
+#include <zeno/para/parallel_radix_sort.h>
 #include <algorithm>
+#include <cstdint>
 
 namespace zeno {
 namespace {
 
 template <class T>
 static void revamp_vector(std::vector<T> &arr, std::vector<int> const &revamp) {
-    std::vector<T> newarr(arr.size());
-    for (int i = 0; i < revamp.size(); i++) {
+    std::vector<T> newarr(revamp.size());
+    parallel_for(revamp.size(), [&] (size_t i) {
         newarr[i] = arr[revamp[i]];
-    }
+    });
     std::swap(arr, newarr);
 }
 
@@ -24,55 +27,63 @@ struct PrimWeld : INode {
         auto tagAttr = get_input<StringObject>("tagAttr")->get();
         auto isAverage = get_input<StringObject>("method")->get() == "average";
 
-        std::unordered_multimap<int, int> lut;
+        // group the vertices by tag with a stable sort, so each group is a
+        // run listing its vertices in increasing order, the first one kept;
+        // flipping the sign bit orders negative tags before positive ones
         auto &tag = prim->verts.attr<int>(tagAttr);
-        for (int i = 0; i < prim->size(); i++) {
-            lut.insert({tag[i], i});
-        }
-        std::vector<int> revamp;
-        std::vector<int> unrevamp(prim->size());
-        revamp.resize(lut.size());
-        int nrevamp = 0;
-        for (auto it = lut.begin(); it != lut.end();) {
-            auto nit = std::find_if(std::next(it), lut.end(), [val = it->first] (auto const &p) {
-                return p.first != val;
-            });
-            auto start = it->second;
-            if (isAverage) {
-                vec3f average = prim->verts[start];
-                int count = 1;
-                for (++it; it != nit; ++it) {
-                    unrevamp[it->second] = nrevamp;
-                    auto pos = prim->verts[it->second];
-                    average += pos;
-                    ++count;
-                }
-                average *= 1 / (float)count;
-                prim->verts[start] = average;
-            } else {
-                for (; it != nit; ++it) {
-                    //printf("(%d) %d -> %d\n", it->first, it->second, nrevamp);
-                    unrevamp[it->second] = nrevamp;
-                    // unrevamp[old_coor] = new_coor
-                }
+        size_t n = prim->size();
+        std::vector<std::uint32_t> keys(n);
+        std::vector<int> order(n);
+        parallel_for(n, [&] (size_t i) {
+            keys[i] = std::uint32_t(tag[i]) ^ 0x80000000u;
+            order[i] = (int)i;
+        });
+        parallel_radix_sort(keys, order);
+
+        std::vector<int> groupOf(n);
+        parallel_inclusive_scan_sum(counter_iterator<size_t>(0), counter_iterator<size_t>(n),
+                                    groupOf.begin(), [&] (size_t i) {
+            return int(i == 0 || keys[i] != keys[i - 1]);
+        });
+        int nrevamp = n ? groupOf[n - 1] : 0;
+
+        std::vector<int> groupStart(nrevamp + 1);
+        std::vector<int> revamp(nrevamp);
+        std::vector<int> unrevamp(n);
+        parallel_for(n, [&] (size_t i) {
+            int g = groupOf[i] - 1;
+            if (i == 0 || keys[i] != keys[i - 1]) {
+                groupStart[g] = (int)i;
+                revamp[g] = order[i];
             }
-            revamp[nrevamp] = start;
-            ++nrevamp;
-        }
-        revamp.resize(nrevamp);
-        //primRevampVerts(prim.get(), revamp, &unrevamp);
+            unrevamp[order[i]] = g;
+            // unrevamp[old_coor] = new_coor
+        });
+        groupStart[nrevamp] = (int)n;
 
-        revamp_vector(prim->verts.values, revamp);
         if (isAverage) {
             prim->verts.foreach_attr<AttrAcceptAll>([&] (auto const &key, auto &arr) {
                 using T = std::decay_t<decltype(arr[0])>;
                 std::vector<T> new_arr(nrevamp);
-                for (size_t i = 0; i < arr.size(); i++) {
-                    new_arr[unrevamp[i]] += arr[i] / (T)lut.count(i);
-                }
+                parallel_for((size_t)nrevamp, [&] (size_t g) {
+                    T sum = arr[order[groupStart[g]]];
+                    for (int i = groupStart[g] + 1; i < groupStart[g + 1]; i++)
+                        sum += arr[order[i]];
+                    new_arr[g] = sum / (T)(groupStart[g + 1] - groupStart[g]);
+                });
                 arr = std::move(new_arr);
             });
+            auto &pos = prim->verts.values;
+            std::vector<vec3f> new_pos(nrevamp);
+            parallel_for((size_t)nrevamp, [&] (size_t g) {
+                vec3f sum = pos[order[groupStart[g]]];
+                for (int i = groupStart[g] + 1; i < groupStart[g + 1]; i++)
+                    sum += pos[order[i]];
+                new_pos[g] = sum * (1 / (float)(groupStart[g + 1] - groupStart[g]));
+            });
+            pos = std::move(new_pos);
         } else {
+            revamp_vector(prim->verts.values, revamp);
             prim->verts.foreach_attr<AttrAcceptAll>([&] (auto const &key, auto &arr) {
                 revamp_vector(arr, revamp);
             });
@@ -84,38 +95,38 @@ struct PrimWeld : INode {
                 x = unrevamp[x];
         };
 
-        for (size_t i = 0; i < prim->points.size(); i++) {
+        parallel_for(prim->points.size(), [&] (size_t i) {
             auto &ind = prim->points[i];
             repair(ind);
-        }
+        });
 
-        for (size_t i = 0; i < prim->lines.size(); i++) {
+        parallel_for(prim->lines.size(), [&] (size_t i) {
             auto &ind = prim->lines[i];
             repair(ind[0]);
             repair(ind[1]);
-        }
+        });
         prim->lines->erase(std::remove_if(prim->lines.begin(), prim->lines.end(), [&] (auto const &ind) {
             return ind[0] == ind[1];
         }), prim->lines.end());
         prim->lines.update();
 
-        for (size_t i = 0; i < prim->tris.size(); i++) {
+        parallel_for(prim->tris.size(), [&] (size_t i) {
             auto &ind = prim->tris[i];
             repair(ind[0]);
             repair(ind[1]);
             repair(ind[2]);
-        }
+        });
         prim->tris->erase(std::remove_if(prim->tris.begin(), prim->tris.end(), [&] (auto const &ind) {
             return ind[0] == ind[1] || ind[0] == ind[2] || ind[1] == ind[2];
         }), prim->tris.end());
 
-        for (size_t i = 0; i < prim->quads.size(); i++) {
+        parallel_for(prim->quads.size(), [&] (size_t i) {
             auto &ind = prim->quads[i];
             repair(ind[0]);
             repair(ind[1]);
             repair(ind[2]);
             repair(ind[3]);
-        }
+        });
         std::vector<uint8_t> ridquad(prim->quads.size());
         auto ridquadit = ridquad.begin();
         for (auto ind: prim->quads) {
@@ -134,10 +145,10 @@ struct PrimWeld : INode {
         }), prim->quads.end());
         prim->quads.update();
 
-        for (size_t i = 0; i < prim->loops.size(); i++) {
+        parallel_for(prim->loops.size(), [&] (size_t i) {
             auto &ind = prim->loops[i];
             repair(ind);
-        }
+        });
         for (auto &[base, len]: prim->polys) {
             auto bit = prim->loops.begin() + base;
             auto eit = prim->loops.begin() + (base + len);
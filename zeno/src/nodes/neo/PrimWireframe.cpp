@@ -1,64 +1,31 @@
 #include <zeno/zeno.h>
 #include <zeno/types/PrimitiveObject.h>
+#include <zeno/types/PrimitiveTopology.h>
 #include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/NumericObject.h>
-#include <zeno/utils/tuple_hash.h>
-#include <map>
-#include <set>
 
 namespace zeno {
 
-ZENO_API void primEdgeBound(PrimitiveObject *prim, bool removeFaces, bool toEdges) {
-    struct segment_less {
-        bool operator()(vec2i const &a, vec2i const &b) const {
-            return std::make_pair(std::min(a[0], a[1]), std::max(a[0], a[1]))
-                < std::make_pair(std::min(b[0], b[1]), std::max(b[0], b[1]));
-        }
-    };
-    std::map<vec2i, bool, segment_less> segments;
-    auto append = [&] (int i, int j) {
-        auto [it, succ] = segments.emplace(vec2i(i, j), false);
-        if (!succ) {
-            it->second = true;
-        }
-    };
-    for (auto const &ind: prim->lines) {
-        append(ind[0], ind[1]);
-    }
-    for (auto const &ind: prim->tris) {
-        append(ind[0], ind[1]);
-        append(ind[1], ind[2]);
-        append(ind[2], ind[0]);
-    }
-    for (auto const &ind: prim->quads) {
-        append(ind[0], ind[1]);
-        append(ind[1], ind[2]);
-        append(ind[2], ind[3]);
-        append(ind[3], ind[0]);
-    }
-    for (auto const &[start, len]: prim->polys) {
-        if (len < 2)
-            continue;
-        for (int i = start + 1; i < start + len; i++) {
-            append(prim->loops[i - 1], prim->loops[i]);
-        }
-        append(prim->loops[start + len - 1], prim->loops[start]);
-    }
-    if (toEdges) {
-        prim->edges.attrs.clear();
-        prim->edges.clear();
-        for (auto const &[k, v]: segments) {
-            if (!v) prim->edges.push_back(k);
+namespace {
+
+// the unique segments of lines and face sides, ordered by (min, max) vertex
+// and oriented as first met; with onlyBound, those used only once
+void primSegments(PrimitiveObject *prim, bool onlyBound, bool removeFaces, bool toEdges) {
+    auto topo = primTopology(prim);
+    std::vector<vec2i> segments;
+    if (onlyBound) {
+        for (int e = 0; e < topo->edges.size(); e++) {
+            if (topo->edgeValence(e) == 1)
+                segments.push_back(topo->edges[e]);
         }
-        prim->edges.update();
     } else {
-        prim->lines.attrs.clear();
-        for (auto const &[k, v]: segments) {
-            if (!v) prim->lines.push_back(k);
-        }
-        prim->lines.update();
+        segments = topo->edges;
     }
+    auto &arr = toEdges ? prim->edges : prim->lines;
+    arr.attrs.clear();
+    arr.values = std::move(segments);
+    arr.update();
     if (removeFaces) {
         prim->tris.clear();
         prim->quads.clear();
@@ -67,62 +34,14 @@ ZENO_API void primEdgeBound(PrimitiveObject *prim, bool removeFaces, bool toEdge
     }
 }
 
+}
+
+ZENO_API void primEdgeBound(PrimitiveObject *prim, bool removeFaces, bool toEdges) {
+    primSegments(prim, true, removeFaces, toEdges);
+}
+
 ZENO_API void primWireframe(PrimitiveObject *prim, bool removeFaces, bool toEdges) {
-    struct segment_less {
-        bool operator()(vec2i const &a, vec2i const &b) const {
-            return std::make_pair(std::min(a[0], a[1]), std::max(a[0], a[1]))
-                < std::make_pair(std::min(b[0], b[1]), std::max(b[0], b[1]));
-        }
-    };
-    std::set<vec2i, segment_less> segments;
-    auto append = [&] (int i, int j) {
-        segments.emplace(i, j);
-    };
-    for (auto const &ind: prim->lines) {
-        append(ind[0], ind[1]);
-    }
-    for (auto const &ind: prim->tris) {
-        append(ind[0], ind[1]);
-        append(ind[1], ind[2]);
-        append(ind[2], ind[0]);
-    }
-    for (auto const &ind: prim->quads) {
-        append(ind[0], ind[1]);
-        append(ind[1], ind[2]);
-        append(ind[2], ind[3]);
-        append(ind[3], ind[0]);
-    }
-    for (auto const &[start, len]: prim->polys) {
-        if (len < 2)
-            continue;
-        for (int i = start + 1; i < start + len; i++) {
-            append(prim->loops[i - 1], prim->loops[i]);
-        }
-        append(prim->loops[start + len - 1], prim->loops[start]);
-    }
-    //if (isAccumulate) {
-        //for (auto const &ind: prim->lines) {
-            //segments.erase(vec2i(ind[0], ind[1]));
-        //}
-        //prim->lines.values.insert(prim->lines.values.end(), segments.begin(), segments.end());
-        //prim->lines.update();
-    //} else {
-    if (toEdges) {
-        prim->edges.attrs.clear();
-        prim->edges.values.assign(segments.begin(), segments.end());
-        prim->edges.update();
-    } else {
-        prim->lines.attrs.clear();
-        prim->lines.values.assign(segments.begin(), segments.end());
-        prim->lines.update();
-    }
-    //}
-    if (removeFaces) {
-        prim->tris.clear();
-        prim->quads.clear();
-        prim->loops.clear();
-        prim->polys.clear();
-    }
+    primSegments(prim, false, removeFaces, toEdges);
 }
 
 namespace {
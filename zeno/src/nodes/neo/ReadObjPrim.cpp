@@ -3,23 +3,25 @@
 #include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/utils/string.h>
-#include <zeno/utils/fileio.h>
+#include <zeno/utils/mapped_file.h>
 #include <zeno/utils/logger.h>
 #include <zeno/utils/vec.h>
+#include <zeno/para/parallel_for.h>
 #include <string_view>
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
 #include <cstdio>
-#include <fstream>
+#include <cstdint>
+#include <cmath>
 
 namespace zeno {
 namespace {
 
 template <std::size_t ...Is>
-static bool match_helper(char const *&it, char const *arr, std::index_sequence<Is...>) {
-    if (((it[Is] == arr[Is]) && ...)) {
+static bool match_helper(char const *&it, char const *eit, char const *arr, std::index_sequence<Is...>) {
+    if (eit - it >= (std::ptrdiff_t)sizeof...(Is) && ((it[Is] == arr[Is]) && ...)) {
         it += sizeof...(Is);
         return true;
     } else {
@@ -28,89 +30,288 @@ static bool match_helper(char const *&it, char const *arr, std::index_sequence<I
 }
 
 template <std::size_t N>
-static bool match(char const *&it, char const (&arr)[N]) {
-    return match_helper(it, arr, std::make_index_sequence<N - 1>{});
+static bool match(char const *&it, char const *eit, char const (&arr)[N]) {
+    return match_helper(it, eit, arr, std::make_index_sequence<N - 1>{});
 }
 
-static float takef(char const *&it) {
-    char *eptr;
-    float val = std::strtof(it, &eptr);
-    it = eptr;
-    return val;
+static void skipws(char const *&it, char const *eit) {
+    while (it != eit && (*it == ' ' || *it == '\t'))
+        ++it;
 }
 
-static int takeu(char const *&it) {
-    char *eptr;
-    int val(std::strtoul(it, &eptr, 10));
-    it = eptr;
-    return val;
+static bool is_digit(char c) {
+    return (unsigned)(c - '0') < 10;
 }
 
-std::shared_ptr<PrimitiveObject> parse_obj(std::vector<char> &&bin) {
-    /*bin.resize(bin.size() + 8, '\0');*/
+// decimal float, independent of the locale unlike strtof; the significand
+// keeps 17 digits, plenty for a float. anything else (inf, nan...) goes
+// through strtof
+static float takef(char const *&it, char const *eit) {
+    skipws(it, eit);
+    auto beg = it;
+    bool neg = false;
+    if (it != eit && (*it == '-' || *it == '+'))
+        neg = *it++ == '-';
+    std::uint64_t mant = 0;
+    int exp10 = 0;
+    bool any = false;
+    for (; it != eit && is_digit(*it); ++it, any = true) {
+        if (mant < 10000000000000000ull)
+            mant = mant * 10 + (*it - '0');
+        else
+            ++exp10;
+    }
+    if (it != eit && *it == '.') {
+        for (++it; it != eit && is_digit(*it); ++it, any = true) {
+            if (mant < 10000000000000000ull) {
+                mant = mant * 10 + (*it - '0');
+                --exp10;
+            }
+        }
+    }
+    if (!any) {
+        char buf[32]{};
+        std::copy_n(beg, std::min<std::ptrdiff_t>(eit - beg, sizeof(buf) - 1), buf);
+        char *eptr;
+        float val = std::strtof(buf, &eptr);
+        it = beg + (eptr - buf);
+        return val;
+    }
+    if (it != eit && (*it == 'e' || *it == 'E')) {
+        auto eit0 = it++;
+        bool eneg = false;
+        if (it != eit && (*it == '-' || *it == '+'))
+            eneg = *it++ == '-';
+        if (it == eit || !is_digit(*it)) {
+            it = eit0;
+        } else {
+            int e = 0;
+            for (; it != eit && is_digit(*it); ++it)
+                e = std::min(e * 10 + (*it - '0'), 100000);
+            exp10 += eneg ? -e : e;
+        }
+    }
+    static constexpr double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    double val = (double)mant;
+    if (val != 0) {
+        if (exp10 < 0 && exp10 >= -22)
+            val /= pow10[-exp10];
+        else if (exp10 > 0 && exp10 <= 22)
+            val *= pow10[exp10];
+        else if (exp10)
+            val *= std::pow(10.0, (double)exp10);
+    }
+    return (float)(neg ? -val : val);
+}
 
-    char const *it = bin.data();
-    char const *eit = bin.data() + bin.size();// - 8;
+static int takei(char const *&it, char const *eit) {
+    bool neg = false;
+    if (it != eit && *it == '-') {
+        neg = true;
+        ++it;
+    }
+    int val = 0;
+    for (; it != eit && is_digit(*it); ++it)
+        val = val * 10 + (*it - '0');
+    return neg ? -val : val;
+}
 
-    auto prim = std::make_shared<PrimitiveObject>();
+// what one line-aligned chunk of the file declares, with polys starting at
+// its own loops; obj indices are 1-based, or relative to the end when
+// negative, and those are kept relative to the chunk's own elements, with
+// their places listed so the stitching can rebase them
+struct ObjChunk {
+    std::vector<vec3f> verts;
+    std::vector<vec2f> uvs;
+    std::vector<vec3f> nrms;
+    std::vector<int> loops;
     std::vector<int> loop_uvs;
+    std::vector<vec2i> polys;
+    std::vector<vec2i> lines;
+    std::vector<int> relLoops;
+    std::vector<int> relLoopUVs;
+    std::vector<int> relLines;
+
+    void parse(char const *it, char const *eit) {
+        while (it < eit) {
+            auto nit = std::find(it, eit, '\n');
+            auto lit = nit != it && nit[-1] == '\r' ? nit - 1 : nit;
+
+            if (match(it, lit, "v ")) {
+                float x = takef(it, lit);
+                float y = takef(it, lit);
+                float z = takef(it, lit);
+                verts.emplace_back(x, y, z);
 
-    while (it < eit) {
-        auto nit = std::find(it, eit, '\n');
-
-        if (match(it, "v ")) {
-            float x = takef(it);
-            float y = takef(it);
-            float z = takef(it);
-            prim->verts.emplace_back(x, y, z);
-
-        } else if (match(it, "vt ")) {
-            float x = takef(it);
-            float y = takef(it);
-            prim->uvs.emplace_back(x, y);
-
-        } else if (match(it, "f ")) {
-            int beg = prim->loops.size();
-            int cnt{};
-            while (it != nit) {
-                int x = takeu(it) - 1;
-                if (*it == '/' && it[1] != '/') {
-                    ++it;
-                    int xt = takeu(it) - 1;
-                    loop_uvs.push_back(xt);
+            } else if (match(it, lit, "vt ")) {
+                float x = takef(it, lit);
+                float y = takef(it, lit);
+                uvs.emplace_back(x, y);
+
+            } else if (match(it, lit, "vn ")) {
+                float x = takef(it, lit);
+                float y = takef(it, lit);
+                float z = takef(it, lit);
+                nrms.emplace_back(x, y, z);
+
+            } else if (match(it, lit, "f ")) {
+                int beg = loops.size();
+                int cnt{};
+                skipws(it, lit);
+                while (it != lit && (*it == '-' || is_digit(*it))) {
+                    int x = takei(it, lit);
+                    if (x < 0) {
+                        relLoops.push_back(loops.size());
+                        x += verts.size();
+                    } else {
+                        x -= 1;
+                    }
+                    if (it != lit && *it == '/' && it + 1 != lit && it[1] != '/') {
+                        ++it;
+                        int xt = takei(it, lit);
+                        if (xt < 0) {
+                            relLoopUVs.push_back(loop_uvs.size());
+                            xt += uvs.size();
+                        } else {
+                            xt -= 1;
+                        }
+                        loop_uvs.push_back(xt);
+                    }
+                    it = std::find_if(it, lit, [] (char c) { return c == ' ' || c == '\t'; });
+                    loops.push_back(x);
+                    ++cnt;
+                    skipws(it, lit);
                 }
-                it = std::find(it, nit, ' ');
-                prim->loops.push_back(x);
-                ++cnt;
-                it = std::find_if(it, nit, [] (char c) { return c != ' '; });
-            }
-            prim->polys.emplace_back(beg, cnt);
+                polys.emplace_back(beg, cnt);
 
-        } else if (match(it, "l")) {
-            int x = takeu(it) - 1;
-            int y = takeu(it) - 1;
-            prim->lines.emplace_back(x, y);
+            } else if (match(it, lit, "l ")) {
+                int prev{}, cnt{};
+                bool prevRel{};
+                skipws(it, lit);
+                while (it != lit && (*it == '-' || is_digit(*it))) {
+                    int x = takei(it, lit);
+                    bool rel = x < 0;
+                    x += rel ? verts.size() : -1;
+                    if (cnt++) {
+                        if (prevRel)
+                            relLines.push_back(2 * lines.size());
+                        if (rel)
+                            relLines.push_back(2 * lines.size() + 1);
+                        lines.emplace_back(prev, x);
+                    }
+                    prev = x;
+                    prevRel = rel;
+                    it = std::find_if(it, lit, [] (char c) { return c == ' ' || c == '\t'; });
+                    skipws(it, lit);
+                }
 
-        //} else if (match(it, "o ")) {
-            // todo: support tag verts to be multi components of primitive
-            //std::string_view o_name(it, nit - it);
+            //} else if (match(it, "o ")) {
+                // todo: support tag verts to be multi components of primitive
+                //std::string_view o_name(it, nit - it);
 
+            }
+            it = nit + 1;
         }
-        it = nit + 1;
     }
+};
+
+// the chunks are split at line ends and parsed concurrently, then copied
+// into place at the prefix sums of their counts
+std::shared_ptr<PrimitiveObject> parse_obj(char const *data, std::size_t size, std::vector<vec3f> *nrms = nullptr) {
+    constexpr std::size_t chunkSize = 1 << 22;
+    std::vector<char const *> bounds{data};
+    for (std::size_t i = chunkSize; i < size; i += chunkSize) {
+        auto it = std::max(data + i, bounds.back());
+        it = std::find(it, data + size, '\n');
+        if (it == data + size)
+            break;
+        bounds.push_back(it + 1);
+    }
+    bounds.push_back(data + size);
+    std::size_t nchunks = bounds.size() - 1;
+
+    std::vector<ObjChunk> chunks(nchunks);
+    parallel_for(nchunks, [&] (std::size_t c) {
+        chunks[c].parse(bounds[c], bounds[c + 1]);
+    });
 
-    if (loop_uvs.size() == prim->loops.size()) {
-        prim->loop_uvs = std::move(loop_uvs);
+    struct Offsets {
+        std::size_t verts{}, uvs{}, nrms{}, loops{}, loop_uvs{}, polys{}, lines{};
+    };
+    std::vector<Offsets> offsets(nchunks + 1);
+    for (std::size_t c = 0; c < nchunks; c++) {
+        auto const &ch = chunks[c];
+        auto o = offsets[c];
+        o.verts += ch.verts.size();
+        o.uvs += ch.uvs.size();
+        o.nrms += ch.nrms.size();
+        o.loops += ch.loops.size();
+        o.loop_uvs += ch.loop_uvs.size();
+        o.polys += ch.polys.size();
+        o.lines += ch.lines.size();
+        offsets[c + 1] = o;
+    }
+    auto const &total = offsets[nchunks];
+
+    auto prim = std::make_shared<PrimitiveObject>();
+    prim->verts.resize(total.verts);
+    prim->uvs.resize(total.uvs);
+    prim->loops.resize(total.loops);
+    prim->polys.resize(total.polys);
+    prim->lines.resize(total.lines);
+    // uvs are only kept when every corner has one
+    bool hasLoopUVs = total.loop_uvs == total.loops;
+    std::vector<int> loop_uvs(hasLoopUVs ? total.loop_uvs : 0);
+    if (nrms)
+        nrms->resize(total.nrms);
+
+    parallel_for(nchunks, [&] (std::size_t c) {
+        auto &ch = chunks[c];
+        auto const &o = offsets[c];
+        std::copy(ch.verts.begin(), ch.verts.end(), prim->verts.begin() + o.verts);
+        std::copy(ch.uvs.begin(), ch.uvs.end(), prim->uvs.begin() + o.uvs);
+        if (nrms)
+            std::copy(ch.nrms.begin(), ch.nrms.end(), nrms->begin() + o.nrms);
+        std::copy(ch.loops.begin(), ch.loops.end(), prim->loops.begin() + o.loops);
+        for (int i: ch.relLoops)
+            prim->loops[o.loops + i] += o.verts;
+        if (hasLoopUVs) {
+            std::copy(ch.loop_uvs.begin(), ch.loop_uvs.end(), loop_uvs.begin() + o.loop_uvs);
+            for (int i: ch.relLoopUVs)
+                loop_uvs[o.loop_uvs + i] += o.uvs;
+        }
+        std::transform(ch.polys.begin(), ch.polys.end(), prim->polys.begin() + o.polys, [&] (vec2i const &poly) {
+            return vec2i(poly[0] + o.loops, poly[1]);
+        });
+        std::copy(ch.lines.begin(), ch.lines.end(), prim->lines.begin() + o.lines);
+        for (int i: ch.relLines)
+            prim->lines[o.lines + i / 2][i % 2] += o.verts;
+        ch = {};
+    });
+
+    if (hasLoopUVs) {
+        prim->loop_uvs.values = std::move(loop_uvs);
     }
 
     return prim;
 }
 
+}
+
+ZENO_API std::shared_ptr<PrimitiveObject> primReadObj(std::string const &path, std::vector<vec3f> *nrms) {
+    mapped_file file(path);
+    return parse_obj(file.data(), file.size(), nrms);
+}
+
+namespace {
+
 struct ReadObjPrim : INode {
     virtual void apply() override {
         auto path = get_input<StringObject>("path")->get();
-        auto binary = file_get_binary<std::vector<char>>(path);
-        auto prim = parse_obj(std::move(binary));
+        auto prim = primReadObj(path);
         if (get_param<bool>("decodeUVs")) {
             primDecodeUVs(prim.get());
         }
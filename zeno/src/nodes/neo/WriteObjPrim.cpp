@@ -3,60 +3,76 @@
 #include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/utils/string.h>
-#include <zeno/utils/fileio.h>
-#include <zeno/utils/logger.h>
+#include <zeno/utils/Error.h>
 #include <zeno/utils/vec.h>
+#include <zeno/para/parallel_text_write.h>
 #include <string_view>
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
 #include <cstdio>
-#include <fstream>
+#include <type_traits>
 
 namespace zeno {
 namespace {
 
-void dump_obj(PrimitiveObject *prim, std::ostream &fout) {
-    fout << "# https://github.com/zenustech/zeno\n";
-    for (auto const &[x, y, z]: prim->verts) {
-        fout << "v " << x << ' ' << y << ' ' << z << '\n';
+// with `polygonate`, the tris, quads, lines and points are written as faces
+// too, after the polys, as primPolygonate would order them, but without
+// touching the prim
+bool dump_obj(PrimitiveObject const *prim, std::FILE *fp, bool polygonate) {
+    std::fputs("# https://github.com/zenustech/zeno\n", fp);
+    bool ok = parallel_text_write(fp, prim->verts.size(), [&] (text_buffer &buf, size_t i) {
+        buf << "v ";
+        buf.append(prim->verts[i]) << '\n';
+    });
+    bool hasUVs = prim->loops.size() && prim->loop_uvs.size() == prim->loops.size();
+    if (hasUVs) {
+        ok = ok && parallel_text_write(fp, prim->uvs.size(), [&] (text_buffer &buf, size_t i) {
+            buf << "vt ";
+            buf.append(prim->uvs[i]) << '\n';
+        });
     }
-    if (prim->loops.size() && prim->loop_uvs.size()) {
-        auto &loop_uvs = prim->loop_uvs;
-        for (auto const &[x, y]: prim->uvs) {
-            fout << "vt " << x << ' ' << y << '\n';
-        }
-        for (auto const &[base, len]: prim->polys) {
-            fout << 'f';
-            for (int j = base; j < base + len; j++) {
-                auto l = prim->loops[j] + 1;
-                auto lt = loop_uvs[j] + 1;
-                fout << ' ' << l << '/' << lt;
-            }
-            fout << '\n';
-        }
-    } else {
-        for (auto const &[base, len]: prim->polys) {
-            fout << 'f';
-            for (int j = base; j < base + len; j++) {
-                auto l = prim->loops[j] + 1;
-                fout << ' ' << l;
-            }
-            fout << '\n';
+    ok = ok && parallel_text_write(fp, prim->polys.size(), [&] (text_buffer &buf, size_t i) {
+        auto [base, len] = prim->polys[i];
+        buf << 'f';
+        for (int j = base; j < base + len; j++) {
+            buf << ' ' << prim->loops[j] + 1;
+            if (hasUVs)
+                buf << '/' << prim->loop_uvs[j] + 1;
         }
+        buf << '\n';
+    });
+    if (polygonate) {
+        auto dump_faces = [&] (auto const &faces) {
+            return parallel_text_write(fp, faces.size(), [&] (text_buffer &buf, size_t i) {
+                buf << "f ";
+                if constexpr (std::is_same_v<std::decay_t<decltype(faces[i])>, int>)
+                    buf << faces[i] + 1;
+                else
+                    buf.append(faces[i] + 1);
+                buf << '\n';
+            });
+        };
+        ok = ok && dump_faces(prim->tris.values) && dump_faces(prim->quads.values)
+            && dump_faces(prim->lines.values) && dump_faces(prim->points.values);
     }
+    return ok;
 }
 
 struct WriteObjPrim : INode {
     virtual void apply() override {
         auto prim = get_input<PrimitiveObject>("prim");
         auto path = get_input<StringObject>("path")->get();
-        if (get_param<bool>("polygonate")) {
-            primPolygonate(prim.get());
+        std::FILE *fp = std::fopen(path.c_str(), "wb");
+        if (!fp) {
+            throw makeError("cannot open file for write: " + path);
+        }
+        bool ok = dump_obj(prim.get(), fp, get_param<bool>("polygonate"));
+        ok = !std::fclose(fp) && ok;
+        if (!ok) {
+            throw makeError("failed to write file: " + path);
         }
-        std::ofstream fout(path);
-        dump_obj(prim.get(), fout);
         set_output("prim", std::move(prim));
     }
 };
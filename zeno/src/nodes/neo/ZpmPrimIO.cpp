@@ -0,0 +1,61 @@
+#include <zeno/zeno.h>
+#include <zeno/types/PrimitiveObject.h>
+#include <zeno/types/StringObject.h>
+#include <zeno/funcs/PrimitiveIO.h>
+#include <zeno/utils/string.h>
+#include <algorithm>
+
+namespace zeno {
+namespace {
+
+struct WriteZpmPrim : INode {
+    virtual void apply() override {
+        auto prim = get_input<PrimitiveObject>("prim");
+        auto path = get_input2<std::string>("path");
+        if (!writezpm(prim.get(), path.c_str(), get_input2<bool>("compress"))) {
+            throw makeError("failed to write zpm file: " + path);
+        }
+        set_output("prim", std::move(prim));
+    }
+};
+
+ZENDEFNODE(WriteZpmPrim, {
+    {
+        {"primitive", "prim"},
+        {"writepath", "path"},
+        {"bool", "compress", "1"},
+    },
+    {
+        {"primitive", "prim"},
+    },
+    {},
+    {"primitive"},
+});
+
+struct ReadZpmPrim : INode {
+    virtual void apply() override {
+        auto path = get_input2<std::string>("path");
+        auto attrs = split_str(get_input2<std::string>("attrs"), ' ');
+        attrs.erase(std::remove(attrs.begin(), attrs.end(), std::string()), attrs.end());
+        auto prim = std::make_shared<PrimitiveObject>();
+        if (!readzpm(prim.get(), path.c_str(), attrs.empty() ? nullptr : &attrs)) {
+            throw makeError("failed to read zpm file: " + path);
+        }
+        set_output("prim", std::move(prim));
+    }
+};
+
+ZENDEFNODE(ReadZpmPrim, {
+    {
+        {"readpath", "path"},
+        {"string", "attrs", ""},
+    },
+    {
+        {"primitive", "prim"},
+    },
+    {},
+    {"primitive"},
+});
+
+}
+}
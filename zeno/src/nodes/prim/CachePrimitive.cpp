@@ -1,5 +1,5 @@
 #include <zeno/zeno.h>
-#include <zeno/types/PrimitiveIO.h>
+#include <zeno/funcs/PrimitiveIO.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/NumericObject.h>
 #include <filesystem>
@@ -4,133 +4,68 @@
 #include <zeno/types/NumericObject.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/utils/vec.h>
-#include <cstring>
-#include <cstdlib>
-#include <cassert>
-#if defined(_OPENMP) && defined(__GNUG__)
-#include <omp.h>
-#endif
+#include <zeno/types/PrimitiveTopology.h>
+#include <zeno/para/parallel_for.h>
+#include <cmath>
 
 namespace zeno {
-// for parallel atomic float add
-template <typename DstT, typename SrcT> constexpr auto reinterpret_bits(SrcT &&val) {
-    using Src = std::remove_cv_t<std::remove_reference_t<SrcT>>;
-    using Dst = std::remove_cv_t<std::remove_reference_t<DstT>>;
-    static_assert(sizeof(Src) == sizeof(Dst),
-                  "Source Type and Destination Type must be of the same size");
-    return reinterpret_cast<Dst const volatile &>(val);
-  }
-ZENO_API void primCalcNormal(zeno::PrimitiveObject* prim, float flip, std::string nrmAttr)
-{
-    auto &nrm = prim->add_attr<zeno::vec3f>(nrmAttr);
-    auto &pos = prim->verts.values;
-
-#if defined(_OPENMP) && defined(__GNUG__)
-#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < nrm.size(); i++) {
-        nrm[i] = zeno::vec3f(0);
-    }
-
-#if defined(_OPENMP) && defined(__GNUG__)
-    auto atomicCas = [](int* dest, int expected, int desired) {
-        __atomic_compare_exchange_n(const_cast<int volatile *>(dest), &expected,
-                                    desired, false, __ATOMIC_ACQ_REL,
-                                    __ATOMIC_RELAXED);
-        return expected;
-    };
-    auto atomicFloatAdd = [&](float*dst, float val) {
-        static_assert(sizeof(float) == sizeof(int), "sizeof float != sizeof int");
-        int oldVal = reinterpret_bits<int>(*dst);
-        int newVal = reinterpret_bits<int>(reinterpret_bits<float>(oldVal) + val), readVal{};
-        while ((readVal = atomicCas((int*)dst, oldVal, newVal)) != oldVal) {
-            oldVal = readVal;
-            newVal = reinterpret_bits<int>(reinterpret_bits<float>(readVal) + val);
-        }
-        return reinterpret_bits<float>(oldVal);
-    };
-#endif
-
-#if defined(_OPENMP) && defined(__GNUG__)
-#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < prim->tris.size(); i++) {
-        auto ind = prim->tris[i];
-        auto n = cross(pos[ind[1]] - pos[ind[0]], pos[ind[2]] - pos[ind[0]]);
-
-#if defined(_OPENMP) && defined(__GNUG__)
-        for (int j = 0; j != 3; ++j) {
-            auto &n_i = nrm[ind[j]];
-            for (int d = 0; d != 3; ++d)
-                atomicFloatAdd(&n_i[d], n[d]);
-        }
-#else
-        nrm[ind[0]] += n;
-        nrm[ind[1]] += n;
-        nrm[ind[2]] += n;
-#endif
-    }
 
-#if defined(_OPENMP) && defined(__GNUG__)
-#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < prim->quads.size(); i++) {
-        auto ind = prim->quads[i];
-        std::array<vec3f, 4> ns = {
-            cross(pos[ind[1]] - pos[ind[0]], pos[ind[2]] - pos[ind[0]]),
-            cross(pos[ind[2]] - pos[ind[1]], pos[ind[3]] - pos[ind[1]]),
-            cross(pos[ind[3]] - pos[ind[2]], pos[ind[0]] - pos[ind[2]]),
-            cross(pos[ind[0]] - pos[ind[3]], pos[ind[1]] - pos[ind[3]]),
-        };
-
-#if defined(_OPENMP) && defined(__GNUG__)
-        for (int j = 0; j != 4; ++j) {
-            auto &n_i = nrm[ind[j]];
-            for (int d = 0; d != 3; ++d)
-                atomicFloatAdd(&n_i[d], ns[j][d]);
-        }
-#else
-        for (int j = 0; j != 4; ++j) {
-            nrm[ind[j]] += ns[j];
-        }
-#endif
-    }
+ZENO_API void primCalcNormal(zeno::PrimitiveObject* prim, float flip, std::string nrmAttr, std::string weightType)
+{
+    enum { area, angle, uniform } weight;
+    if (weightType == "area")
+        weight = area;
+    else if (weightType == "angle")
+        weight = angle;
+    else if (weightType == "uniform")
+        weight = uniform;
+    else
+        throw makeError("invalid weightType: " + weightType);
 
-#if defined(_OPENMP) && defined(__GNUG__)
-#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < prim->polys.size(); i++) {
-        auto [beg, len] = prim->polys[i];
+    auto topo = primTopology(prim);
+    auto &nrm = prim->add_attr<zeno::vec3f>(nrmAttr);
+    auto const &pos = prim->verts.values;
 
-        auto ind = [loops = prim->loops.data(), beg = beg, len = len] (int t) -> int {
-            if (t >= len) t -= len;
-            return loops[beg + t];
+    // weighted normal at every corner, then each vertex gathers its corners
+    // in a fixed order: no atomics, and the same bits for any thread count
+    std::vector<vec3f> cornerNrm(topo->numCorners());
+    parallel_for(topo->numFaces(), [&] (int f) {
+        int base = topo->faceOffsets[f], len = topo->faceSize(f);
+        auto ind = [&] (int t) -> int {
+            return topo->faceVerts[base + t % len];
         };
-        for (int j = 0; j < len; ++j) {
-            auto nsj = cross(pos[ind(j + 1)] - pos[ind(j)], pos[ind(j + 2)] - pos[ind(j)]);
-#if defined(_OPENMP) && defined(__GNUG__)
-            auto &n_i = nrm[ind(j)];
-            for (int d = 0; d != 3; ++d)
-                atomicFloatAdd(&n_i[d], nsj[d]);
-#else
-            nrm[ind(j)] += nsj;
-#endif
+        vec3f triNrm;
+        if (f < topo->numTris)
+            triNrm = cross(pos[ind(1)] - pos[ind(0)], pos[ind(2)] - pos[ind(0)]);
+        for (int j = 0; j < len; j++) {
+            auto n = f < topo->numTris ? triNrm
+                : cross(pos[ind(j + 1)] - pos[ind(j)], pos[ind(j + 2)] - pos[ind(j)]);
+            if (weight == angle) {
+                auto e1 = pos[ind(j + 1)] - pos[ind(j)];
+                auto e2 = pos[ind(j + len - 1)] - pos[ind(j)];
+                n = normalizeSafe(n) * std::atan2(length(cross(e1, e2)), dot(e1, e2));
+            } else if (weight == uniform) {
+                n = normalizeSafe(n);
+            }
+            cornerNrm[base + j] = n;
         }
-    }
+    });
 
-#if defined(_OPENMP) && defined(__GNUG__)
-#pragma omp parallel for
-#endif
-    for (size_t i = 0; i < nrm.size(); i++) {
-        nrm[i] = flip * normalizeSafe(nrm[i]);
-    }
+    parallel_for(nrm.size(), [&] (size_t v) {
+        vec3f n(0);
+        for (int i = topo->vertFaceOffsets[v]; i < topo->vertFaceOffsets[v + 1]; i++)
+            n += cornerNrm[topo->vertCorners[i]];
+        nrm[v] = flip * normalizeSafe(n);
+    });
 }
+
 struct PrimitiveCalcNormal : zeno::INode {
     virtual void apply() override {
         auto prim = get_input<PrimitiveObject>("prim");
         auto nrmAttr = get_input<StringObject>("nrmAttr")->get();
         auto flip = get_input<NumericObject>("flip")->get<bool>();
-        primCalcNormal(prim.get(), flip ? -1 : 1, nrmAttr);
+        auto weightType = get_input2<std::string>("weightType");
+        primCalcNormal(prim.get(), flip ? -1 : 1, nrmAttr, weightType);
         set_output("prim", get_input("prim"));
     }
 };
@@ -140,6 +75,7 @@ ZENDEFNODE(PrimitiveCalcNormal, {
     {"prim"},
     {"string", "nrmAttr", "nrm"},
     {"bool", "flip", "0"},
+    {"enum area angle uniform", "weightType", "area"},
     },
     {"prim"},
     {},
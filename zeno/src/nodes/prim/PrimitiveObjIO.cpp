@@ -3,6 +3,7 @@
 #include <zeno/types/DictObject.h>
 #include <zeno/types/StringObject.h>
 #include <zeno/types/PrimitiveTools.h>
+#include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/utils/string.h>
 #include <zeno/utils/logger.h>
 #include <zeno/utils/vec.h>
@@ -10,6 +11,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <cstdio>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -41,51 +43,29 @@ static zeno::vec3f read_vec3f(std::vector<std::string> items) {
     return vec;
 }
 
+// the vt and vn lists become the uv and nrm attributes, in file order, and
+// the faces are split into fans
 void read_obj_file(
         std::vector<zeno::vec3f> &vertices,
         std::vector<zeno::vec3f> &uvs,
         std::vector<zeno::vec3f> &normals,
         std::vector<zeno::vec3i> &indices,
-        //std::vector<zeno::vec3i> &uv_indices,
-        //std::vector<zeno::vec3i> &normal_indices,
         const char *path)
 {
-
-
-    auto is = std::ifstream(path);
-    while (!is.eof()) {
-        std::string line;
-        std::getline(is, line);
-        line = zeno::trim_string(line);
-        if (line.empty()) {
-            continue;
-        }
-        auto items = zeno::split_str(line, ' ');
-        items.erase(items.begin());
-
-        if (zeno::starts_with(line, "v ")) {
-            vertices.push_back(read_vec3f(items));
-
-        } else if (zeno::starts_with(line, "vt ")) {
-            uvs.push_back(read_vec3f(items));
-
-        } else if (zeno::starts_with(line, "vn ")) {
-            normals.push_back(read_vec3f(items));
-
-        } else if (zeno::starts_with(line, "f ")) {
-            zeno::vec3i first_index = read_index(items[0]);
-            zeno::vec3i last_index = read_index(items[1]);
-
-            for (auto i = 2; i < items.size(); i++) {
-                zeno::vec3i index = read_index(items[i]);
-                zeno::vec3i face(first_index[0], last_index[0], index[0]);
-                //zeno::vec3i face_uv(first_index[1], last_index[1], index[1]);
-                //zeno::vec3i face_normal(first_index[2], last_index[2], index[2]);
-                indices.push_back(face);
-                //uv_indices.push_back(face_uv);
-                //normal_indices.push_back(face_normal);
-                last_index = index;
-            }
+    auto obj = primReadObj(path, &normals);
+    vertices = std::move(obj->verts.values);
+    uvs.resize(obj->uvs.size());
+    for (size_t i = 0; i < obj->uvs.size(); i++) {
+        uvs[i] = zeno::vec3f(obj->uvs[i][0], obj->uvs[i][1], 0);
+    }
+    size_t ntris = 0;
+    for (auto const &[start, len]: obj->polys) {
+        ntris += std::max(len - 2, 0);
+    }
+    indices.reserve(ntris);
+    for (auto const &[start, len]: obj->polys) {
+        for (int i = 2; i < len; i++) {
+            indices.emplace_back(obj->loops[start], obj->loops[start + i - 1], obj->loops[start + i]);
         }
     }
 }
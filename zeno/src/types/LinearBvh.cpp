@@ -0,0 +1,982 @@
+#include <zeno/types/LinearBvh.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+#include <stdexcept>
+#include <zeno/para/parallel_radix_sort.h>
+#include <zeno/utils/morton.h>
+#include <zeno/zeno.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace zeno {
+
+namespace {
+
+template <LBvh::element_e et>
+auto const &element_indices(const PrimitiveObject &prim) {
+  if constexpr (et == LBvh::element_e::tet)
+    return prim.quads.values;
+  else if constexpr (et == LBvh::element_e::tri)
+    return prim.tris.values;
+  else if constexpr (et == LBvh::element_e::line)
+    return prim.lines.values;
+  else
+    return prim.points.values;
+}
+
+// box of one element inflated by thickness, resolved at compile time so the
+// build and refit loops inline it instead of calling through a std::function
+template <LBvh::element_e et>
+LBvh::Box element_bv(const PrimitiveObject &prim, const std::vector<vec3f> &refpos,
+                     LBvh::Ti eid, float thickness) {
+  constexpr auto ma = std::numeric_limits<float>::max();
+  constexpr auto mi = std::numeric_limits<float>::lowest();
+  LBvh::Box bv{vec3f{ma, ma, ma}, vec3f{mi, mi, mi}};
+  auto expand = [&](const vec3f &p) {
+    for (int d = 0; d != 3; ++d) {
+      if (p[d] - thickness < bv.first[d])
+        bv.first[d] = p[d] - thickness;
+      if (p[d] + thickness > bv.second[d])
+        bv.second[d] = p[d] + thickness;
+    }
+  };
+  auto ind = element_indices<et>(prim)[eid];
+  if constexpr (et == LBvh::element_e::point) {
+    expand(refpos[ind]);
+  } else {
+    for (int j = 0; j != std::tuple_size_v<decltype(ind)>; ++j)
+      expand(refpos[ind[j]]);
+  }
+  return bv;
+}
+
+template <LBvh::element_e et>
+vec3f element_center(const PrimitiveObject &prim,
+                     const std::vector<vec3f> &refpos, LBvh::Ti eid) {
+  auto ind = element_indices<et>(prim)[eid];
+  if constexpr (et == LBvh::element_e::point) {
+    return refpos[ind];
+  } else {
+    constexpr int n = std::tuple_size_v<decltype(ind)>;
+    vec3f c = refpos[ind[0]];
+    for (int j = 1; j != n; ++j)
+      c += refpos[ind[j]];
+    return c / (float)n;
+  }
+}
+
+// 63-bit morton code of p inside box, 21 bits per axis
+inline std::uint64_t morton_code(const vec3f &p, const LBvh::Box &box) {
+  const auto lengths = box.second - box.first;
+  const auto offsets = p - box.first;
+  std::uint64_t uc[3];
+  for (int d = 0; d != 3; ++d) {
+    float u = lengths[d] > 0 ? std::clamp(offsets[d] / lengths[d], 0.f, 1.f)
+                             : 0.f;
+    uc[d] = (std::uint64_t)(u * (float)((1 << 21) - 1));
+  }
+  return morton3d::encode(uc[2], uc[1], uc[0]);
+}
+
+template <LBvh::element_e et>
+float element_dist_sqr(const PrimitiveObject &prim,
+                       const std::vector<vec3f> &refpos, LBvh::Ti eid,
+                       const vec3f &pos, vec3f &ws) {
+  if constexpr (et == LBvh::element_e::point) {
+    return dist_pp_sqr(refpos[prim.points[eid]], pos, ws);
+  } else if constexpr (et == LBvh::element_e::line) {
+    auto line = prim.lines[eid];
+    return dist_pe_sqr(pos, refpos[line[0]], refpos[line[1]], ws);
+  } else if constexpr (et == LBvh::element_e::tri) {
+    auto tri = prim.tris[eid];
+    return dist_pt_sqr(pos, refpos[tri[0]], refpos[tri[1]], refpos[tri[2]], ws);
+  } else {
+    // the weights returned are those of the closest face
+    static constexpr int faces[4][3] = {{0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3}};
+    auto tet = prim.quads[eid];
+    float ret = std::numeric_limits<float>::max();
+    for (auto const &f: faces) {
+      vec3f w;
+      float d = dist_pt_sqr(pos, refpos[tet[f[0]]], refpos[tet[f[1]]],
+                            refpos[tet[f[2]]], w);
+      if (d < ret) {
+        ret = d;
+        ws = w;
+      }
+    }
+    return ret;
+  }
+}
+
+// nearest element on the binary tree, pruning with the signed box distance
+template <LBvh::element_e et>
+vec3f nearest_binary(const LBvh &bvh, const PrimitiveObject &prim,
+                     const std::vector<vec3f> &refpos, const vec3f &pos,
+                     LBvh::Ti &id, float &dist) {
+  using Ti = LBvh::Ti;
+  const Ti numNodes = bvh.sortedBvs.size();
+  Ti node = 0;
+  vec3f ws{0.f, 0.f, 0.f};
+  vec3f wsTmp{0.f, 0.f, 0.f};
+  while (node != -1 && node != numNodes) {
+    Ti level = bvh.levels[node];
+    // level and node are always in sync
+    for (; level; --level, ++node)
+      if (auto d = LBvh::distance(bvh.sortedBvs[node], pos); d > dist)
+        break;
+    // leaf node check
+    if (level == 0) {
+      const auto eid = bvh.auxIndices[node];
+      float d =
+          std::sqrt(element_dist_sqr<et>(prim, refpos, eid, pos, wsTmp));
+      if (d < dist) {
+        id = eid;
+        dist = d;
+        ws = wsTmp;
+      }
+      node++;
+    } else // separate at internal nodes
+      node = bvh.auxIndices[node];
+  }
+  return ws;
+}
+
+// nearest element on the wide tree; the W child boxes of a node are tested
+// together in one loop over the SoA bounds, which the compiler vectorizes,
+// then leaves are resolved at once and inner children pushed far to near
+template <int W, LBvh::element_e et>
+vec3f nearest_wide(const LBvh &bvh, const PrimitiveObject &prim,
+                   const std::vector<vec3f> &refpos, const vec3f &pos,
+                   LBvh::Ti &id, float &dist,
+                   std::vector<std::pair<LBvh::Ti, float>> &stack) {
+  using Ti = LBvh::Ti;
+  vec3f ws{0.f, 0.f, 0.f};
+  vec3f wsTmp{0.f, 0.f, 0.f};
+  float best = dist < std::sqrt(std::numeric_limits<float>::max())
+                   ? dist * dist
+                   : std::numeric_limits<float>::infinity();
+  stack.clear();
+  stack.emplace_back(0, 0.f);
+  while (!stack.empty()) {
+    auto [node, nd] = stack.back();
+    stack.pop_back();
+    if (nd >= best)
+      continue;
+    const float *b = bvh.wideBvs.data() + (std::size_t)node * 6 * W;
+    const Ti *c = bvh.wideChildren.data() + (std::size_t)node * W;
+    float ds[W];
+    for (int k = 0; k < W; ++k) {
+      float dx = std::max(std::max(b[0 * W + k] - pos[0], pos[0] - b[3 * W + k]), 0.f);
+      float dy = std::max(std::max(b[1 * W + k] - pos[1], pos[1] - b[4 * W + k]), 0.f);
+      float dz = std::max(std::max(b[2 * W + k] - pos[2], pos[2] - b[5 * W + k]), 0.f);
+      ds[k] = dx * dx + dy * dy + dz * dz;
+    }
+    int inner[W];
+    int numInner = 0;
+    for (int k = 0; k < W; ++k) {
+      if (!(ds[k] < best))
+        continue;
+      if (c[k] >= 0) {
+        inner[numInner++] = k;
+        continue;
+      }
+      const Ti eid = ~c[k];
+      float d = element_dist_sqr<et>(prim, refpos, eid, pos, wsTmp);
+      if (d < best) {
+        best = d;
+        id = eid;
+        ws = wsTmp;
+      }
+    }
+    // insertion sort by descending distance, so the nearest pops first
+    for (int i = 1; i < numInner; ++i)
+      for (int j = i; j > 0 && ds[inner[j - 1]] < ds[inner[j]]; --j)
+        std::swap(inner[j - 1], inner[j]);
+    for (int i = 0; i < numInner; ++i)
+      if (ds[inner[i]] < best)
+        stack.emplace_back(c[inner[i]], ds[inner[i]]);
+  }
+  if (id != -1)
+    dist = std::sqrt(best);
+  return ws;
+}
+
+inline unsigned clz32(std::uint32_t x) {
+#if defined(_MSC_VER) || (defined(_WIN32) && defined(__INTEL_COMPILER))
+  return __lzcnt(x);
+#elif defined(__clang__) || defined(__GNUC__)
+  return __builtin_clz(x);
+#endif
+}
+
+inline unsigned clz64(std::uint64_t x) {
+#if defined(_MSC_VER) || (defined(_WIN32) && defined(__INTEL_COMPILER))
+  return (unsigned)__lzcnt64(x);
+#elif defined(__clang__) || defined(__GNUC__)
+  return __builtin_clzll(x);
+#endif
+}
+
+} // namespace
+
+template <LBvh::element_e et>
+void LBvh::build(const std::shared_ptr<PrimitiveObject> &prim, float thickness,
+                 element_t<et>) {
+  this->primPtr = prim;
+  this->thickness = thickness;
+
+  Ti numLeaves = 0; // refpos.size();
+
+  {
+    // determine element category
+    if constexpr (et == element_e::tet) {
+      this->eleCategory = element_e::tet;
+      numLeaves = prim->quads.size();
+    } else if constexpr (et == element_e::tri) {
+      this->eleCategory = element_e::tri;
+      numLeaves = prim->tris.size();
+    } else if constexpr (et == element_e::line) {
+      this->eleCategory = element_e::line;
+      numLeaves = prim->lines.size();
+    } else if constexpr (et == element_e::point) {
+      if (prim->points.size() > 0) {
+        this->eleCategory = element_e::point;
+        numLeaves = prim->points.size();
+      } else {
+        this->eleCategory = element_e::point;
+        numLeaves = prim->verts.size();
+        prim->points.resize(numLeaves);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+        for (Ti i = 0; i < numLeaves; ++i)
+          prim->points[i] = i;
+      }
+    }
+  }
+
+  const auto &refpos = prim->attr<vec3f>("pos");
+  const Ti numNodes = numLeaves ? numLeaves + numLeaves - 1 : 0;
+  sortedBvs.resize(numNodes);
+  auxIndices.resize(numNodes);
+  levels.resize(numNodes);
+  parents.resize(numNodes);
+  leafIndices.resize(numLeaves);
+
+  if (numLeaves <= 2) { // edge cases where not enough primitives to form a tree
+    for (Ti i = 0; i != numLeaves; ++i) {
+      sortedBvs[i] = element_bv<et>(*prim, refpos, i, thickness);
+      leafIndices[i] = i;
+      levels[i] = 0;
+      auxIndices[i] = i;
+      parents[i] = -1;
+    }
+    if (wideWidth)
+      collapse(wideWidth);
+    return;
+  }
+
+  constexpr int dim = 3;
+  constexpr auto ma = std::numeric_limits<float>::max();
+  constexpr auto mi = std::numeric_limits<float>::lowest();
+  Box wholeBox{TV{ma, ma, ma}, TV{mi, mi, mi}};
+
+  // fmt::print("wholebox before[{}, {}, {}] - [{}, {}, {}]\n",
+  // wholeBox.first[0], wholeBox.first[1], wholeBox.first[2],
+  // wholeBox.second[0], wholeBox.second[1], wholeBox.second[2]);
+  /// whole box
+  TV minVec = {ma, ma, ma};
+  TV maxVec = {mi, mi, mi};
+
+  // ref: https://www.openmp.org/spec-html/5.0/openmpsu107.html
+  for (int d = 0; d != dim; ++d) {
+    float &v = minVec[d];
+#ifndef _MSC_VER
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(min : v)
+#endif
+#endif
+    for (Ti i = 0; i < refpos.size(); ++i) {
+      const auto &p = refpos[i];
+      if (p[d] < v)
+        v = p[d];
+    }
+  }
+  for (int d = 0; d != dim; ++d) {
+    float &v = maxVec[d];
+#ifndef _MSC_VER
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(max : v)
+#endif
+#endif
+    for (Ti i = 0; i < refpos.size(); ++i) {
+      const auto &p = refpos[i];
+      if (p[d] > v)
+        v = p[d];
+    }
+  }
+  wholeBox.first = minVec;
+  wholeBox.second = maxVec;
+
+  // fmt::print("wholebox after[{}, {}, {}] - [{}, {}, {}]\n",
+  // wholeBox.first[0], wholeBox.first[1], wholeBox.first[2],
+  // wholeBox.second[0], wholeBox.second[1], wholeBox.second[2]); printf("lbvh
+  // bounding box: %f, %f, %f - %f, %f, %f\n", wholeBox.first[0],
+  // wholeBox.first[1], wholeBox.first[2], wholeBox.second[0],
+  // wholeBox.second[1], wholeBox.second[2]);
+
+  /// 63-bit morton codes, 21 bits per axis
+  std::vector<std::uint64_t> codes(numLeaves);
+  std::vector<Ti> ids(numLeaves);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numLeaves; ++i) {
+    codes[i] = morton_code(element_center<et>(*prim, refpos, i), wholeBox);
+    ids[i] = i;
+  }
+  // stable, so equal codes stay in element order
+  parallel_radix_sort(codes, ids, 63);
+
+  std::vector<Tu> splits(numLeaves);
+  /// duplicate codes are told apart by their sorted index, as if the index
+  /// were appended below the code bits, so that every split is well defined
+  constexpr Tu numIndexBits = sizeof(Tu) * 8;
+  constexpr Tu numTotalBits = 64 + numIndexBits;
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numLeaves; ++i) {
+    if (i == numLeaves - 1)
+      splits[i] = numTotalBits + 1;
+    else if (auto x = codes[i] ^ codes[i + 1]; x)
+      splits[i] = numTotalBits - clz64(x);
+    else
+      splits[i] = numIndexBits - clz32((Tu)i ^ (Tu)(i + 1));
+  }
+  ///
+  std::vector<Box> leafBvs(numLeaves);
+  std::vector<Box> trunkBvs(numLeaves - 1);
+  std::vector<Ti> leafLca(numLeaves);
+  std::vector<Ti> leafDepths(numLeaves);
+  std::vector<Ti> trunkR(numLeaves - 1);
+  std::vector<Ti> trunkLc(numLeaves - 1);
+
+  std::vector<std::atomic<Tu>> trunkTopoMarks(numLeaves - 1);
+  std::vector<std::atomic<Ti>> trunkBuildFlags(numLeaves - 1);
+#if 0
+        // already zero-initialized during default ctor
+        // https://en.cppreference.com/w/cpp/atomic/atomic/atomic
+        // courtesy of pyb
+#pragma omp parallel for
+        for (Ti i = 0; i < numLeaves - 1; ++i) {
+            trunkTopoMarks[i] = 0;
+            trunkBuildFlags[i] = 0;
+        }
+#endif
+
+  {
+    std::vector<Ti> trunkL(numLeaves - 1);
+    std::vector<Ti> trunkRc(numLeaves - 1);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+    for (Ti idx = 0; idx < numLeaves; ++idx) {
+      leafBvs[idx] = element_bv<et>(*prim, refpos, ids[idx], thickness);
+
+      leafLca[idx] = -1, leafDepths[idx] = 1;
+      Ti l = idx - 1, r = idx; ///< (l, r]
+      bool mark{false};
+
+      if (l >= 0)
+        mark =
+            splits[l] < splits[r]; ///< true when right child, false otherwise
+
+      int cur = mark ? l : r;
+      if (mark)
+        trunkRc[cur] = idx, trunkR[cur] = idx,
+        trunkTopoMarks[cur].fetch_or((Tu)0x00000002u);
+      else
+        trunkLc[cur] = idx, trunkL[cur] = idx,
+        trunkTopoMarks[cur].fetch_or((Tu)0x00000001u);
+
+      while (trunkBuildFlags[cur].fetch_add(1) == 1) {
+        { // refit
+          int lc = trunkLc[cur], rc = trunkRc[cur];
+          const auto childMask = trunkTopoMarks[cur] & (Tu)3;
+          const auto &leftBox = (childMask & 1) ? leafBvs[lc] : trunkBvs[lc];
+          const auto &rightBox = (childMask & 2) ? leafBvs[rc] : trunkBvs[rc];
+          Box bv{};
+          for (int d = 0; d != dim; ++d) {
+            bv.first[d] = leftBox.first[d] < rightBox.first[d]
+                              ? leftBox.first[d]
+                              : rightBox.first[d];
+            bv.second[d] = leftBox.second[d] > rightBox.second[d]
+                               ? leftBox.second[d]
+                               : rightBox.second[d];
+          }
+          trunkBvs[cur] = bv;
+        }
+        trunkTopoMarks[cur] &= 0x00000007;
+
+        l = trunkL[cur] - 1, r = trunkR[cur];
+        leafLca[l + 1] = cur, leafDepths[l + 1]++;
+        atomic_thread_fence(std::memory_order_acquire);
+
+        if (l >= 0)
+          mark =
+              splits[l] < splits[r]; ///< true when right child, false otherwise
+        else
+          mark = false;
+
+        if (l + 1 == 0 && r == numLeaves - 1) {
+          // trunkPar(cur) = -1;
+          trunkTopoMarks[cur] &= 0xFFFFFFFB;
+          break;
+        }
+
+        int par = mark ? l : r;
+        // trunkPar(cur) = par;
+        if (mark) {
+          trunkRc[par] = cur, trunkR[par] = r;
+          trunkTopoMarks[par].fetch_and(0xFFFFFFFD);
+          trunkTopoMarks[cur] |= 0x00000004;
+        } else {
+          trunkLc[par] = cur, trunkL[par] = l + 1;
+          trunkTopoMarks[par].fetch_and(0xFFFFFFFE);
+          trunkTopoMarks[cur] &= 0xFFFFFFFB;
+        }
+        cur = par;
+      }
+    }
+  }
+
+  std::vector<Ti> leafOffsets(numLeaves + 1);
+  leafOffsets[0] = 0;
+  for (Ti i = 1; i <= numLeaves; ++i)
+    leafOffsets[i] = leafOffsets[i - 1] + leafDepths[i - 1];
+  std::vector<Ti> trunkDst(numLeaves - 1);
+  /// compute trunk order
+  // [levels], [parents], [trunkDst]
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numLeaves; ++i) {
+    auto offset = leafOffsets[i];
+    parents[offset] = -1;
+    for (Ti node = leafLca[i], level = leafDepths[i]; --level;
+         node = trunkLc[node]) {
+      levels[offset] = level;
+      parents[offset + 1] = offset;
+      trunkDst[node] = offset++;
+    }
+  }
+  // only left-branch-node's parents are set so far
+  // levels store the number of node within the left-child-branch from bottom
+  // up starting from 0
+
+  /// reorder trunk
+  // [sortedBvs], [auxIndices], [parents]
+  // auxIndices here is escapeIndex (for trunk nodes)
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numLeaves - 1; ++i) {
+    const auto dst = trunkDst[i];
+    const auto &bv = trunkBvs[i];
+    // auto l = trunkL[i];
+    auto r = trunkR[i];
+    sortedBvs[dst] = bv;
+    const auto rb = r + 1;
+    if (rb < numLeaves) {
+      auto lca = leafLca[rb]; // rb must be in left-branch
+      auto brother = (lca != -1 ? trunkDst[lca] : leafOffsets[rb]);
+      auxIndices[dst] = brother;
+      if (parents[dst] == dst - 1)
+        parents[brother] = dst - 1; // setup right-branch brother's parent
+    } else
+      auxIndices[dst] = -1;
+  }
+
+  /// reorder leaf
+  // [sortedBvs], [auxIndices], [levels], [parents], [leafIndices]
+  // auxIndices here is primitiveIndex (for leaf nodes)
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numLeaves; ++i) {
+    const auto &bv = leafBvs[i];
+    // const auto leafDepth = leafDepths[i];
+
+    auto dst = leafOffsets[i + 1] - 1;
+    leafIndices[i] = dst;
+    sortedBvs[dst] = bv;
+    auxIndices[dst] = ids[i];
+    levels[dst] = 0;
+    if (parents[dst] == dst - 1)
+      parents[dst + 1] = dst - 1; // setup right-branch brother's parent
+    // if (leafDepth > 1) parents[dst + 1] = dst - 1;  // setup right-branch
+    // brother's parent
+  }
+
+  if (wideWidth)
+    collapse(wideWidth);
+}
+
+template void
+LBvh::build<LBvh::element_e::point>(const std::shared_ptr<PrimitiveObject> &,
+                                    float, element_t<element_e::point>);
+template void
+LBvh::build<LBvh::element_e::line>(const std::shared_ptr<PrimitiveObject> &,
+                                   float, element_t<element_e::line>);
+template void
+LBvh::build<LBvh::element_e::tri>(const std::shared_ptr<PrimitiveObject> &,
+                                  float, element_t<element_e::tri>);
+template void
+LBvh::build<LBvh::element_e::tet>(const std::shared_ptr<PrimitiveObject> &,
+                                  float, element_t<element_e::tet>);
+
+void LBvh::build(const std::shared_ptr<PrimitiveObject> &prim,
+                 float thickness) {
+  // determine element category
+  if (prim->quads.size() > 0)
+    build(prim, thickness, element_c<element_e::tet>);
+  else if (prim->tris.size() > 0)
+    build(prim, thickness, element_c<element_e::tri>);
+  else if (prim->lines.size() > 0)
+    build(prim, thickness, element_c<element_e::line>);
+  else if (prim->points.size() > 0)
+    build(prim, thickness, element_c<element_e::point>);
+  else
+    build(prim, thickness, element_c<element_e::point>);
+}
+
+template <LBvh::element_e et> void LBvh::refit(element_t<et>) {
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  const Ti numLeaves = getNumLeaves();
+  if (numLeaves <= 2) {
+    for (Ti i = 0; i != numLeaves; ++i)
+      sortedBvs[i] = element_bv<et>(*prim, refpos, i, thickness);
+    refit_wide();
+    return;
+  }
+  const Ti numNodes = numLeaves * 2 - 1;
+  // zero-initialized, see build; the second child to arrive at a node merges
+  // it and carries on upwards, so every node is merged exactly once
+  std::vector<std::atomic<Ti>> refitFlags(numNodes);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti nid = 0; nid < numLeaves; ++nid) {
+    auto idx = leafIndices[nid];
+    sortedBvs[idx] = element_bv<et>(*prim, refpos, auxIndices[idx], thickness);
+
+    auto par = parents[idx];
+    while (par != -1) {
+      if (refitFlags[par].fetch_add(1, std::memory_order_acq_rel) == 0)
+        break;
+      auto lc = par + 1;
+      auto rc = levels[lc] == 0 ? lc + 1 : auxIndices[lc];
+      // merge box
+      const auto &leftBox = sortedBvs[lc];
+      const auto &rightBox = sortedBvs[rc];
+      Box bv{};
+      for (int d = 0; d != 3; ++d) {
+        bv.first[d] = std::min(leftBox.first[d], rightBox.first[d]);
+        bv.second[d] = std::max(leftBox.second[d], rightBox.second[d]);
+      }
+      sortedBvs[par] = bv;
+      par = parents[par];
+    }
+  }
+  refit_wide();
+}
+
+template void LBvh::refit<LBvh::element_e::point>(element_t<element_e::point>);
+template void LBvh::refit<LBvh::element_e::line>(element_t<element_e::line>);
+template void LBvh::refit<LBvh::element_e::tri>(element_t<element_e::tri>);
+template void LBvh::refit<LBvh::element_e::tet>(element_t<element_e::tet>);
+
+void LBvh::refit() {
+  if (eleCategory == element_e::tet)
+    refit(element_c<element_e::tet>);
+  else if (eleCategory == element_e::tri)
+    refit(element_c<element_e::tri>);
+  else if (eleCategory == element_e::line)
+    refit(element_c<element_e::line>);
+  else // if (eleCategory == element_e::point)
+    refit(element_c<element_e::point>);
+}
+
+void LBvh::collapse(int width) {
+  if (width != 0 && width != 4 && width != 8)
+    throw std::runtime_error("lbvh can only be collapsed to 4 or 8 wide");
+  wideWidth = width;
+  wideBvs.clear();
+  wideChildren.clear();
+  wideSources.clear();
+  const Ti numLeaves = getNumLeaves();
+  if (width == 0 || numLeaves == 0)
+    return;
+
+  constexpr auto ma = std::numeric_limits<float>::max();
+  constexpr auto mi = std::numeric_limits<float>::lowest();
+  // empty slots get an inverted box, which no query ever passes
+  auto newNode = [&] {
+    Ti id = wideChildren.size() / width;
+    for (int c = 0; c != 6; ++c)
+      wideBvs.insert(wideBvs.end(), width, c < 3 ? ma : mi);
+    wideChildren.insert(wideChildren.end(), width, -1);
+    wideSources.insert(wideSources.end(), width, -1);
+    return id;
+  };
+  auto setSlot = [&](Ti wn, int k, Ti src, Ti child) {
+    wideSources[wn * width + k] = src;
+    wideChildren[wn * width + k] = child;
+    for (int d = 0; d != 3; ++d) {
+      wideBvs[(wn * 6 + d) * width + k] = sortedBvs[src].first[d];
+      wideBvs[(wn * 6 + 3 + d) * width + k] = sortedBvs[src].second[d];
+    }
+  };
+  auto root = newNode();
+  if (numLeaves <= 2) {
+    for (Ti i = 0; i != numLeaves; ++i)
+      setSlot(root, i, i, ~auxIndices[i]);
+    return;
+  }
+
+  auto area = [&](Ti n) {
+    auto e = sortedBvs[n].second - sortedBvs[n].first;
+    return e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+  };
+  auto children = [&](Ti n) {
+    Ti lc = n + 1;
+    Ti rc = levels[lc] == 0 ? lc + 1 : auxIndices[lc];
+    return std::make_pair(lc, rc);
+  };
+  // greedily open the largest inner child until the node is full
+  std::vector<std::pair<Ti, Ti>> todo{{0, root}};
+  std::vector<Ti> slots;
+  while (!todo.empty()) {
+    auto [bn, wn] = todo.back();
+    todo.pop_back();
+    auto [lc, rc] = children(bn);
+    slots.assign({lc, rc});
+    while ((int)slots.size() < width) {
+      int best = -1;
+      for (int k = 0; k != slots.size(); ++k)
+        if (levels[slots[k]] && (best == -1 || area(slots[k]) > area(slots[best])))
+          best = k;
+      if (best == -1)
+        break;
+      auto [l, r] = children(slots[best]);
+      slots[best] = l;
+      slots.push_back(r);
+    }
+    for (int k = 0; k != slots.size(); ++k) {
+      Ti src = slots[k];
+      if (levels[src] == 0) {
+        setSlot(wn, k, src, ~auxIndices[src]);
+      } else {
+        Ti child = newNode();
+        setSlot(wn, k, src, child);
+        todo.emplace_back(src, child);
+      }
+    }
+  }
+}
+
+void LBvh::refit_wide() {
+  if (!wideWidth)
+    return;
+  const Ti numSlots = wideSources.size();
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numSlots; ++i) {
+    Ti src = wideSources[i];
+    if (src == -1)
+      continue;
+    Ti wn = i / wideWidth, k = i % wideWidth;
+    for (int d = 0; d != 3; ++d) {
+      wideBvs[(wn * 6 + d) * wideWidth + k] = sortedBvs[src].first[d];
+      wideBvs[(wn * 6 + 3 + d) * wideWidth + k] = sortedBvs[src].second[d];
+    }
+  }
+}
+
+/// nearest primitive
+template <LBvh::element_e et>
+typename LBvh::TV LBvh::find_nearest(TV const &pos, Ti &id, float &dist,
+                        element_t<et>) const {
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+  return nearest_binary<et>(*this, *prim, refpos, pos, id, dist);
+}
+
+template typename LBvh::TV LBvh::find_nearest<LBvh::element_e::point>(
+    const LBvh::TV &, LBvh::Ti &, float &,
+    typename LBvh::element_t<element_e::point>) const;
+template typename LBvh::TV LBvh::find_nearest<LBvh::element_e::line>(
+    const LBvh::TV &, LBvh::Ti &, float &,
+    typename LBvh::element_t<element_e::line>) const;
+template typename LBvh::TV LBvh::find_nearest<LBvh::element_e::tri>(
+    const LBvh::TV &, LBvh::Ti &, float &,
+    typename LBvh::element_t<element_e::tri>) const;
+template typename LBvh::TV LBvh::find_nearest<LBvh::element_e::tet>(
+    const LBvh::TV &, LBvh::Ti &, float &,
+    typename LBvh::element_t<element_e::tet>) const;
+
+typename LBvh::TV LBvh::find_nearest(TV const &pos, Ti &id, float &dist) const {
+  if (eleCategory == element_e::tet)
+    return find_nearest(pos, id, dist, element_c<element_e::tet>);
+  else if (eleCategory == element_e::tri)
+    return find_nearest(pos, id, dist, element_c<element_e::tri>);
+  else if (eleCategory == element_e::line)
+    return find_nearest(pos, id, dist, element_c<element_e::line>);
+  else // if (eleCategory == element_e::point)
+    return find_nearest(pos, id, dist, element_c<element_e::point>);
+}
+
+template <LBvh::element_e et>
+void LBvh::find_nearest_batch(std::vector<TV> const &pos, float *ids,
+                              float *dists, TV *ws, element_t<et>) const {
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  // neighbouring queries in morton order walk mostly the same nodes, so each
+  // thread's contiguous chunk keeps them hot in cache
+  const Ti numQueries = pos.size();
+  Box box{pos.size() ? pos[0] : TV{}, pos.size() ? pos[0] : TV{}};
+  for (auto const &p: pos)
+    for (int d = 0; d != 3; ++d) {
+      box.first[d] = std::min(box.first[d], p[d]);
+      box.second[d] = std::max(box.second[d], p[d]);
+    }
+  std::vector<std::uint64_t> codes(numQueries);
+  std::vector<Ti> order(numQueries);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+  for (Ti i = 0; i < numQueries; ++i) {
+    codes[i] = morton_code(pos[i], box);
+    order[i] = i;
+  }
+  parallel_radix_sort(codes, order, 63);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+  {
+    std::vector<std::pair<Ti, float>> stack;
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+    for (Ti j = 0; j < numQueries; ++j) {
+      const Ti i = order[j];
+      Ti id = -1;
+      float dist = std::numeric_limits<float>::max();
+      TV w;
+      if (wideWidth == 8)
+        w = nearest_wide<8, et>(*this, *prim, refpos, pos[i], id, dist, stack);
+      else if (wideWidth == 4)
+        w = nearest_wide<4, et>(*this, *prim, refpos, pos[i], id, dist, stack);
+      else
+        w = nearest_binary<et>(*this, *prim, refpos, pos[i], id, dist);
+      if (ids)
+        ids[i] = id;
+      if (dists)
+        dists[i] = dist;
+      if (ws)
+        ws[i] = w;
+    }
+  }
+}
+
+template void LBvh::find_nearest_batch<LBvh::element_e::point>(
+    std::vector<TV> const &, float *, float *, TV *,
+    element_t<element_e::point>) const;
+template void LBvh::find_nearest_batch<LBvh::element_e::line>(
+    std::vector<TV> const &, float *, float *, TV *,
+    element_t<element_e::line>) const;
+template void LBvh::find_nearest_batch<LBvh::element_e::tri>(
+    std::vector<TV> const &, float *, float *, TV *,
+    element_t<element_e::tri>) const;
+template void LBvh::find_nearest_batch<LBvh::element_e::tet>(
+    std::vector<TV> const &, float *, float *, TV *,
+    element_t<element_e::tet>) const;
+
+void LBvh::find_nearest_batch(std::vector<TV> const &pos, float *ids,
+                              float *dists, TV *ws) const {
+  if (eleCategory == element_e::tet)
+    find_nearest_batch(pos, ids, dists, ws, element_c<element_e::tet>);
+  else if (eleCategory == element_e::tri)
+    find_nearest_batch(pos, ids, dists, ws, element_c<element_e::tri>);
+  else if (eleCategory == element_e::line)
+    find_nearest_batch(pos, ids, dists, ws, element_c<element_e::line>);
+  else // if (eleCategory == element_e::point)
+    find_nearest_batch(pos, ids, dists, ws, element_c<element_e::point>);
+}
+
+typename LBvh::TV LBvh::find_closest_point(TV const &pos, Ti &id,
+                                           float &dist) const {
+  auto w = find_nearest(pos, id, dist);
+  if (id == -1)
+    return pos;
+  if (eleCategory != element_e::tet)
+    return retrievePrimitiveCenter(id, w);
+  // the weights are those of the closest face, redo it on that face
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+  auto tet = prim->quads[id];
+  static constexpr int faces[4][3] = {{0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3}};
+  TV ret = pos;
+  float best = std::numeric_limits<float>::max();
+  for (auto const &f: faces) {
+    TV ws;
+    TV a = refpos[tet[f[0]]], b = refpos[tet[f[1]]], c = refpos[tet[f[2]]];
+    if (float d = dist_pt(pos, a, b, c, ws); d < best) {
+      best = d;
+      ret = ws[0] * a + ws[1] * b + ws[2] * c;
+    }
+  }
+  return ret;
+}
+
+float LBvh::ray_intersect(TV const &ro, TV const &rd, Ti &id, float tmin,
+                          float tmax) const {
+  if (eleCategory != element_e::tri)
+    throw std::runtime_error("ray intersection needs a lbvh built over tris");
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  float ret = std::numeric_limits<float>::infinity();
+  id = -1;
+  // every hit shrinks the interval to |t| below the best one so far
+  traverse(
+      [&](Box const &bv) { return ray_box_intersect(ro, rd, bv, tmin, tmax); },
+      [&](Ti eid) {
+        auto tri = prim->tris[eid];
+        float t = ray_tri_intersect(ro, rd, refpos[tri[0]], refpos[tri[1]],
+                                    refpos[tri[2]]);
+        if (t < tmin || t > tmax || std::abs(t) >= std::abs(ret))
+          return;
+        ret = t;
+        id = eid;
+        tmin = std::max(tmin, -std::abs(t));
+        tmax = std::min(tmax, std::abs(t));
+      });
+  return ret;
+}
+
+typename LBvh::Ti LBvh::find_containing_tet(TV const &pos, vec4f &bary) const {
+  if (eleCategory != element_e::tet)
+    throw std::runtime_error("tet containment needs a lbvh built over tets");
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  Ti ret = -1;
+  iter_neighbors(pos, [&](Ti eid) {
+    if (ret != -1)
+      return;
+    auto tet = prim->quads[eid];
+    auto w = bary_tet(pos, refpos[tet[0]], refpos[tet[1]], refpos[tet[2]],
+                      refpos[tet[3]]);
+    if (w[0] >= 0 && w[1] >= 0 && w[2] >= 0 && w[3] >= 0) {
+      ret = eid;
+      bary = w;
+    }
+  });
+  return ret;
+}
+
+std::shared_ptr<PrimitiveObject> LBvh::retrievePrimitive(Ti eid) const {
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  auto ret = std::make_shared<PrimitiveObject>();
+  if (eleCategory == element_e::tet) {
+    auto quad = prim->quads[eid];
+    ret->quads.push_back({0, 1, 2, 3});
+    ret->verts.push_back(refpos[quad[0]]);
+    ret->verts.push_back(refpos[quad[1]]);
+    ret->verts.push_back(refpos[quad[2]]);
+    ret->verts.push_back(refpos[quad[3]]);
+  } else if (eleCategory == element_e::tri) {
+    auto tri = prim->tris[eid];
+    ret->tris.push_back({0, 1, 2});
+    ret->verts.push_back(refpos[tri[0]]);
+    ret->verts.push_back(refpos[tri[1]]);
+    ret->verts.push_back(refpos[tri[2]]);
+  } else if (eleCategory == element_e::line) {
+    auto line = prim->lines[eid];
+    ret->lines.push_back({0, 1});
+    ret->verts.push_back(refpos[line[0]]);
+    ret->verts.push_back(refpos[line[1]]);
+  } else if (eleCategory == element_e::point) {
+    auto point = prim->points[eid];
+    ret->points.push_back(0);
+    ret->verts.push_back(refpos[point]);
+  }
+  return ret;
+}
+
+vec3f LBvh::retrievePrimitiveCenter(Ti eid, const TV &w) const {
+  std::shared_ptr<const PrimitiveObject> prim = primPtr.lock();
+  if (!prim)
+    throw std::runtime_error(
+        "the primitive object referenced by lbvh not available anymore");
+  const auto &refpos = prim->attr<vec3f>("pos");
+
+  vec3f ret;
+  if (eleCategory == element_e::tet) {
+    auto quad = prim->quads[eid];
+    ret = (refpos[quad[0]] + refpos[quad[1]] + refpos[quad[2]] +
+           refpos[quad[3]]) /
+          4;
+  } else if (eleCategory == element_e::tri) {
+    auto tri = prim->tris[eid];
+    ret = w[0] * refpos[tri[0]] + w[1] * refpos[tri[1]] + w[2] * refpos[tri[2]];
+    // ret = (refpos[tri[0]] + refpos[tri[1]] + refpos[tri[2]]) / 3;
+  } else if (eleCategory == element_e::line) {
+    auto line = prim->lines[eid];
+    ret = w[0] * refpos[line[0]] + w[1] * refpos[line[1]];
+    // ret = (refpos[line[0]] + refpos[line[1]]) / 2;
+  } else if (eleCategory == element_e::point) {
+    auto point = prim->points[eid];
+    ret = refpos[point];
+  }
+  return ret;
+}
+
+} // namespace zeno
@@ -0,0 +1,75 @@
+#include <zeno/types/PrimitiveObject.h>
+#include <zeno/funcs/PrimitiveUtils.h>
+#include <cstring>
+#include <vector>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace zeno {
+
+namespace {
+
+inline std::uint64_t mix(std::uint64_t h, std::uint64_t w) {
+    h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+}
+
+// fingerprint of a byte range: fixed-size blocks are hashed in parallel with
+// four independent lanes each, then combined in order
+std::uint64_t hash_bytes(void const *data, std::size_t size, std::uint64_t h) {
+    constexpr std::size_t blockSize = 1 << 16;
+    auto bytes = static_cast<unsigned char const *>(data);
+    std::size_t numBlocks = (size + blockSize - 1) / blockSize;
+    std::vector<std::uint64_t> blockHashes(numBlocks);
+#pragma omp parallel for if (numBlocks > 16)
+    for (std::intptr_t b = 0; b < (std::intptr_t)numBlocks; b++) {
+        auto p = bytes + b * blockSize;
+        auto n = std::min(blockSize, size - b * blockSize);
+        std::uint64_t l[4] = {1, 2, 3, 4};
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            std::uint64_t w[4];
+            std::memcpy(w, p + i, 32);
+            for (int k = 0; k < 4; k++)
+                l[k] = mix(l[k], w[k]);
+        }
+        std::uint64_t tail[4] = {};
+        std::memcpy(tail, p + i, n - i);
+        for (int k = 0; k < 4; k++)
+            l[k] = mix(l[k], tail[k]);
+        blockHashes[b] = mix(mix(l[0], l[1]), mix(l[2], l[3]));
+    }
+    h = mix(h, size);
+    for (auto bh: blockHashes)
+        h = mix(h, bh);
+    return h;
+}
+
+template <class T>
+std::uint64_t hash_vector(std::vector<T> const &v, std::uint64_t h) {
+    return hash_bytes(v.data(), v.size() * sizeof(T), h);
+}
+
+}
+
+ZENO_API std::uint64_t primVersion(PrimitiveObject const *prim, unsigned deps) {
+    std::uint64_t h = deps;
+    if (deps & PrimitiveCache::pos)
+        h = hash_vector(prim->verts.values, h);
+    if (deps & PrimitiveCache::points)
+        h = hash_vector(prim->points.values, h);
+    if (deps & PrimitiveCache::lines)
+        h = hash_vector(prim->lines.values, h);
+    if (deps & PrimitiveCache::tris)
+        h = hash_vector(prim->tris.values, h);
+    if (deps & PrimitiveCache::quads)
+        h = hash_vector(prim->quads.values, h);
+    if (deps & PrimitiveCache::polys) {
+        h = hash_vector(prim->loops.values, h);
+        h = hash_vector(prim->polys.values, h);
+    }
+    return h;
+}
+
+}
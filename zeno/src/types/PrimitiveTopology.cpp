@@ -0,0 +1,199 @@
+#include <zeno/types/PrimitiveTopology.h>
+#include <zeno/funcs/PrimitiveUtils.h>
+#include <zeno/para/parallel_scan.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace zeno {
+
+namespace {
+
+// csr table of the items 0..n grouped by row(i), skipping those with a
+// negative row: counted and scattered with atomics, then each row is sorted
+// by `less`, which is cheap as rows (vertex valences) are short
+template <class Row, class Less>
+void csr_build(int n, int numRows, Row row, Less less,
+               std::vector<int> &offsets, std::vector<int> &items) {
+    offsets.assign(numRows + 1, 0);
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        int r = row(i);
+        if (r < 0) continue;
+#pragma omp atomic
+        offsets[r + 1]++;
+    }
+    parallel_inclusive_scan_sum(offsets.begin() + 1, offsets.end(), offsets.begin() + 1);
+
+    std::vector<int> cursors(offsets.begin(), offsets.end() - 1);
+    items.resize(offsets[numRows]);
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        int r = row(i);
+        if (r < 0) continue;
+        int dst;
+#pragma omp atomic capture
+        dst = cursors[r]++;
+        items[dst] = i;
+    }
+#pragma omp parallel for schedule(dynamic, 4096)
+    for (int r = 0; r < numRows; r++)
+        std::sort(items.begin() + offsets[r], items.begin() + offsets[r + 1], less);
+}
+
+}
+
+ZENO_API void PrimitiveTopology::build(PrimitiveObject const *prim) {
+    numVerts = (int)prim->verts.size();
+    numTris = (int)prim->tris.size();
+    numQuads = (int)prim->quads.size();
+    numPolys = (int)prim->polys.size();
+    const int nf = numFaces();
+    const int pb = polyBase();
+
+    faceOffsets.resize(nf + 1);
+    faceOffsets[0] = 0;
+    parallel_inclusive_scan(0, nf, faceOffsets.begin() + 1, 0, std::plus<int>(), [&] (int f) {
+        return f < numTris ? 3 : f < pb ? 4 : prim->polys[f - pb][1];
+    });
+    const int nc = faceOffsets[nf];
+    const int nl = (int)prim->lines.size();
+    const int nh = nc + nl;
+
+    faceVerts.resize(nc);
+    halfedges.resize(nh);
+    heFace.resize(nh);
+#pragma omp parallel for
+    for (int f = 0; f < nf; f++) {
+        int base = faceOffsets[f];
+        if (f < numTris) {
+            auto ind = prim->tris[f];
+            for (int k = 0; k < 3; k++)
+                faceVerts[base + k] = ind[k];
+        } else if (f < pb) {
+            auto ind = prim->quads[f - numTris];
+            for (int k = 0; k < 4; k++)
+                faceVerts[base + k] = ind[k];
+        } else {
+            auto [start, len] = prim->polys[f - pb];
+            std::copy_n(prim->loops.begin() + start, len, faceVerts.begin() + base);
+        }
+        int end = faceOffsets[f + 1];
+        for (int c = base; c < end; c++) {
+            halfedges[c] = vec2i(faceVerts[c], faceVerts[c + 1 == end ? base : c + 1]);
+            heFace[c] = f;
+        }
+    }
+#pragma omp parallel for
+    for (int i = 0; i < nl; i++) {
+        halfedges[nc + i] = prim->lines[i];
+        heFace[nc + i] = -1;
+    }
+
+    // group the non-degenerate half-edges by their smaller vertex, then by
+    // the larger one, so each edge is a run, in (min, max) order, listing
+    // its half-edges in increasing order
+    std::vector<int> rowOffsets;
+    csr_build(nh, numVerts, [&] (int h) {
+        auto [a, b] = halfedges[h];
+        return a == b ? -1 : std::min(a, b);
+    }, [&] (int h1, int h2) {
+        auto m1 = std::max(halfedges[h1][0], halfedges[h1][1]);
+        auto m2 = std::max(halfedges[h2][0], halfedges[h2][1]);
+        return m1 < m2 || (m1 == m2 && h1 < h2);
+    }, rowOffsets, edgeHalfedges);
+    auto is_run_start = [&] (int i, int begin) {
+        if (i == begin) return true;
+        auto [a1, b1] = halfedges[edgeHalfedges[i - 1]];
+        auto [a2, b2] = halfedges[edgeHalfedges[i]];
+        return std::max(a1, b1) != std::max(a2, b2);
+    };
+
+    std::vector<int> rowEdges(numVerts + 1);
+    rowEdges[0] = 0;
+    parallel_inclusive_scan(0, numVerts, rowEdges.begin() + 1, 0, std::plus<int>(), [&] (int v) {
+        int count = 0;
+        for (int i = rowOffsets[v]; i < rowOffsets[v + 1]; i++)
+            count += is_run_start(i, rowOffsets[v]);
+        return count;
+    });
+    const int ne = rowEdges[numVerts];
+
+    edges.resize(ne);
+    edgeOffsets.resize(ne + 1);
+    heEdge.assign(nh, -1);
+#pragma omp parallel for
+    for (int v = 0; v < numVerts; v++) {
+        int e = rowEdges[v] - 1;
+        for (int i = rowOffsets[v]; i < rowOffsets[v + 1]; i++) {
+            int h = edgeHalfedges[i];
+            if (is_run_start(i, rowOffsets[v])) {
+                edgeOffsets[++e] = i;
+                edges[e] = halfedges[h];
+            }
+            heEdge[h] = e;
+        }
+    }
+    edgeOffsets[ne] = (int)edgeHalfedges.size();
+
+    heTwin.assign(nh, -1);
+#pragma omp parallel for
+    for (int e = 0; e < ne; e++) {
+        int twin[2], count = 0;
+        for (int i = edgeOffsets[e]; i < edgeOffsets[e + 1]; i++) {
+            int h = edgeHalfedges[i];
+            if (heFace[h] < 0) continue;
+            if (count < 2) twin[count] = h;
+            ++count;
+        }
+        if (count == 2) {
+            heTwin[twin[0]] = twin[1];
+            heTwin[twin[1]] = twin[0];
+        }
+    }
+
+    // corners are numbered in face order, so sorting them sorts the faces
+    csr_build(nc, numVerts, [&] (int c) {
+        return faceVerts[c];
+    }, std::less<int>(), vertFaceOffsets, vertCorners);
+    vertFaces.resize(vertCorners.size());
+#pragma omp parallel for
+    for (int i = 0; i < (int)vertCorners.size(); i++)
+        vertFaces[i] = heFace[vertCorners[i]];
+
+    // item 2e + k is edge e seen from its end k, towards the other end
+    auto other_end = [&] (int i) {
+        return edges[i >> 1][~i & 1];
+    };
+    csr_build(2 * ne, numVerts, [&] (int i) {
+        return edges[i >> 1][i & 1];
+    }, [&] (int i1, int i2) {
+        return other_end(i1) < other_end(i2);
+    }, vertVertOffsets, vertVerts);
+#pragma omp parallel for
+    for (int i = 0; i < (int)vertVerts.size(); i++)
+        vertVerts[i] = other_end(vertVerts[i]);
+}
+
+ZENO_API int PrimitiveTopology::findEdge(int a, int b) const {
+    auto key = std::make_pair(std::min(a, b), std::max(a, b));
+    auto it = std::lower_bound(edges.begin(), edges.end(), key, [] (vec2i const &e, auto const &key) {
+        return std::make_pair(std::min(e[0], e[1]), std::max(e[0], e[1])) < key;
+    });
+    if (it == edges.end() || std::min((*it)[0], (*it)[1]) != key.first || std::max((*it)[0], (*it)[1]) != key.second)
+        return -1;
+    return int(it - edges.begin());
+}
+
+ZENO_API std::shared_ptr<PrimitiveTopology const> primTopology(PrimitiveObject const *prim) {
+    unsigned deps = PrimitiveCache::lines | PrimitiveCache::tris | PrimitiveCache::quads | PrimitiveCache::polys;
+    auto version = primVersion(prim, deps) ^ std::uint64_t(prim->verts.size()) * 0x9e3779b97f4a7c15ull;
+    return prim->cache.get<PrimitiveTopology>("topology", version, [&] {
+        return std::make_shared<PrimitiveTopology>(prim);
+    });
+}
+
+}
@@ -0,0 +1,83 @@
+#include <zeno/utils/mapped_file.h>
+#include <cstdio>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zeno {
+
+#ifdef _WIN32
+
+ZENO_API mapped_file::mapped_file(std::string const &path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::fprintf(stderr, "%s: cannot open file\n", path.c_str());
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        std::fprintf(stderr, "%s: cannot map file\n", path.c_str());
+        return;
+    }
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        std::fprintf(stderr, "%s: cannot map file\n", path.c_str());
+        CloseHandle(mapping);
+        return;
+    }
+    m_data = static_cast<char const *>(data);
+    m_size = (std::size_t)size.QuadPart;
+    m_handle = mapping;
+}
+
+ZENO_API mapped_file::~mapped_file() {
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_handle);
+    }
+}
+
+#else
+
+ZENO_API mapped_file::mapped_file(std::string const &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        perror(path.c_str());
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !st.st_size) {
+        close(fd);
+        return;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror(path.c_str());
+        return;
+    }
+    madvise(data, st.st_size, MADV_WILLNEED);
+    m_data = static_cast<char const *>(data);
+    m_size = (std::size_t)st.st_size;
+}
+
+ZENO_API mapped_file::~mapped_file() {
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+#endif
+
+}
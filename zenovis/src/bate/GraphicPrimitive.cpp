@@ -4,6 +4,8 @@
 #include <zeno/types/PrimitiveObject.h>
 #include <zeno/types/InstancingObject.h>
 #include <zeno/types/PrimitiveTools.h>
+#include <zeno/types/PrimitiveTopology.h>
+#include <zeno/funcs/PrimitiveUtils.h>
 #include <zeno/types/UserData.h>
 #include <zeno/utils/logger.h>
 #include <zeno/utils/orthonormal.h>
@@ -156,18 +158,26 @@ static void parseTrianglesDrawBufferCompress(zeno::PrimitiveObject *prim, ZhxxDr
     std::vector<int> vertVisited(pos.size());
     std::vector<zeno::vec3i> tris1(tris.size());
     vertVisited.assign(pos.size(), 0);
+    std::vector<zeno::vec3f> areaTang(tris.size());
+#pragma omp parallel for
     for (int i = 0; i < tris.size(); i++) {
         float area =
             zeno::length(zeno::cross(pos[tris[i][1]] - pos[tris[i][0]],
                                      pos[tris[i][2]] - pos[tris[i][0]]));
-        for (int j = 0; j < 3; j++) {
-            tang1[tris[i][j]] += area * tang[i];
-        }
+        areaTang[i] = area * tang[i];
     }
     /* std::cout << "1111111111111111\n"; */
+    // gathered per vertex over its triangles, see primCalcNormal
+    auto topo = zeno::primTopology(prim);
 #pragma omp parallel for
     for (int i = 0; i < tang1.size(); i++) {
-        tang1[i] = tang[i] / (zeno::length(tang[i]) + 0.000001);
+        zeno::vec3f t(0);
+        for (int k = topo->vertFaceOffsets[i]; k < topo->vertFaceOffsets[i + 1]; k++) {
+            int f = topo->vertFaces[k];
+            if (f < topo->numTris)
+                t += areaTang[f];
+        }
+        tang1[i] = t / (zeno::length(t) + 0.000001);
     }
     /* std::cout << "2222222222222222\n"; */
     std::vector<int> issueTris(0);